@@ -5,62 +5,101 @@ in vec2 FragTextureCoords;
 in vec3 FragCameraPosition;
 in mat3 FragTBN;
 
-// PBR Material definition
-struct PBRMaterial {
-#ifdef albedo_color
-    vec3 albedo;
-#endif
-
-#ifdef metallic_value
+// PBR Material values, must match PBRMaterial::UniformData
+layout(std140) uniform MaterialBlock {
+    vec4 albedo;
     float metallic;
-#endif
-
-#ifdef roughness_value
     float roughness;
-#endif
-
-#ifdef ao_value
     float ao;
+    float normal_layer;
+    vec4 layers; // albedo, metallic, roughness, ao
+} Material;
+
+// PBR Material textures, maps in texture arrays are sampled at the layer of the material
+#ifdef albedo_layered
+#define albedo_texture
+uniform sampler2DArray AlbedoMap;
+#define AlbedoCoords vec3(FragTextureCoords, Material.layers.x)
+#elif defined(albedo_texture)
+uniform sampler2D AlbedoMap;
+#define AlbedoCoords FragTextureCoords
 #endif
 
-#ifdef albedo_texture
-    sampler2D albedo_map;
+#ifdef metallic_layered
+#define metallic_texture
+uniform sampler2DArray MetallicMap;
+#define MetallicCoords vec3(FragTextureCoords, Material.layers.y)
+#elif defined(metallic_texture)
+uniform sampler2D MetallicMap;
+#define MetallicCoords FragTextureCoords
 #endif
 
-#ifdef metallic_texture
-    sampler2D metallic_map;
+#ifdef roughness_layered
+#define roughness_texture
+uniform sampler2DArray RoughnessMap;
+#define RoughnessCoords vec3(FragTextureCoords, Material.layers.z)
+#elif defined(roughness_texture)
+uniform sampler2D RoughnessMap;
+#define RoughnessCoords FragTextureCoords
 #endif
 
-#ifdef roughness_texture
-    sampler2D roughness_map;
+#ifdef ao_layered
+#define ao_texture
+uniform sampler2DArray AOMap;
+#define AOCoords vec3(FragTextureCoords, Material.layers.w)
+#elif defined(ao_texture)
+uniform sampler2D AOMap;
+#define AOCoords FragTextureCoords
 #endif
 
-#ifdef ao_texture
-    sampler2D ao_map;
+#ifdef normal_layered
+#define normal_texture
+uniform sampler2DArray NormalMap;
+#define NormalCoords vec3(FragTextureCoords, Material.normal_layer)
+#elif defined(normal_texture)
+uniform sampler2D NormalMap;
+#define NormalCoords FragTextureCoords
 #endif
 
-#ifdef normal_texture
-    sampler2D normal_map;
-#endif
+// Light definitions, must match the Lights uniform block layout in Renderer3D
+struct PointLightStruct {
+    vec4 position;
+    vec4 attenuation; // constant, linear, quadratic
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 };
-uniform PBRMaterial Material;
 
-// PointLight definition and values
-struct PointLightStruct {
-    vec3 position;
+struct DirectionalLightStruct {
+    vec4 direction;
 
-    float constant;
-    float linear;
-    float quadratic;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+struct SpotLightStruct {
+    vec4 position;
+    vec4 direction;
+    vec4 attenuation; // constant, linear, quadratic
+    vec4 cut_off;     // cos(inner), cos(outer)
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 };
 
-#define MAX_NUMBER_POINT_LIGHTS 20
-uniform int NumberPointLights;
-uniform PointLightStruct[MAX_NUMBER_POINT_LIGHTS] PointLights;
+#define MAX_NUMBER_POINT_LIGHTS 128
+#define MAX_NUMBER_DIRECTIONAL_LIGHTS 4
+#define MAX_NUMBER_SPOT_LIGHTS 32
+
+layout(std140) uniform Lights {
+    ivec4 NumberLights; // point, directional, spot
+    PointLightStruct PointLights[MAX_NUMBER_POINT_LIGHTS];
+    DirectionalLightStruct DirectionalLights[MAX_NUMBER_DIRECTIONAL_LIGHTS];
+    SpotLightStruct SpotLights[MAX_NUMBER_SPOT_LIGHTS];
+};
 
 //
 // Skybox 
@@ -123,6 +162,30 @@ vec3 FresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 } 
 
+// Outgoing radiance for a light of unit radiance coming from direction L
+vec3 CookTorrance(vec3 N, vec3 V, vec3 L, vec3 F0, vec3 albedo, float metallic, float roughness) {
+    vec3 H = normalize(V + L);
+
+    float NDF = DistributionGGX(N, H, roughness);
+    float G   = GeometrySmith(N, V, L, roughness);
+    vec3 F    = FresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
+
+    // Cook-Torrence BRDF
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
+    vec3 specular = numerator / denominator;
+
+    vec3 kS = F;
+    // Because energy conservation, the diffuse and specular light can't be above 1.0
+    vec3 kD = vec3(1.0) - kS;
+    // Enforce that metallic sufraces dont refract light
+    kD *= 1.0 - metallic;
+
+    float NdotL = max(dot(N, L), 0.0);
+    // we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+    return (kD * albedo / PI + specular) * NdotL;
+}
+
 void main() { 
     // ============================
     // Define Material properties
@@ -133,33 +196,33 @@ void main() {
     float ao = 1.0;
 
 #if defined(albedo_texture)
-    albedo = pow(texture(Material.albedo_map, FragTextureCoords).rgb, vec3(2.2));
+    albedo = pow(texture(AlbedoMap, AlbedoCoords).rgb, vec3(2.2));
 #elif defined(albedo_color)
-    albedo = Material.albedo;
+    albedo = Material.albedo.rgb;
 #else
 #error Albedo color or texture is required
 #endif
 
 #if defined(metallic_roughness_ao_texture)
-    ao = texture(Material.ao_map, FragTextureCoords).r;
-    roughness = texture(Material.roughness_map, FragTextureCoords).g;
-    metallic = texture(Material.metallic_map, FragTextureCoords).b;
+    ao = texture(AOMap, AOCoords).r;
+    roughness = texture(RoughnessMap, RoughnessCoords).g;
+    metallic = texture(MetallicMap, MetallicCoords).b;
 #endif
 
 #if defined(metallic_roughness_texture) && !defined(metallic_roughness_ao_texture)
-    roughness = texture(Material.roughness_map, FragTextureCoords).r;
-    metallic = texture(Material.metallic_map, FragTextureCoords).g;
+    roughness = texture(RoughnessMap, RoughnessCoords).r;
+    metallic = texture(MetallicMap, MetallicCoords).g;
 #endif
 
 #if !defined(metallic_roughness_texture) && !defined(metallic_roughness_ao_texture)
     #if defined(metallic_texture)
-        metallic = texture(Material.metallic_map, FragTextureCoords).r;
+        metallic = texture(MetallicMap, MetallicCoords).r;
     #elif defined(metallic_value)
         metallic = Material.metallic;
     #endif
 
     #if defined(roughness_texture)
-        roughness = texture(Material.roughness_map, FragTextureCoords).r;
+        roughness = texture(RoughnessMap, RoughnessCoords).r;
     #elif defined(roughness_value)
         roughness = Material.roughness;
     #endif
@@ -167,15 +230,17 @@ void main() {
 
 #if !defined(metallic_roughness_ao_texture)
     #if defined(ao_texture)
-        ao = texture(Material.ao_map, FragTextureCoords).r;
+        ao = texture(AOMap, AOCoords).r;
     #elif defined(ao_value)
         ao = Material.ao;
     #endif
 #endif
 
 #if defined(normal_texture)
-    vec3 N = texture(Material.normal_map, FragTextureCoords).rgb;
-    N = N * 2.0 - 1.0; // convert from [0,1] to [-1,1]
+    // Only x and y are stored, compressed normal maps have no z
+    vec3 N;
+    N.xy = texture(NormalMap, NormalCoords).rg * 2.0 - 1.0; // convert from [0,1] to [-1,1]
+    N.z = sqrt(max(1.0 - dot(N.xy, N.xy), 0.0));
     N = normalize(FragTBN * N);
 #else
     vec3 N = normalize(FragNormal);
@@ -188,35 +253,39 @@ void main() {
     F0 = mix(F0, albedo, metallic);
 
     vec3 Lo = vec3(0.0);
-    for (int i = 0; i < NumberPointLights; ++i) {
+    for (int i = 0; i < NumberLights.x; ++i) {
         PointLightStruct light = PointLights[i];
-        
-        vec3 L = normalize(light.position - FragPosition);
-        vec3 H = normalize(V + L);
 
-        float dist = length(light.position - FragPosition);
+        vec3 L = normalize(light.position.xyz - FragPosition);
+
+        float dist = length(light.position.xyz - FragPosition);
         float attenuation = 1.0 / (dist * dist);
-        vec3 radiance = light.diffuse * attenuation;
-
-        float NDF = DistributionGGX(N, H, roughness);
-        float G   = GeometrySmith(N, V, L, roughness);
-        vec3 F    = FresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
-
-        // Cook-Torrence BRDF
-        vec3 numerator = NDF * G * F;
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
-        vec3 specular = numerator / denominator;
-
-        vec3 kS = F;
-        // Because energy conservation, the diffuse and specular light can't be above 1.0
-        vec3 kD = vec3(1.0) - kS;
-        // Enforce that metallic sufraces dont refract light
-        kD *= 1.0 - metallic;
-
-        float NdotL = max(dot(N, L), 0.0);
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
-        // we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+        vec3 radiance = light.diffuse.rgb * attenuation;
+
+        Lo += CookTorrance(N, V, L, F0, albedo, metallic, roughness) * radiance;
+    }
+
+    for (int i = 0; i < NumberLights.y; ++i) {
+        DirectionalLightStruct light = DirectionalLights[i];
+
+        vec3 L = normalize(-light.direction.xyz);
+        Lo += CookTorrance(N, V, L, F0, albedo, metallic, roughness) * light.diffuse.rgb;
+    }
+
+    for (int i = 0; i < NumberLights.z; ++i) {
+        SpotLightStruct light = SpotLights[i];
+
+        vec3 L = normalize(light.position.xyz - FragPosition);
+
+        float dist = length(light.position.xyz - FragPosition);
+        float attenuation = 1.0 / (dist * dist);
+
+        float theta = dot(L, normalize(-light.direction.xyz));
+        float epsilon = light.cut_off.x - light.cut_off.y;
+        float intensity = clamp((theta - light.cut_off.y) / epsilon, 0.0, 1.0);
+
+        vec3 radiance = light.diffuse.rgb * attenuation * intensity;
+        Lo += CookTorrance(N, V, L, F0, albedo, metallic, roughness) * radiance;
     }
 
     //
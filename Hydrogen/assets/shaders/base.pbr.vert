@@ -1,9 +1,9 @@
-#version 330 core
-
 layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec3 aNormal;
+// Octahedral encoded
+layout(location = 1) in vec2 aNormal;
 layout(location = 2) in vec2 aTextureCoords;
-layout(location = 3) in vec3 aTangent;
+// w holds the handedness of the bitangent
+layout(location = 3) in vec4 aTangent;
 
 layout(std140) uniform Camera {
     mat4 Projection;
@@ -11,7 +11,13 @@ layout(std140) uniform Camera {
     vec3 CameraPosition;
 };
 
-uniform mat4 Model;
+#ifdef instanced
+layout(location = 4) in mat4 aInstanceModel;
+#else
+layout(std140) uniform Object {
+    mat4 Model;
+};
+#endif
 
 out vec3 FragPosition;
 out vec3 FragNormal;
@@ -19,18 +25,34 @@ out vec2 FragTextureCoords;
 out vec3 FragCameraPosition;
 out mat3 FragTBN;
 
+vec3 decode_octahedral(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0f) {
+        vec2 signs = vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+        direction.xy = (1.0f - abs(direction.yx)) * signs;
+    }
+    return normalize(direction);
+}
+
 void main() {
+#ifdef instanced
+    mat4 Model = aInstanceModel;
+#endif
+
     mat4 ViewProjection = Projection * View;
     gl_Position = ViewProjection * Model * vec4(aPosition, 1.0f);
 
+    vec3 Normal = decode_octahedral(aNormal);
+
     FragPosition = vec3(Model * vec4(aPosition, 1.0f));
-    FragNormal = mat3(Model) * aNormal;
+    FragNormal = mat3(Model) * Normal;
     FragTextureCoords = aTextureCoords;
     FragCameraPosition = CameraPosition;
 
-    vec3 T = normalize(vec3(Model * vec4(aTangent, 0.0f)));
-    vec3 N = normalize(vec3(Model * vec4(aNormal, 0.0f)));
-    vec3 B = cross(N, T);
+    vec3 T = normalize(vec3(Model * vec4(aTangent.xyz, 0.0f)));
+    vec3 N = normalize(vec3(Model * vec4(Normal, 0.0f)));
+    // Handedness is a normalized 2 bit field, GL 3.3 decodes -1 as -1/3, so only its sign is used
+    vec3 B = cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0);
 
     FragTBN = mat3(T, B, N);
 }
\ No newline at end of file
@@ -5,63 +5,83 @@ in vec2 FragTextureCoords;
 in vec3 FragCameraPosition;
 in mat3 FragTBN;
 
-// Material definition and uniform
-struct MaterialStruct {
-    vec3 ambient;
-
-#ifdef diffuse_color
-    vec3 diffuse;
-#endif
-
-#ifdef specular_color
-    vec3 specular;
-#endif
-
-#ifdef shininess_def
+// Material values, must match PhongMaterial::UniformData
+layout(std140) uniform MaterialBlock {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
     float shininess;
-#endif
+} Material;
 
+// Material textures
 #ifdef diffuse_texture
-    sampler2D diffuse_map;
+uniform sampler2D DiffuseMap;
 #endif
 
 #ifdef specular_texture
-    sampler2D specular_map;
+uniform sampler2D SpecularMap;
 #endif
 
 #ifdef normal_texture
-    sampler2D normal_map;
+uniform sampler2D NormalMap;
 #endif
-};
-uniform MaterialStruct Material;
 
-// PointLight definition and values
+// Light definitions, must match the Lights uniform block layout in Renderer3D
 struct PointLightStruct {
-    vec3 position;
+    vec4 position;
+    vec4 attenuation; // constant, linear, quadratic
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
 
-    float constant;
-    float linear;
-    float quadratic;
+struct DirectionalLightStruct {
+    vec4 direction;
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 };
 
-#define MAX_NUMBER_POINT_LIGHTS 20
-uniform int NumberPointLights;
-uniform PointLightStruct[MAX_NUMBER_POINT_LIGHTS] PointLights;
+struct SpotLightStruct {
+    vec4 position;
+    vec4 direction;
+    vec4 attenuation; // constant, linear, quadratic
+    vec4 cut_off;     // cos(inner), cos(outer)
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+#define MAX_NUMBER_POINT_LIGHTS 128
+#define MAX_NUMBER_DIRECTIONAL_LIGHTS 4
+#define MAX_NUMBER_SPOT_LIGHTS 32
+
+layout(std140) uniform Lights {
+    ivec4 NumberLights; // point, directional, spot
+    PointLightStruct PointLights[MAX_NUMBER_POINT_LIGHTS];
+    DirectionalLightStruct DirectionalLights[MAX_NUMBER_DIRECTIONAL_LIGHTS];
+    SpotLightStruct SpotLights[MAX_NUMBER_SPOT_LIGHTS];
+};
 
 // Fragment Output
 out vec4 ResultColor;
 
 // Function definitions
 vec3 CalcPointLight(PointLightStruct light, vec3 normal, vec3 fragPos, vec3 viewDirection);
+vec3 CalcDirectionalLight(DirectionalLightStruct light, vec3 normal, vec3 viewDirection);
+vec3 CalcSpotLight(SpotLightStruct light, vec3 normal, vec3 fragPos, vec3 viewDirection);
+vec3 CalcShading(vec3 lightDirection, vec3 ambientColor, vec3 diffuseColor, vec3 specularColor,
+                 vec3 normal, vec3 viewDirection);
 
 void main() {
 #if defined(normal_texture)
-    vec3 normal = texture(Material.normal_map, FragTextureCoords).rgb;
-    normal = normal * 2.0f - 1.0f; // convert from [0,1] to [-1,1]
+    // Only x and y are stored, compressed normal maps have no z
+    vec3 normal;
+    normal.xy = texture(NormalMap, FragTextureCoords).rg * 2.0f - 1.0f; // convert from [0,1] to [-1,1]
+    normal.z = sqrt(max(1.0f - dot(normal.xy, normal.xy), 0.0f));
     normal = normalize(FragTBN * normal);
 #else
     vec3 normal = normalize(FragNormal);
@@ -70,16 +90,23 @@ void main() {
     vec3 viewDirection = normalize(FragCameraPosition - FragPosition);
 
     vec3 result = vec3(0.0f, 0.0f, 0.0f);
-    for (int i = 0; i < NumberPointLights; ++i) {
+    for (int i = 0; i < NumberLights.x; ++i) {
         result += CalcPointLight(PointLights[i], normal, FragPosition, viewDirection);
     }
 
+    for (int i = 0; i < NumberLights.y; ++i) {
+        result += CalcDirectionalLight(DirectionalLights[i], normal, viewDirection);
+    }
+
+    for (int i = 0; i < NumberLights.z; ++i) {
+        result += CalcSpotLight(SpotLights[i], normal, FragPosition, viewDirection);
+    }
+
     ResultColor = vec4(result, 1.0f);
 }
 
-vec3 CalcPointLight(PointLightStruct light, vec3 normal, vec3 fragPos, vec3 viewDirection) {
-    vec3 lightDirection = normalize(light.position - fragPos);
-
+vec3 CalcShading(vec3 lightDirection, vec3 ambientColor, vec3 diffuseColor, vec3 specularColor,
+                 vec3 normal, vec3 viewDirection) {
     // diffuse shading
     float diff = max(dot(normal, lightDirection), 0.0);
 
@@ -89,33 +116,62 @@ vec3 CalcPointLight(PointLightStruct light, vec3 normal, vec3 fragPos, vec3 view
     spec = pow(max(dot(viewDirection, halfwayDirection), 0.0), Material.shininess);
 #endif
 
-    // attenuation
-    float lightDistance = length(light.position - fragPos);
-    float attenuation = 1.0f / (light.constant + light.linear * lightDistance +
-                                light.quadratic * (lightDistance * lightDistance));
-
     // combine results
     vec3 ambient = vec3(0.0f, 0.0f, 0.0f);
     vec3 diffuse = vec3(0.0f, 0.0f, 0.0f);
     vec3 specular = vec3(0.0f, 0.0f, 0.0f);
 
 #if defined(diffuse_texture)
-    ambient = light.ambient * vec3(texture(Material.diffuse_map, FragTextureCoords));
-    diffuse = light.diffuse * diff * vec3(texture(Material.diffuse_map, FragTextureCoords));
+    ambient = ambientColor * vec3(texture(DiffuseMap, FragTextureCoords));
+    diffuse = diffuseColor * diff * vec3(texture(DiffuseMap, FragTextureCoords));
 #elif defined(diffuse_color)
-    ambient = light.ambient * Material.diffuse;
-    diffuse = light.diffuse * diff * Material.diffuse;
+    ambient = ambientColor * Material.diffuse.rgb;
+    diffuse = diffuseColor * diff * Material.diffuse.rgb;
 #endif
 
 #if defined(specular_texture)
-    specular = light.specular * spec * vec3(texture(Material.specular_map, FragTextureCoords));
+    specular = specularColor * spec * vec3(texture(SpecularMap, FragTextureCoords));
 #elif defined(specular_color)
-    specular = light.specular * spec * Material.specular;
+    specular = specularColor * spec * Material.specular.rgb;
 #endif
 
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-
     return (ambient + diffuse + specular);
+}
+
+vec3 CalcPointLight(PointLightStruct light, vec3 normal, vec3 fragPos, vec3 viewDirection) {
+    vec3 lightDirection = normalize(light.position.xyz - fragPos);
+
+    // attenuation
+    float lightDistance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0f / (light.attenuation.x + light.attenuation.y * lightDistance +
+                                light.attenuation.z * (lightDistance * lightDistance));
+
+    vec3 result = CalcShading(lightDirection, light.ambient.rgb, light.diffuse.rgb,
+                              light.specular.rgb, normal, viewDirection);
+    return result * attenuation;
+}
+
+vec3 CalcDirectionalLight(DirectionalLightStruct light, vec3 normal, vec3 viewDirection) {
+    vec3 lightDirection = normalize(-light.direction.xyz);
+
+    return CalcShading(lightDirection, light.ambient.rgb, light.diffuse.rgb, light.specular.rgb,
+                       normal, viewDirection);
+}
+
+vec3 CalcSpotLight(SpotLightStruct light, vec3 normal, vec3 fragPos, vec3 viewDirection) {
+    vec3 lightDirection = normalize(light.position.xyz - fragPos);
+
+    // attenuation
+    float lightDistance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0f / (light.attenuation.x + light.attenuation.y * lightDistance +
+                                light.attenuation.z * (lightDistance * lightDistance));
+
+    // soft edges between the inner and outer cones
+    float theta = dot(lightDirection, normalize(-light.direction.xyz));
+    float epsilon = light.cut_off.x - light.cut_off.y;
+    float intensity = clamp((theta - light.cut_off.y) / epsilon, 0.0, 1.0);
+
+    vec3 result = CalcShading(lightDirection, light.ambient.rgb, light.diffuse.rgb * intensity,
+                              light.specular.rgb * intensity, normal, viewDirection);
+    return result * attenuation;
 }
\ No newline at end of file
@@ -7,6 +7,15 @@
 #include "core/camera.h"
 #include "core/orthographic_camera.h"
 #include "core/perspective_camera.h"
+#include "core/bounds.h"
+#include "core/dynamic_bvh.h"
+#include "core/bvh.h"
+#include "core/range_allocator.h"
+#include "core/mesh_optimizer.h"
+#include "core/mesh_simplifier.h"
+#include "core/mesh_importer.h"
+#include "core/mesh_file.h"
+#include "core/mapped_file.h"
 
 #include "input/events.h"
 #include "input/input.h"
@@ -20,9 +29,19 @@
 #include "renderer/buffers.h"
 #include "renderer/shader.h"
 #include "renderer/texture.h"
+#include "renderer/texture_array.h"
+#include "renderer/image.h"
+#include "renderer/sampler.h"
+#include "renderer/block_compression.h"
+#include "renderer/texture_container.h"
 #include "renderer/skybox.h"
 #include "renderer/renderer3d.h"
 #include "renderer/renderer_api.h"
+#include "renderer/geometry_pool.h"
+#include "renderer/stream_buffer.h"
+#include "renderer/vertex_format.h"
 
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
+#include "systems/geometry_system.h"
+#include "systems/job_system.h"
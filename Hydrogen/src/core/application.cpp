@@ -6,6 +6,8 @@
 #include "renderer/renderer_api.h"
 #include "systems/shader_system.h"
 #include "systems/texture_system.h"
+#include "systems/geometry_system.h"
+#include "systems/job_system.h"
 
 namespace Hydrogen {
 
@@ -13,8 +15,10 @@ Application::Application(i32 width, i32 height, const std::string& title)
     : m_window(width, height, title) {
     m_window.add_event_callback_function([&](Event& event) { on_event(event); });
 
+    JobSystem::init();
     ShaderSystem::init();
     TextureSystem::init();
+    GeometrySystem::init();
 
     Renderer3D::init();
 
@@ -30,6 +34,8 @@ Application::~Application() {
 
     ShaderSystem::free();
     TextureSystem::free();
+    GeometrySystem::free();
+    JobSystem::free();
 
     m_instance = nullptr;
 }
@@ -44,6 +50,9 @@ void Application::run() {
 
         RendererAPI::clear(glm::vec3(0.0f, 0.0f, 0.0f));
 
+        // Streamed textures decoded since the last frame
+        TextureSystem::instance->update();
+
         for (auto& layer : std::ranges::reverse_view(m_layers)) {
             layer->on_update(ts);
         }
@@ -0,0 +1,118 @@
+#include "bounds.h"
+
+namespace Hydrogen {
+
+//
+// AABB
+//
+void AABB::expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+f32 AABB::surface_area() const {
+    const glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool AABB::contains(const AABB& other) const {
+    return glm::all(glm::lessThanEqual(min, other.min)) &&
+           glm::all(glm::greaterThanEqual(max, other.max));
+}
+
+bool AABB::intersects(const AABB& other) const {
+    return glm::all(glm::lessThanEqual(min, other.max)) &&
+           glm::all(glm::greaterThanEqual(max, other.min));
+}
+
+AABB AABB::transform(const glm::mat4& matrix) const {
+    // Transform center and extents instead of the 8 corners (Arvo)
+    const glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+
+    const glm::mat3 abs_matrix = glm::mat3(glm::abs(glm::vec3(matrix[0])),
+                                           glm::abs(glm::vec3(matrix[1])),
+                                           glm::abs(glm::vec3(matrix[2])));
+    const glm::vec3 e = abs_matrix * extents();
+
+    return AABB{.min = c - e, .max = c + e};
+}
+
+AABB AABB::combine(const AABB& a, const AABB& b) {
+    return AABB{.min = glm::min(a.min, b.min), .max = glm::max(a.max, b.max)};
+}
+
+//
+// Bounding Sphere
+//
+BoundingSphere BoundingSphere::transform(const glm::mat4& matrix) const {
+    const f32 scale = glm::max(glm::length(glm::vec3(matrix[0])),
+                               glm::max(glm::length(glm::vec3(matrix[1])),
+                                        glm::length(glm::vec3(matrix[2]))));
+
+    return BoundingSphere{
+        .center = glm::vec3(matrix * glm::vec4(center, 1.0f)),
+        .radius = radius * scale,
+    };
+}
+
+//
+// Frustum
+//
+Frustum::Frustum(const glm::mat4& view_projection) {
+    // glm matrices are column major, so rows are accessed as m[column][row]
+    const auto row = [&](i32 i) {
+        return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i],
+                         view_projection[3][i]);
+    };
+
+    const std::array<glm::vec4, 6> planes = {
+        row(3) + row(0), // left
+        row(3) - row(0), // right
+        row(3) + row(1), // bottom
+        row(3) - row(1), // top
+        row(3) + row(2), // near
+        row(3) - row(2), // far
+    };
+
+    for (usize i = 0; i < planes.size(); ++i) {
+        const f32 length = glm::length(glm::vec3(planes[i]));
+        m_planes[i] = Plane{
+            .normal = glm::vec3(planes[i]) / length,
+            .distance = planes[i].w / length,
+        };
+    }
+}
+
+Frustum::Intersection Frustum::intersects(const AABB& aabb) const {
+    const glm::vec3 center = aabb.center();
+    const glm::vec3 extents = aabb.extents();
+
+    Intersection result = Intersection::Inside;
+    for (const auto& plane : m_planes) {
+        const f32 distance = plane.signed_distance(center);
+        const f32 radius = glm::dot(extents, glm::abs(plane.normal));
+
+        if (distance < -radius)
+            return Intersection::Outside;
+        if (distance < radius)
+            result = Intersection::Intersecting;
+    }
+
+    return result;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    for (const auto& plane : m_planes) {
+        if (plane.signed_distance(sphere.center) < -sphere.radius)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace Hydrogen
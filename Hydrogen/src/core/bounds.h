@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core.h"
+
+#include <array>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+namespace Hydrogen {
+
+struct HG_API AABB {
+    glm::vec3 min{std::numeric_limits<f32>::max()};
+    glm::vec3 max{std::numeric_limits<f32>::lowest()};
+
+    void expand(const glm::vec3& point);
+    void expand(const AABB& other);
+
+    bool is_valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return (max - min) * 0.5f; }
+    f32 surface_area() const;
+
+    bool contains(const AABB& other) const;
+    bool intersects(const AABB& other) const;
+
+    // Bounds of the transformed box
+    AABB transform(const glm::mat4& matrix) const;
+    static AABB combine(const AABB& a, const AABB& b);
+};
+
+struct HG_API BoundingSphere {
+    glm::vec3 center{0.0f};
+    f32 radius = 0.0f;
+
+    BoundingSphere transform(const glm::mat4& matrix) const;
+};
+
+struct HG_API Ray {
+    glm::vec3 origin{0.0f};
+    glm::vec3 direction{0.0f, 0.0f, -1.0f};
+
+    glm::vec3 at(f32 distance) const { return origin + direction * distance; }
+};
+
+struct HG_API Plane {
+    glm::vec3 normal{0.0f, 1.0f, 0.0f};
+    f32 distance = 0.0f;
+
+    f32 signed_distance(const glm::vec3& point) const { return glm::dot(normal, point) + distance; }
+};
+
+class HG_API Frustum {
+  public:
+    enum class Intersection {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    Frustum() = default;
+    // Extracts the planes of the clip space volume, with normals pointing inwards
+    explicit Frustum(const glm::mat4& view_projection);
+
+    Intersection intersects(const AABB& aabb) const;
+    bool intersects(const BoundingSphere& sphere) const;
+
+  private:
+    std::array<Plane, 6> m_planes;
+};
+
+} // namespace Hydrogen
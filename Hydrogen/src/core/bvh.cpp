@@ -0,0 +1,258 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Hydrogen {
+
+#define BVH_NUMBER_BINS 16
+#define BVH_MAX_LEAF_SIZE 8
+// Keeps the traversal stack bounded
+#define BVH_MAX_DEPTH 60
+
+//
+// BVH
+//
+void BVH::build(std::span<const AABB> primitive_bounds) {
+    m_nodes.clear();
+    m_primitives.resize(primitive_bounds.size());
+    std::iota(m_primitives.begin(), m_primitives.end(), 0u);
+
+    if (primitive_bounds.empty())
+        return;
+
+    std::vector<glm::vec3> centroids(primitive_bounds.size());
+    for (usize i = 0; i < primitive_bounds.size(); ++i) {
+        centroids[i] = primitive_bounds[i].center();
+    }
+
+    const auto compute_bounds = [&](u32 first, u32 count) {
+        AABB bounds;
+        for (u32 i = first; i < first + count; ++i) {
+            bounds.expand(primitive_bounds[m_primitives[i]]);
+        }
+        return bounds;
+    };
+
+    m_nodes.reserve(2 * primitive_bounds.size());
+
+    const AABB root_bounds = compute_bounds(0, (u32)primitive_bounds.size());
+    m_nodes.push_back(Node{
+        .min = root_bounds.min,
+        .left_first = 0,
+        .max = root_bounds.max,
+        .count = (u32)primitive_bounds.size(),
+    });
+
+    struct BuildEntry {
+        u32 node;
+        u32 depth;
+    };
+    std::vector<BuildEntry> stack = {{0, 0}};
+
+    while (!stack.empty()) {
+        const auto [node_index, depth] = stack.back();
+        stack.pop_back();
+
+        const u32 first = m_nodes[node_index].left_first;
+        const u32 count = m_nodes[node_index].count;
+
+        if (count <= 2 || depth >= BVH_MAX_DEPTH)
+            continue;
+
+        AABB centroid_bounds;
+        for (u32 i = first; i < first + count; ++i) {
+            centroid_bounds.expand(centroids[m_primitives[i]]);
+        }
+
+        // Find the cheapest split plane among the bin boundaries of the three axes
+        f32 best_cost = std::numeric_limits<f32>::max();
+        i32 best_axis = -1;
+        u32 best_split = 0;
+
+        for (i32 axis = 0; axis < 3; ++axis) {
+            const f32 axis_min = centroid_bounds.min[axis];
+            const f32 axis_extent = centroid_bounds.max[axis] - axis_min;
+            if (axis_extent <= 0.0f)
+                continue;
+
+            std::array<AABB, BVH_NUMBER_BINS> bins{};
+            std::array<u32, BVH_NUMBER_BINS> bin_count{};
+
+            const f32 scale = (f32)BVH_NUMBER_BINS / axis_extent;
+            for (u32 i = first; i < first + count; ++i) {
+                const u32 primitive = m_primitives[i];
+                const auto bin = std::min((u32)((centroids[primitive][axis] - axis_min) * scale),
+                                          (u32)BVH_NUMBER_BINS - 1);
+
+                bins[bin].expand(primitive_bounds[primitive]);
+                bin_count[bin]++;
+            }
+
+            // Sweep from both sides to get the area and count at each side of every plane
+            std::array<f32, BVH_NUMBER_BINS - 1> left_area{}, right_area{};
+            std::array<u32, BVH_NUMBER_BINS - 1> left_count{}, right_count{};
+
+            AABB left_box, right_box;
+            u32 left_sum = 0, right_sum = 0;
+            for (u32 i = 0; i < BVH_NUMBER_BINS - 1; ++i) {
+                left_sum += bin_count[i];
+                left_count[i] = left_sum;
+                if (bin_count[i] > 0)
+                    left_box.expand(bins[i]);
+                left_area[i] = left_box.is_valid() ? left_box.surface_area() : 0.0f;
+
+                const u32 j = BVH_NUMBER_BINS - 1 - i;
+                right_sum += bin_count[j];
+                right_count[j - 1] = right_sum;
+                if (bin_count[j] > 0)
+                    right_box.expand(bins[j]);
+                right_area[j - 1] = right_box.is_valid() ? right_box.surface_area() : 0.0f;
+            }
+
+            for (u32 i = 0; i < BVH_NUMBER_BINS - 1; ++i) {
+                if (left_count[i] == 0 || right_count[i] == 0)
+                    continue;
+
+                const f32 cost = (f32)left_count[i] * left_area[i] + (f32)right_count[i] * right_area[i];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = i;
+                }
+            }
+        }
+
+        const AABB node_bounds{.min = m_nodes[node_index].min, .max = m_nodes[node_index].max};
+        const f32 leaf_cost = (f32)count * node_bounds.surface_area();
+
+        if (best_axis < 0 || (best_cost >= leaf_cost && count <= BVH_MAX_LEAF_SIZE))
+            continue;
+
+        // Partition the primitives around the chosen plane
+        const f32 axis_min = centroid_bounds.min[best_axis];
+        const f32 scale = (f32)BVH_NUMBER_BINS / (centroid_bounds.max[best_axis] - axis_min);
+
+        const auto middle = std::partition(
+            m_primitives.begin() + first, m_primitives.begin() + first + count, [&](u32 primitive) {
+                const auto bin = std::min((u32)((centroids[primitive][best_axis] - axis_min) * scale),
+                                          (u32)BVH_NUMBER_BINS - 1);
+                return bin <= best_split;
+            });
+
+        const auto left_count = (u32)(middle - (m_primitives.begin() + first));
+        const u32 right_count = count - left_count;
+
+        const auto left_index = (u32)m_nodes.size();
+        const AABB left_bounds = compute_bounds(first, left_count);
+        const AABB right_bounds = compute_bounds(first + left_count, right_count);
+
+        m_nodes.push_back(Node{
+            .min = left_bounds.min,
+            .left_first = first,
+            .max = left_bounds.max,
+            .count = left_count,
+        });
+        m_nodes.push_back(Node{
+            .min = right_bounds.min,
+            .left_first = first + left_count,
+            .max = right_bounds.max,
+            .count = right_count,
+        });
+
+        m_nodes[node_index].left_first = left_index;
+        m_nodes[node_index].count = 0;
+
+        stack.push_back({left_index + 1, depth + 1});
+        stack.push_back({left_index, depth + 1});
+    }
+
+    m_nodes.shrink_to_fit();
+}
+
+AABB BVH::get_bounds() const {
+    if (m_nodes.empty())
+        return AABB{};
+
+    return AABB{.min = m_nodes[0].min, .max = m_nodes[0].max};
+}
+
+f32 BVH::intersect_node(const Node& node, const Ray& ray, const glm::vec3& inverse_direction, f32 closest) {
+    // Slab test
+    const glm::vec3 t0 = (node.min - ray.origin) * inverse_direction;
+    const glm::vec3 t1 = (node.max - ray.origin) * inverse_direction;
+
+    const glm::vec3 t_min = glm::min(t0, t1);
+    const glm::vec3 t_max = glm::max(t0, t1);
+
+    const f32 entry = glm::max(glm::max(t_min.x, t_min.y), glm::max(t_min.z, 0.0f));
+    const f32 exit = glm::min(glm::min(t_max.x, t_max.y), glm::min(t_max.z, closest));
+
+    return entry <= exit ? entry : std::numeric_limits<f32>::max();
+}
+
+//
+// Triangle BVH
+//
+void TriangleBVH::build(std::span<const glm::vec3> positions, std::span<const u32> indices) {
+    const usize number_triangles = indices.size() / 3;
+
+    std::vector<AABB> triangle_bounds(number_triangles);
+    for (usize i = 0; i < number_triangles; ++i) {
+        triangle_bounds[i].expand(positions[indices[3 * i]]);
+        triangle_bounds[i].expand(positions[indices[3 * i + 1]]);
+        triangle_bounds[i].expand(positions[indices[3 * i + 2]]);
+    }
+
+    m_bvh.build(triangle_bounds);
+
+    // Store triangles in BVH order so leaves read contiguous memory
+    m_triangles.resize(number_triangles);
+    for (u32 i = 0; i < number_triangles; ++i) {
+        const u32 triangle = m_bvh.get_primitive(i);
+
+        const glm::vec3& v0 = positions[indices[3 * triangle]];
+        const glm::vec3& v1 = positions[indices[3 * triangle + 1]];
+        const glm::vec3& v2 = positions[indices[3 * triangle + 2]];
+
+        m_triangles[i] = Triangle{.v0 = v0, .edge1 = v1 - v0, .edge2 = v2 - v0};
+    }
+}
+
+bool TriangleBVH::raycast(const Ray& ray, f32& closest, RayHit& hit) const {
+    return m_bvh.traverse(ray, closest, [&](u32 position, f32& t_closest) {
+        // Möller-Trumbore intersection
+        const Triangle& triangle = m_triangles[position];
+
+        const glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+        const f32 determinant = glm::dot(triangle.edge1, p);
+        if (std::abs(determinant) < 1e-8f)
+            return false;
+
+        const f32 inverse_determinant = 1.0f / determinant;
+
+        const glm::vec3 s = ray.origin - triangle.v0;
+        const f32 u = glm::dot(s, p) * inverse_determinant;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+
+        const glm::vec3 q = glm::cross(s, triangle.edge1);
+        const f32 v = glm::dot(ray.direction, q) * inverse_determinant;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+
+        const f32 t = glm::dot(triangle.edge2, q) * inverse_determinant;
+        if (t < 0.0f || t >= t_closest)
+            return false;
+
+        t_closest = t;
+        hit.distance = t;
+        hit.position = ray.at(t);
+        hit.triangle = m_bvh.get_primitive(position);
+        hit.barycentrics = glm::vec2(u, v);
+
+        return true;
+    });
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "core.h"
+
+#include <array>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/bounds.h"
+
+namespace Hydrogen {
+
+// Static bounding volume hierarchy built with the binned surface area heuristic. Nodes are
+// stored in a flat array in depth first order, with the two children of a node next to each
+// other, and primitives are referenced through a permutation so callers can reorder their data.
+class HG_API BVH {
+  public:
+    struct Node {
+        glm::vec3 min;
+        // First primitive if leaf, index of the left child otherwise (right = left + 1)
+        u32 left_first;
+        glm::vec3 max;
+        // Number of primitives, 0 for interior nodes
+        u32 count;
+
+        bool is_leaf() const { return count > 0; }
+    };
+    static_assert(sizeof(Node) == 32, "BVH nodes must fit in half a cache line");
+
+    BVH() = default;
+    ~BVH() = default;
+
+    BVH(BVH&&) = default;
+    BVH& operator=(BVH&&) = default;
+
+    void build(std::span<const AABB> primitive_bounds);
+
+    bool is_empty() const { return m_nodes.empty(); }
+    const std::vector<Node>& get_nodes() const { return m_nodes; }
+    // Original index of the primitive stored at the given position
+    u32 get_primitive(u32 position) const { return m_primitives[position]; }
+    AABB get_bounds() const;
+
+    // Calls intersect(position, closest) for every primitive whose leaf is hit before closest.
+    // The callback returns true and lowers closest when it finds a nearer hit.
+    template <typename F>
+    bool traverse(const Ray& ray, f32& closest, F&& intersect) const;
+
+  private:
+    std::vector<Node> m_nodes;
+    std::vector<u32> m_primitives;
+
+    static f32 intersect_node(const Node& node, const Ray& ray, const glm::vec3& inverse_direction, f32 closest);
+};
+
+template <typename F>
+bool BVH::traverse(const Ray& ray, f32& closest, F&& intersect) const {
+    if (m_nodes.empty())
+        return false;
+
+    const glm::vec3 inverse_direction = 1.0f / ray.direction;
+    bool hit = false;
+
+    std::array<u32, 64> stack{};
+    u32 stack_size = 0;
+
+    if (intersect_node(m_nodes[0], ray, inverse_direction, closest) == std::numeric_limits<f32>::max())
+        return false;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const Node& node = m_nodes[stack[--stack_size]];
+
+        if (node.is_leaf()) {
+            for (u32 i = node.left_first; i < node.left_first + node.count; ++i) {
+                hit |= intersect(i, closest);
+            }
+            continue;
+        }
+
+        // Visit the nearest child first so farther ones can be rejected by the closest hit
+        u32 near_child = node.left_first;
+        u32 far_child = node.left_first + 1;
+
+        f32 near_distance = intersect_node(m_nodes[near_child], ray, inverse_direction, closest);
+        f32 far_distance = intersect_node(m_nodes[far_child], ray, inverse_direction, closest);
+
+        if (far_distance < near_distance) {
+            std::swap(near_child, far_child);
+            std::swap(near_distance, far_distance);
+        }
+
+        if (far_distance != std::numeric_limits<f32>::max())
+            stack[stack_size++] = far_child;
+        if (near_distance != std::numeric_limits<f32>::max())
+            stack[stack_size++] = near_child;
+    }
+
+    return hit;
+}
+
+struct HG_API RayHit {
+    f32 distance;
+    glm::vec3 position;
+
+    u32 mesh;
+    u32 triangle;
+    // Weights of the second and third vertices of the triangle
+    glm::vec2 barycentrics;
+};
+
+// BVH over the triangles of a mesh, keeps its own copy of the positions in BVH order
+class HG_API TriangleBVH {
+  public:
+    TriangleBVH() = default;
+    ~TriangleBVH() = default;
+
+    TriangleBVH(TriangleBVH&&) = default;
+    TriangleBVH& operator=(TriangleBVH&&) = default;
+
+    void build(std::span<const glm::vec3> positions, std::span<const u32> indices);
+
+    bool raycast(const Ray& ray, f32& closest, RayHit& hit) const;
+    AABB get_bounds() const { return m_bvh.get_bounds(); }
+
+  private:
+    struct Triangle {
+        glm::vec3 v0;
+        glm::vec3 edge1;
+        glm::vec3 edge2;
+    };
+
+    BVH m_bvh;
+    std::vector<Triangle> m_triangles;
+};
+
+} // namespace Hydrogen
@@ -4,6 +4,8 @@
 
 #include "glm/glm.hpp"
 
+#include "core/bounds.h"
+
 namespace Hydrogen {
 
 class HG_API Camera {
@@ -19,6 +21,7 @@ class HG_API Camera {
     const glm::mat4& get_projection() const { return m_projection; }
 
     glm::mat4 get_view_projection() const { return m_projection * m_view; }
+    Frustum get_frustum() const { return Frustum(get_view_projection()); }
 
   protected:
     glm::mat4 m_projection;
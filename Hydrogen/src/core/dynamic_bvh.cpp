@@ -0,0 +1,296 @@
+#include "dynamic_bvh.h"
+
+#include <algorithm>
+
+namespace Hydrogen {
+
+// Enlargement of the leaf bounds, in world units
+#define FAT_AABB_MARGIN 0.1f
+
+i32 DynamicBVH::insert(const AABB& bounds, u32 data) {
+    const i32 proxy = allocate_node();
+
+    auto& node = m_nodes[(usize)proxy];
+    node.bounds = AABB{.min = bounds.min - FAT_AABB_MARGIN, .max = bounds.max + FAT_AABB_MARGIN};
+    node.data = data;
+    node.height = 0;
+
+    insert_leaf(proxy);
+    return proxy;
+}
+
+void DynamicBVH::remove(i32 proxy) {
+    HG_ASSERT(m_nodes[(usize)proxy].is_leaf(), "Proxy {} is not a leaf of the DynamicBVH", proxy);
+
+    remove_leaf(proxy);
+    free_node(proxy);
+}
+
+bool DynamicBVH::move(i32 proxy, const AABB& bounds) {
+    HG_ASSERT(m_nodes[(usize)proxy].is_leaf(), "Proxy {} is not a leaf of the DynamicBVH", proxy);
+
+    if (m_nodes[(usize)proxy].bounds.contains(bounds))
+        return false;
+
+    remove_leaf(proxy);
+    m_nodes[(usize)proxy].bounds =
+        AABB{.min = bounds.min - FAT_AABB_MARGIN, .max = bounds.max + FAT_AABB_MARGIN};
+    insert_leaf(proxy);
+
+    return true;
+}
+
+void DynamicBVH::query(const Frustum& frustum, std::vector<u32>& result) const {
+    if (m_root == NULL_NODE)
+        return;
+
+    std::vector<i32> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+        const i32 index = stack.back();
+        stack.pop_back();
+
+        const Node& node = m_nodes[(usize)index];
+
+        const auto intersection = frustum.intersects(node.bounds);
+        if (intersection == Frustum::Intersection::Outside)
+            continue;
+
+        // Every leaf under a node fully inside the frustum is visible
+        if (intersection == Frustum::Intersection::Inside || node.is_leaf()) {
+            collect_leaves(index, result);
+            continue;
+        }
+
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
+
+void DynamicBVH::clear() {
+    m_nodes.clear();
+    m_root = NULL_NODE;
+    m_free_list = NULL_NODE;
+}
+
+i32 DynamicBVH::allocate_node() {
+    if (m_free_list == NULL_NODE) {
+        m_nodes.emplace_back();
+        return (i32)m_nodes.size() - 1;
+    }
+
+    const i32 node = m_free_list;
+    m_free_list = m_nodes[(usize)node].parent;
+    m_nodes[(usize)node] = Node{};
+
+    return node;
+}
+
+void DynamicBVH::free_node(i32 node) {
+    m_nodes[(usize)node] = Node{};
+    m_nodes[(usize)node].parent = m_free_list;
+    m_free_list = node;
+}
+
+void DynamicBVH::insert_leaf(i32 leaf) {
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[(usize)leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling, descending towards the child with the lowest area increase
+    const AABB leaf_bounds = m_nodes[(usize)leaf].bounds;
+
+    i32 index = m_root;
+    while (!m_nodes[(usize)index].is_leaf()) {
+        const Node& node = m_nodes[(usize)index];
+
+        const f32 area = node.bounds.surface_area();
+        const f32 combined_area = AABB::combine(node.bounds, leaf_bounds).surface_area();
+
+        // Cost of creating a new parent for this node and the leaf
+        const f32 cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down the tree
+        const f32 inheritance_cost = 2.0f * (combined_area - area);
+
+        const auto child_cost = [&](i32 child) {
+            const AABB& child_bounds = m_nodes[(usize)child].bounds;
+            const f32 new_area = AABB::combine(child_bounds, leaf_bounds).surface_area();
+
+            if (m_nodes[(usize)child].is_leaf())
+                return new_area + inheritance_cost;
+            return (new_area - child_bounds.surface_area()) + inheritance_cost;
+        };
+
+        const f32 cost_left = child_cost(node.left);
+        const f32 cost_right = child_cost(node.right);
+
+        if (cost < cost_left && cost < cost_right)
+            break;
+
+        index = cost_left < cost_right ? node.left : node.right;
+    }
+
+    const i32 sibling = index;
+
+    // Create a new parent for the sibling and the leaf
+    const i32 old_parent = m_nodes[(usize)sibling].parent;
+    const i32 new_parent = allocate_node();
+
+    auto& parent_node = m_nodes[(usize)new_parent];
+    parent_node.parent = old_parent;
+    parent_node.bounds = AABB::combine(leaf_bounds, m_nodes[(usize)sibling].bounds);
+    parent_node.height = m_nodes[(usize)sibling].height + 1;
+    parent_node.left = sibling;
+    parent_node.right = leaf;
+
+    if (old_parent != NULL_NODE) {
+        if (m_nodes[(usize)old_parent].left == sibling)
+            m_nodes[(usize)old_parent].left = new_parent;
+        else
+            m_nodes[(usize)old_parent].right = new_parent;
+    } else {
+        m_root = new_parent;
+    }
+
+    m_nodes[(usize)sibling].parent = new_parent;
+    m_nodes[(usize)leaf].parent = new_parent;
+
+    // Walk back up fixing heights and bounds
+    index = m_nodes[(usize)leaf].parent;
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node& node = m_nodes[(usize)index];
+        const Node& left = m_nodes[(usize)node.left];
+        const Node& right = m_nodes[(usize)node.right];
+
+        node.height = 1 + std::max(left.height, right.height);
+        node.bounds = AABB::combine(left.bounds, right.bounds);
+
+        index = node.parent;
+    }
+}
+
+void DynamicBVH::remove_leaf(i32 leaf) {
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    const i32 parent = m_nodes[(usize)leaf].parent;
+    const i32 grand_parent = m_nodes[(usize)parent].parent;
+    const i32 sibling = m_nodes[(usize)parent].left == leaf ? m_nodes[(usize)parent].right
+                                                            : m_nodes[(usize)parent].left;
+
+    if (grand_parent == NULL_NODE) {
+        m_root = sibling;
+        m_nodes[(usize)sibling].parent = NULL_NODE;
+        free_node(parent);
+        return;
+    }
+
+    // Replace the parent with the sibling
+    if (m_nodes[(usize)grand_parent].left == parent)
+        m_nodes[(usize)grand_parent].left = sibling;
+    else
+        m_nodes[(usize)grand_parent].right = sibling;
+    m_nodes[(usize)sibling].parent = grand_parent;
+    free_node(parent);
+
+    i32 index = grand_parent;
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node& node = m_nodes[(usize)index];
+        const Node& left = m_nodes[(usize)node.left];
+        const Node& right = m_nodes[(usize)node.right];
+
+        node.bounds = AABB::combine(left.bounds, right.bounds);
+        node.height = 1 + std::max(left.height, right.height);
+
+        index = node.parent;
+    }
+}
+
+// Rotates the subtree rooted at a if it is imbalanced, returns the new subtree root
+i32 DynamicBVH::balance(i32 a) {
+    Node& A = m_nodes[(usize)a];
+    if (A.is_leaf() || A.height < 2)
+        return a;
+
+    const i32 b = A.left;
+    const i32 c = A.right;
+    Node& B = m_nodes[(usize)b];
+    Node& C = m_nodes[(usize)c];
+
+    const i32 balance_factor = C.height - B.height;
+
+    // Rotate the taller child up
+    const auto rotate = [&](i32 up, i32 down_sibling, bool up_is_right) -> i32 {
+        Node& U = m_nodes[(usize)up];
+        const i32 f = U.left;
+        const i32 g = U.right;
+        Node& F = m_nodes[(usize)f];
+        Node& G = m_nodes[(usize)g];
+        Node& S = m_nodes[(usize)down_sibling];
+
+        // Swap A and U
+        U.left = a;
+        U.parent = A.parent;
+        A.parent = up;
+
+        if (U.parent != NULL_NODE) {
+            if (m_nodes[(usize)U.parent].left == a)
+                m_nodes[(usize)U.parent].left = up;
+            else
+                m_nodes[(usize)U.parent].right = up;
+        } else {
+            m_root = up;
+        }
+
+        // Keep the taller grandchild under U, move the other one under A
+        const bool f_taller = F.height > G.height;
+        const i32 keep = f_taller ? f : g;
+        const i32 move = f_taller ? g : f;
+        Node& K = m_nodes[(usize)keep];
+        Node& M = m_nodes[(usize)move];
+
+        U.right = keep;
+        if (up_is_right)
+            A.right = move;
+        else
+            A.left = move;
+        M.parent = a;
+
+        A.bounds = AABB::combine(S.bounds, M.bounds);
+        U.bounds = AABB::combine(A.bounds, K.bounds);
+
+        A.height = 1 + std::max(S.height, M.height);
+        U.height = 1 + std::max(A.height, K.height);
+
+        return up;
+    };
+
+    if (balance_factor > 1)
+        return rotate(c, b, true);
+    if (balance_factor < -1)
+        return rotate(b, c, false);
+
+    return a;
+}
+
+void DynamicBVH::collect_leaves(i32 node, std::vector<u32>& result) const {
+    const Node& n = m_nodes[(usize)node];
+    if (n.is_leaf()) {
+        result.push_back(n.data);
+        return;
+    }
+
+    collect_leaves(n.left, result);
+    collect_leaves(n.right, result);
+}
+
+} // namespace Hydrogen
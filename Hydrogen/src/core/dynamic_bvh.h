@@ -0,0 +1,63 @@
+#pragma once
+
+#include "core.h"
+
+#include <vector>
+
+#include "core/bounds.h"
+
+namespace Hydrogen {
+
+// Incrementally updated AABB tree of scene objects. Leaves store enlarged (fat) bounds so small
+// movements do not require reinsertion, and the tree is kept balanced with AVL style rotations.
+class HG_API DynamicBVH {
+  public:
+    static constexpr i32 NULL_NODE = -1;
+
+    DynamicBVH() = default;
+    ~DynamicBVH() = default;
+
+    i32 insert(const AABB& bounds, u32 data);
+    void remove(i32 proxy);
+    // Returns true if the proxy had to be reinserted
+    bool move(i32 proxy, const AABB& bounds);
+
+    u32 get_data(i32 proxy) const { return m_nodes[(usize)proxy].data; }
+    const AABB& get_fat_bounds(i32 proxy) const { return m_nodes[(usize)proxy].bounds; }
+
+    // Appends the data of every leaf not outside of the frustum
+    void query(const Frustum& frustum, std::vector<u32>& result) const;
+
+    void clear();
+
+  private:
+    struct Node {
+        AABB bounds;
+        u32 data = 0;
+
+        // Parent index, or next free node when the node is in the free list
+        i32 parent = NULL_NODE;
+        i32 left = NULL_NODE;
+        i32 right = NULL_NODE;
+
+        // Leaf = 0, free node = -1
+        i32 height = -1;
+
+        bool is_leaf() const { return left == NULL_NODE; }
+    };
+
+    std::vector<Node> m_nodes;
+    i32 m_root = NULL_NODE;
+    i32 m_free_list = NULL_NODE;
+
+    i32 allocate_node();
+    void free_node(i32 node);
+
+    void insert_leaf(i32 leaf);
+    void remove_leaf(i32 leaf);
+    i32 balance(i32 node);
+
+    void collect_leaves(i32 node, std::vector<u32>& result) const;
+};
+
+} // namespace Hydrogen
@@ -0,0 +1,35 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Hydrogen {
+
+MappedFile::MappedFile(const std::string& path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return;
+
+    struct stat status {};
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        const auto size = (usize)status.st_size;
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        if (data != MAP_FAILED) {
+            m_data = static_cast<const u8*>(data);
+            m_size = size;
+        }
+    }
+
+    // The mapping stays valid after closing the descriptor
+    close(file);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr)
+        munmap(const_cast<u8*>(m_data), m_size);
+}
+
+} // namespace Hydrogen
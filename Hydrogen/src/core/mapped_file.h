@@ -0,0 +1,31 @@
+#pragma once
+
+#include "core.h"
+
+#include <span>
+#include <string>
+
+namespace Hydrogen {
+
+// Read only memory mapping of a whole file, pages are loaded by the OS on first access
+class HG_API MappedFile {
+  public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file could not be opened or is empty
+    bool is_valid() const { return m_data != nullptr; }
+
+    const u8* get_data() const { return m_data; }
+    usize get_size() const { return m_size; }
+    std::span<const u8> get_bytes() const { return {m_data, m_size}; }
+
+  private:
+    const u8* m_data = nullptr;
+    usize m_size = 0;
+};
+
+} // namespace Hydrogen
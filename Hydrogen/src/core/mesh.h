@@ -2,45 +2,88 @@
 
 #include "core.h"
 
-#include <string>
+#include <span>
 #include <vector>
 
 #include "glm/glm.hpp"
-#include "assimp/scene.h"
 
 #include "renderer/vertex_array.h"
 #include "renderer/buffers.h"
 #include "renderer/shader.h"
 #include "renderer/texture.h"
+#include "renderer/geometry_pool.h"
+#include "renderer/vertex_format.h"
 
 #include "material/material.h"
+#include "core/bounds.h"
+#include "core/bvh.h"
+#include "core/mesh_optimizer.h"
 
 namespace Hydrogen {
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texture_coordinates;
-    glm::vec3 tangent;
+struct HG_API MeshLOD {
+    DrawRange range;
+    // Geometric error relative to the radius of the bounding sphere, 0 for full detail
+    f32 error = 0.0f;
+};
+
+// CPU side data of a mesh ready for upload, produced by ImportedMesh or read from a baked file
+struct HG_API MeshGeometry {
+    std::span<const PackedVertex> vertices;
+    // Full detail indices followed by the indices of every other level
+    std::span<const u32> indices;
+    // Ranges relative to the start of indices and to the first vertex
+    std::span<const MeshLOD> lods;
+
+    AABB bounds;
+    BoundingSphere bounding_sphere;
+
+    VertexCacheStatistics imported_cache_statistics;
+    VertexCacheStatistics cache_statistics;
 };
 
 class HG_API Mesh {
   public:
-    VertexArray* VAO;
+    // Vertex array of the shared geometry pool and the part of it used by this mesh
+    const VertexArray* VAO;
+    // Binds only positions when the mesh is split in two streams, otherwise the same as VAO.
+    // Drawn with the same range, for depth only passes
+    const VertexArray* position_VAO;
+    // Full detail range, same as lods[0].range
+    DrawRange range;
+    // From most to least detailed, all of them index the same vertices
+    std::vector<MeshLOD> lods;
     IMaterial* material = nullptr;
 
-    Mesh(const aiMesh* mesh, const aiScene* scene, const std::string& directory);
+    // Object space bounds
+    AABB bounds;
+    BoundingSphere bounding_sphere;
+
+    // Post-transform cache efficiency of the imported triangle order and of the optimized one
+    VertexCacheStatistics imported_cache_statistics;
+    VertexCacheStatistics cache_statistics;
+
+    // Uploads the geometry and takes ownership of the material. The BVH comes from build_bvh, which can run
+    // on any thread
+    Mesh(const MeshGeometry& geometry,
+         IMaterial* mesh_material,
+         TriangleBVH&& triangle_bvh,
+         bool split_positions = false);
     ~Mesh();
 
+    // Closest hit of an object space ray nearer than closest, updates closest and hit on success
+    bool raycast(const Ray& ray, f32& closest, RayHit& hit) const;
+
+    // BVH over the full detail triangles
+    static TriangleBVH build_bvh(const MeshGeometry& geometry);
+
   private:
-    std::vector<Vertex> vertices;
-    std::vector<u32> indices;
+    TriangleBVH bvh;
 
-    void setup_mesh();
+    GeometryPool* pool;
+    GeometryAllocation allocation;
 
-    // Material loaders
-    IMaterial* load_phong_material(const aiMaterial* mat, const std::string& directory);
-    IMaterial* load_pbr_material(const aiMaterial* mat, const std::string& directory);
+    void setup_mesh(const MeshGeometry& geometry, bool split_positions);
 };
 
 }
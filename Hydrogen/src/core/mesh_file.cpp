@@ -0,0 +1,439 @@
+#include "mesh_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace Hydrogen {
+
+// Alignment of every array in the file
+#define MESH_FILE_ALIGNMENT 16
+
+//
+// Layout
+//
+
+struct MeshFile::Header {
+    u32 magic;
+    u32 version;
+    u64 source_hash;
+
+    u64 meshes_offset;
+    u64 materials_offset;
+    u64 dependencies_offset;
+    u64 node_meshes_offset;
+    u64 strings_offset;
+
+    u32 mesh_count;
+    u32 material_count;
+    u32 dependency_count;
+    u32 node_mesh_count;
+    u32 strings_size;
+};
+
+struct MeshFile::MeshRecord {
+    u64 vertices_offset;
+    u64 indices_offset;
+    u64 lods_offset;
+
+    u32 vertex_count;
+    u32 index_count;
+    u32 lod_count;
+    u32 material;
+
+    AABB bounds;
+    BoundingSphere bounding_sphere;
+
+    VertexCacheStatistics imported_cache_statistics;
+    VertexCacheStatistics cache_statistics;
+};
+
+// Range of the string table, empty strings have size 0
+struct StringReference {
+    u32 offset;
+    u32 size;
+};
+
+// Optional values present in a material
+enum MaterialRecordFlags : u32 {
+    HasDiffuse = 1 << 0,
+    HasSpecular = 1 << 1,
+    HasShininess = 1 << 2,
+    HasAlbedo = 1 << 3,
+    HasMetallic = 1 << 4,
+    HasRoughness = 1 << 5,
+    MetallicRoughnessSameTexture = 1 << 6,
+    MetallicRoughnessAOSameTexture = 1 << 7,
+};
+
+struct MeshFile::MaterialRecord {
+    u32 shading;
+    u32 flags;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    f32 shininess;
+
+    glm::vec3 albedo;
+    f32 metallic;
+    f32 roughness;
+
+    StringReference textures[std::size(MATERIAL_DESCRIPTION_TEXTURES)];
+};
+
+// File read by the importer besides the source, path as the importer opened it
+struct MeshFile::DependencyRecord {
+    StringReference path;
+    u64 hash;
+};
+
+static_assert(std::is_trivially_copyable_v<PackedVertex> && std::is_trivially_copyable_v<MeshLOD>,
+              "Baked arrays are used in place");
+
+//
+// Reading
+//
+
+MeshFile::MeshFile(const std::string& path, u64 source_hash) : m_file(path) {
+    if (!m_file.is_valid() || m_file.get_size() < sizeof(Header))
+        return;
+
+    const auto* header = reinterpret_cast<const Header*>(m_file.get_data());
+    if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION)
+        return;
+    if (header->source_hash != source_hash)
+        return;
+
+    m_header = header;
+    if (!validate()) {
+        HG_LOG_WARN("Baked mesh file {} is malformed, importing the source again", path);
+        m_header = nullptr;
+    } else if (!dependencies_unchanged()) {
+        HG_LOG_INFO("Files baked into {} changed, importing the source again", path);
+        m_header = nullptr;
+    }
+}
+
+u32 MeshFile::get_mesh_count() const {
+    return m_header->mesh_count;
+}
+
+MeshGeometry MeshFile::get_geometry(u32 mesh) const {
+    const auto& record = get_array<MeshRecord>(m_header->meshes_offset, m_header->mesh_count)[mesh];
+
+    return MeshGeometry{
+        .vertices = get_array<PackedVertex>(record.vertices_offset, record.vertex_count),
+        .indices = get_array<u32>(record.indices_offset, record.index_count),
+        .lods = get_array<MeshLOD>(record.lods_offset, record.lod_count),
+        .bounds = record.bounds,
+        .bounding_sphere = record.bounding_sphere,
+        .imported_cache_statistics = record.imported_cache_statistics,
+        .cache_statistics = record.cache_statistics,
+    };
+}
+
+u32 MeshFile::get_material_index(u32 mesh) const {
+    return get_array<MeshRecord>(m_header->meshes_offset, m_header->mesh_count)[mesh].material;
+}
+
+u32 MeshFile::get_material_count() const {
+    return m_header->material_count;
+}
+
+MaterialDescription MeshFile::get_material(u32 material) const {
+    const auto& record = get_array<MaterialRecord>(m_header->materials_offset, m_header->material_count)[material];
+    const auto strings = get_array<char>(m_header->strings_offset, m_header->strings_size);
+
+    const auto load = [&]<typename T>(std::optional<T>& value, const T& stored, u32 flag) {
+        if (record.flags & flag)
+            value = stored;
+    };
+
+    MaterialDescription description;
+    description.shading = static_cast<MaterialDescription::Shading>(record.shading);
+
+    description.ambient = record.ambient;
+    load(description.diffuse, record.diffuse, HasDiffuse);
+    load(description.specular, record.specular, HasSpecular);
+    load(description.shininess, record.shininess, HasShininess);
+
+    load(description.albedo, record.albedo, HasAlbedo);
+    load(description.metallic, record.metallic, HasMetallic);
+    load(description.roughness, record.roughness, HasRoughness);
+
+    description.metallic_roughness_same_texture = (record.flags & MetallicRoughnessSameTexture) != 0;
+    description.metallic_roughness_ao_same_texture = (record.flags & MetallicRoughnessAOSameTexture) != 0;
+
+    for (u32 i = 0; i < std::size(MATERIAL_DESCRIPTION_TEXTURES); ++i) {
+        const auto& texture = record.textures[i];
+        description.*MATERIAL_DESCRIPTION_TEXTURES[i].path = std::string(strings.data() + texture.offset, texture.size);
+    }
+
+    return description;
+}
+
+std::span<const u32> MeshFile::get_node_meshes() const {
+    return get_array<u32>(m_header->node_meshes_offset, m_header->node_mesh_count);
+}
+
+template <typename T>
+std::span<const T> MeshFile::get_array(u64 offset, u64 count) const {
+    return {reinterpret_cast<const T*>(m_file.get_data() + offset), (usize)count};
+}
+
+bool MeshFile::validate() const {
+    const auto contains = [&](u64 offset, u64 count, u64 element_size) {
+        return offset % MESH_FILE_ALIGNMENT == 0 && offset <= m_file.get_size()
+               && count <= (m_file.get_size() - offset) / element_size;
+    };
+
+    if (!contains(m_header->meshes_offset, m_header->mesh_count, sizeof(MeshRecord))
+        || !contains(m_header->materials_offset, m_header->material_count, sizeof(MaterialRecord))
+        || !contains(m_header->dependencies_offset, m_header->dependency_count, sizeof(DependencyRecord))
+        || !contains(m_header->node_meshes_offset, m_header->node_mesh_count, sizeof(u32))
+        || !contains(m_header->strings_offset, m_header->strings_size, sizeof(char)))
+        return false;
+
+    for (const auto& record : get_array<MeshRecord>(m_header->meshes_offset, m_header->mesh_count)) {
+        if (!contains(record.vertices_offset, record.vertex_count, sizeof(PackedVertex))
+            || !contains(record.indices_offset, record.index_count, sizeof(u32))
+            || !contains(record.lods_offset, record.lod_count, sizeof(MeshLOD)))
+            return false;
+
+        if (record.lod_count == 0 || record.material >= m_header->material_count)
+            return false;
+
+        for (const auto& lod : get_array<MeshLOD>(record.lods_offset, record.lod_count)) {
+            if ((u64)lod.range.first_index + lod.range.index_count > record.index_count)
+                return false;
+        }
+
+        // Draws offset indices by the first vertex of the mesh, larger ones would read other meshes of the pool
+        for (u32 index : get_array<u32>(record.indices_offset, record.index_count)) {
+            if (index >= record.vertex_count)
+                return false;
+        }
+    }
+
+    for (const auto& record : get_array<MaterialRecord>(m_header->materials_offset, m_header->material_count)) {
+        if (record.shading > (u32)MaterialDescription::Shading::PBR)
+            return false;
+
+        for (const auto& texture : record.textures) {
+            if ((u64)texture.offset + texture.size > m_header->strings_size)
+                return false;
+        }
+    }
+
+    for (const auto& record : get_array<DependencyRecord>(m_header->dependencies_offset, m_header->dependency_count)) {
+        if ((u64)record.path.offset + record.path.size > m_header->strings_size)
+            return false;
+    }
+
+    for (u32 mesh : get_node_meshes()) {
+        if (mesh >= m_header->mesh_count)
+            return false;
+    }
+
+    return true;
+}
+
+//
+// Hashing
+//
+
+// 64 bit FNV-1a
+static u64 hash_bytes(std::span<const u8> bytes, u64 hash = 0xcbf29ce484222325) {
+    for (u8 byte : bytes) {
+        hash ^= byte;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static std::optional<u64> hash_file(const std::string& path) {
+    const MappedFile file(path);
+    if (file.is_valid())
+        return hash_bytes(file.get_bytes());
+
+    // Empty files have no mapping
+    std::error_code error;
+    if (std::filesystem::is_regular_file(path, error) && std::filesystem::file_size(path, error) == 0)
+        return hash_bytes({});
+    return std::nullopt;
+}
+
+std::optional<u64> MeshFile::hash_source(const std::string& path, u32 options) {
+    const auto hash = hash_file(path);
+    if (!hash.has_value())
+        return std::nullopt;
+
+    return hash_bytes(std::span(reinterpret_cast<const u8*>(&options), sizeof(options)), hash.value());
+}
+
+bool MeshFile::dependencies_unchanged() const {
+    const auto strings = get_array<char>(m_header->strings_offset, m_header->strings_size);
+
+    for (const auto& record : get_array<DependencyRecord>(m_header->dependencies_offset, m_header->dependency_count)) {
+        const std::string path(strings.data() + record.path.offset, record.path.size);
+        if (hash_file(path) != record.hash)
+            return false;
+    }
+    return true;
+}
+
+//
+// Writing
+//
+
+// Appends arrays at aligned offsets
+class MeshFileWriter {
+  public:
+    u64 append(const void* data, usize size) {
+        const usize offset = (m_bytes.size() + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+        m_bytes.resize(offset + size);
+        if (size > 0)
+            std::memcpy(m_bytes.data() + offset, data, size);
+        return offset;
+    }
+
+    template <typename T>
+    u64 append(std::span<const T> values) {
+        return append(values.data(), values.size_bytes());
+    }
+
+    template <typename T>
+    void write_at(u64 offset, std::span<const T> values) {
+        std::memcpy(m_bytes.data() + offset, values.data(), values.size_bytes());
+    }
+
+    const std::vector<u8>& get_bytes() const { return m_bytes; }
+
+  private:
+    std::vector<u8> m_bytes;
+};
+
+bool MeshFile::write(const std::string& path,
+                     u64 source_hash,
+                     std::span<const ImportedMesh* const> meshes,
+                     std::span<const MaterialDescription> materials,
+                     std::span<const u32> node_meshes,
+                     std::span<const std::string> dependencies) {
+    MeshFileWriter writer;
+
+    // Tables are written with placeholders and filled once the offsets of the data are known
+    Header header{};
+    writer.append(&header, sizeof(Header));
+
+    std::vector<MeshRecord> mesh_records(meshes.size());
+    std::vector<MaterialRecord> material_records(materials.size());
+    std::vector<DependencyRecord> dependency_records(dependencies.size());
+
+    header.meshes_offset = writer.append<MeshRecord>(mesh_records);
+    header.materials_offset = writer.append<MaterialRecord>(material_records);
+    header.dependencies_offset = writer.append<DependencyRecord>(dependency_records);
+    header.node_meshes_offset = writer.append(node_meshes);
+
+    for (u32 i = 0; i < meshes.size(); ++i) {
+        const MeshGeometry geometry = meshes[i]->get_geometry();
+
+        mesh_records[i] = MeshRecord{
+            .vertices_offset = writer.append(geometry.vertices),
+            .indices_offset = writer.append(geometry.indices),
+            .lods_offset = writer.append(geometry.lods),
+            .vertex_count = (u32)geometry.vertices.size(),
+            .index_count = (u32)geometry.indices.size(),
+            .lod_count = (u32)geometry.lods.size(),
+            .material = meshes[i]->get_material(),
+            .bounds = geometry.bounds,
+            .bounding_sphere = geometry.bounding_sphere,
+            .imported_cache_statistics = geometry.imported_cache_statistics,
+            .cache_statistics = geometry.cache_statistics,
+        };
+    }
+
+    std::string strings;
+    const auto store = [&]<typename T>(const std::optional<T>& value, T& stored, u32 flag, u32& flags) {
+        if (!value.has_value())
+            return;
+        stored = *value;
+        flags |= flag;
+    };
+
+    for (u32 i = 0; i < materials.size(); ++i) {
+        const auto& description = materials[i];
+        auto& record = material_records[i];
+
+        record.shading = static_cast<u32>(description.shading);
+
+        record.ambient = description.ambient;
+        store(description.diffuse, record.diffuse, HasDiffuse, record.flags);
+        store(description.specular, record.specular, HasSpecular, record.flags);
+        store(description.shininess, record.shininess, HasShininess, record.flags);
+
+        store(description.albedo, record.albedo, HasAlbedo, record.flags);
+        store(description.metallic, record.metallic, HasMetallic, record.flags);
+        store(description.roughness, record.roughness, HasRoughness, record.flags);
+
+        if (description.metallic_roughness_same_texture)
+            record.flags |= MetallicRoughnessSameTexture;
+        if (description.metallic_roughness_ao_same_texture)
+            record.flags |= MetallicRoughnessAOSameTexture;
+
+        for (u32 texture = 0; texture < std::size(MATERIAL_DESCRIPTION_TEXTURES); ++texture) {
+            const std::string& texture_path = description.*MATERIAL_DESCRIPTION_TEXTURES[texture].path;
+            record.textures[texture] = StringReference{.offset = (u32)strings.size(), .size = (u32)texture_path.size()};
+            strings += texture_path;
+        }
+    }
+
+    for (u32 i = 0; i < dependencies.size(); ++i) {
+        // A dependency that can no longer be read is not baked against
+        const auto hash = hash_file(dependencies[i]);
+        if (!hash.has_value())
+            return false;
+
+        dependency_records[i] = DependencyRecord{
+            .path = StringReference{.offset = (u32)strings.size(), .size = (u32)dependencies[i].size()},
+            .hash = hash.value(),
+        };
+        strings += dependencies[i];
+    }
+
+    header.strings_offset = writer.append(strings.data(), strings.size());
+
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.source_hash = source_hash;
+    header.mesh_count = (u32)meshes.size();
+    header.material_count = (u32)materials.size();
+    header.dependency_count = (u32)dependencies.size();
+    header.node_mesh_count = (u32)node_meshes.size();
+    header.strings_size = (u32)strings.size();
+
+    writer.write_at<Header>(0, std::span(&header, 1));
+    writer.write_at<MeshRecord>(header.meshes_offset, mesh_records);
+    writer.write_at<MaterialRecord>(header.materials_offset, material_records);
+    writer.write_at<DependencyRecord>(header.dependencies_offset, dependency_records);
+
+    // A partially written file is never picked up, the rename replaces the old one at once
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        const auto& bytes = writer.get_bytes();
+        file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+
+        if (!file.good()) {
+            file.close();
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+    }
+
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+} // namespace Hydrogen
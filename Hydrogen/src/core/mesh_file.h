@@ -0,0 +1,75 @@
+#pragma once
+
+#include "core.h"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "core/mapped_file.h"
+#include "core/mesh_importer.h"
+
+namespace Hydrogen {
+
+#define MESH_FILE_EXTENSION ".hgmesh"
+#define MESH_FILE_MAGIC 0x534d4748 // "HGMS"
+// Increase when the layout of the file or of PackedVertex changes, or when import results would differ
+#define MESH_FILE_VERSION 2
+
+// Baked model written after the first import, so later loads skip assimp and all mesh processing.
+// Layout, every array starting at a 16 byte aligned offset:
+//   Header | MeshRecord[] | MaterialRecord[] | DependencyRecord[] | node meshes | per mesh: vertices, indices,
+//   LODs | strings
+// Vertex and index arrays hold the final GPU data and are read in place from the mapping. The file is a
+// cache in native byte order, it is rebuilt when the version, the hash of the source or the hash of a file
+// the importer read next to it (e.g. .bin buffers of a .gltf, the .mtl of an .obj) changes
+class HG_API MeshFile {
+  public:
+    // Maps the file, is_valid() is false if it is missing, malformed or baked from a different source or
+    // dependencies
+    MeshFile(const std::string& path, u64 source_hash);
+    ~MeshFile() = default;
+
+    bool is_valid() const { return m_header != nullptr; }
+
+    u32 get_mesh_count() const;
+    // Points into the mapping, valid while the file is alive
+    MeshGeometry get_geometry(u32 mesh) const;
+    u32 get_material_index(u32 mesh) const;
+
+    u32 get_material_count() const;
+    MaterialDescription get_material(u32 material) const;
+
+    // Mesh of every node reference in scene traversal order, meshes can be referenced more than once
+    std::span<const u32> get_node_meshes() const;
+
+    // Writes through a temporary file that replaces path once complete. dependencies are the other files the
+    // importer read, their hashes are stored with them. Returns false on failure
+    static bool write(const std::string& path,
+                      u64 source_hash,
+                      std::span<const ImportedMesh* const> meshes,
+                      std::span<const MaterialDescription> materials,
+                      std::span<const u32> node_meshes,
+                      std::span<const std::string> dependencies);
+
+    // Hash of the contents of the source file and of the import options that change the result
+    static std::optional<u64> hash_source(const std::string& path, u32 options);
+
+  private:
+    struct Header;
+    struct MeshRecord;
+    struct MaterialRecord;
+    struct DependencyRecord;
+
+    MappedFile m_file;
+    const Header* m_header = nullptr;
+
+    template <typename T>
+    std::span<const T> get_array(u64 offset, u64 count) const;
+    bool validate() const;
+    // Whether every dependency still has the contents it was baked from
+    bool dependencies_unchanged() const;
+};
+
+} // namespace Hydrogen
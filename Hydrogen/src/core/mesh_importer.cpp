@@ -0,0 +1,358 @@
+#include "mesh_importer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "systems/texture_system.h"
+
+#include "material/phong_material.h"
+#include "material/pbr_material.h"
+
+namespace Hydrogen {
+
+//
+// Material
+//
+
+static std::string get_texture_path(const aiMaterial* material, aiTextureType type, u32 index = 0) {
+    aiString path;
+    if (material->GetTexture(type, index, &path) != aiReturn_SUCCESS)
+        return {};
+    return std::string(path.C_Str());
+}
+
+static std::optional<glm::vec3> get_color(const aiMaterial* material, const char* key, u32 type, u32 index) {
+    aiColor3D color;
+    if (material->Get(key, type, index, color) != aiReturn_SUCCESS)
+        return std::nullopt;
+    return glm::vec3(color.r, color.g, color.b);
+}
+
+static std::optional<f32> get_value(const aiMaterial* material, const char* key, u32 type, u32 index) {
+    ai_real value;
+    if (material->Get(key, type, index, value) != aiReturn_SUCCESS)
+        return std::nullopt;
+    return (f32)value;
+}
+
+MaterialDescription describe_material(const aiMaterial* material) {
+    MaterialDescription description;
+
+    int shading_model;
+    if (material->Get(AI_MATKEY_SHADING_MODEL, shading_model) != aiReturn_SUCCESS) {
+        HG_LOG_WARN("Could not determine shading model for mesh, defaulting to PBR");
+        shading_model = aiShadingMode_PBR_BRDF;
+    }
+
+    if (shading_model != aiShadingMode_PBR_BRDF) {
+        description.shading = MaterialDescription::Shading::Phong;
+
+        description.diffuse_map = get_texture_path(material, aiTextureType_DIFFUSE);
+        description.specular_map = get_texture_path(material, aiTextureType_SPECULAR);
+        description.normal_map = get_texture_path(material, aiTextureType_HEIGHT);
+
+        if (const auto ambient = get_color(material, AI_MATKEY_COLOR_AMBIENT))
+            description.ambient = *ambient;
+        description.diffuse = get_color(material, AI_MATKEY_COLOR_DIFFUSE);
+        description.specular = get_color(material, AI_MATKEY_COLOR_SPECULAR);
+        description.shininess = get_value(material, AI_MATKEY_SHININESS);
+
+        return description;
+    }
+
+    description.shading = MaterialDescription::Shading::PBR;
+
+    description.albedo = get_color(material, AI_MATKEY_BASE_COLOR);
+    description.metallic = get_value(material, AI_MATKEY_METALLIC_FACTOR);
+    description.roughness = get_value(material, AI_MATKEY_ROUGHNESS_FACTOR);
+    // AO value
+    // TODO: Could not find it in assimp docs
+
+    description.albedo_map = get_texture_path(material, AI_MATKEY_BASE_COLOR_TEXTURE);
+    description.metallic_map = get_texture_path(material, AI_MATKEY_METALLIC_TEXTURE);
+    description.roughness_map = get_texture_path(material, AI_MATKEY_ROUGHNESS_TEXTURE);
+    description.ao_map = get_texture_path(material, aiTextureType_LIGHTMAP);
+    description.normal_map = get_texture_path(material, aiTextureType_NORMALS);
+
+    // Check if metallic and roughness textures are the same image
+    description.metallic_roughness_same_texture = !description.metallic_map.empty()
+                                                  && description.metallic_map == description.roughness_map;
+
+    // Check if metallic, roughness and ao texture are the same image
+    description.metallic_roughness_ao_same_texture = description.metallic_roughness_same_texture
+                                                     && description.ao_map == description.metallic_map;
+
+    return description;
+}
+
+static std::optional<Texture*> acquire_texture(const std::string& path,
+                                              const std::string& directory,
+                                              TextureUsage usage) {
+    if (path.empty())
+        return std::nullopt;
+    return TextureSystem::instance->acquire(directory + path, usage);
+}
+
+// Falls back to the default texture when the image could not be decoded
+static void acquire_layer(const std::string& path,
+                          const std::string& directory,
+                          TextureUsage usage,
+                          std::optional<TextureLayer>& layer,
+                          std::optional<Texture*>& fallback) {
+    if (path.empty())
+        return;
+
+    layer = TextureSystem::instance->acquire_layer(directory + path, usage);
+    if (!layer.has_value())
+        fallback = TextureSystem::instance->default_texture();
+}
+
+bool uses_texture_layers(const MaterialDescription& description) {
+    return description.shading == MaterialDescription::Shading::PBR && TextureSystem::instance->uses_texture_arrays();
+}
+
+IMaterial* create_material(const MaterialDescription& description, const std::string& directory) {
+    IMaterial* material;
+
+    if (description.shading == MaterialDescription::Shading::Phong) {
+        auto* phong_material = new PhongMaterial();
+
+        phong_material->diffuse_map = acquire_texture(description.diffuse_map, directory, TextureUsage::Color);
+        phong_material->specular_map = acquire_texture(description.specular_map, directory, TextureUsage::Color);
+        phong_material->normal_map = acquire_texture(description.normal_map, directory, TextureUsage::Normal);
+
+        phong_material->ambient = description.ambient;
+        phong_material->diffuse = description.diffuse;
+        phong_material->specular = description.specular;
+        phong_material->shininess = description.shininess;
+
+        material = phong_material;
+    } else {
+        auto* pbr_material = new PBRMaterial();
+
+        pbr_material->albedo = description.albedo;
+        pbr_material->metallic = description.metallic;
+        pbr_material->roughness = description.roughness;
+
+        if (uses_texture_layers(description)) {
+            acquire_layer(description.albedo_map,
+                          directory,
+                          TextureUsage::Color,
+                          pbr_material->albedo_layer,
+                          pbr_material->albedo_map);
+            acquire_layer(description.metallic_map,
+                          directory,
+                          TextureUsage::Data,
+                          pbr_material->metallic_layer,
+                          pbr_material->metallic_map);
+            acquire_layer(description.roughness_map,
+                          directory,
+                          TextureUsage::Data,
+                          pbr_material->roughness_layer,
+                          pbr_material->roughness_map);
+            acquire_layer(description.ao_map,
+                          directory,
+                          TextureUsage::Data,
+                          pbr_material->ao_layer,
+                          pbr_material->ao_map);
+            acquire_layer(description.normal_map,
+                          directory,
+                          TextureUsage::Normal,
+                          pbr_material->normal_layer,
+                          pbr_material->normal_map);
+        } else {
+            pbr_material->albedo_map = acquire_texture(description.albedo_map, directory, TextureUsage::Color);
+            pbr_material->metallic_map = acquire_texture(description.metallic_map, directory, TextureUsage::Data);
+            pbr_material->roughness_map = acquire_texture(description.roughness_map, directory, TextureUsage::Data);
+            pbr_material->ao_map = acquire_texture(description.ao_map, directory, TextureUsage::Data);
+            pbr_material->normal_map = acquire_texture(description.normal_map, directory, TextureUsage::Normal);
+        }
+
+        pbr_material->metallic_roughness_same_texture = description.metallic_roughness_same_texture;
+        pbr_material->metallic_roughness_ao_same_texture = description.metallic_roughness_ao_same_texture;
+
+        material = pbr_material;
+    }
+
+    material->build();
+    return material;
+}
+
+//
+// Geometry
+//
+
+ImportedMesh::ImportedMesh(const aiMesh* mesh) : m_material(mesh->mMaterialIndex) {
+    std::vector<Vertex> vertices(mesh->mNumVertices);
+
+    // Vertices
+    for (u32 i = 0; i < mesh->mNumVertices; ++i) {
+        Vertex& vertex = vertices[i];
+
+        // Position
+        const auto& vs = mesh->mVertices[i];
+        vertex.position = glm::vec3(vs.x, vs.y, vs.z);
+
+        // Normals
+        if (mesh->HasNormals()) {
+            const auto& ns = mesh->mNormals[i];
+            vertex.normal = glm::vec3(ns.x, ns.y, ns.z);
+        }
+
+        // Texture coordinates
+        if (mesh->HasTextureCoords(0)) {
+            const auto& tc = mesh->mTextureCoords[0][i];
+            vertex.texture_coordinates = glm::vec2(tc.x, tc.y);
+        }
+
+        // Tangents
+        if (mesh->HasTangentsAndBitangents()) {
+            const auto& ts = mesh->mTangents[i];
+            vertex.tangent = glm::vec3(ts.x, ts.y, ts.z);
+
+            const auto& bs = mesh->mBitangents[i];
+            const auto bitangent = glm::vec3(bs.x, bs.y, bs.z);
+            vertex.handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+        }
+    }
+
+    // Indices
+    std::vector<u32> indices;
+    indices.reserve(mesh->mNumFaces * 3);
+    for (u32 i = 0; i < mesh->mNumFaces; ++i) {
+        const aiFace& face = mesh->mFaces[i];
+        indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+    }
+
+    const bool triangles = mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+    if (triangles)
+        optimize(vertices, indices);
+
+    compute_bounds(vertices);
+
+    std::vector<std::vector<u32>> lod_indices;
+    if (triangles)
+        lod_indices = generate_lods(vertices, indices);
+
+    // Every level goes after the full detail indices, ranges are relative to the start of the mesh
+    m_lods.resize(lod_indices.size() + 1);
+    m_lods[0].range = DrawRange{.first_index = 0, .index_count = (u32)indices.size(), .base_vertex = 0};
+
+    m_indices = std::move(indices);
+    for (u32 level = 0; level < lod_indices.size(); ++level) {
+        m_lods[level + 1].range = DrawRange{
+            .first_index = (u32)m_indices.size(),
+            .index_count = (u32)lod_indices[level].size(),
+            .base_vertex = 0,
+        };
+        m_indices.insert(m_indices.end(), lod_indices[level].begin(), lod_indices[level].end());
+    }
+
+    // Only the quantized vertices are kept, positions stay in full precision for ray casts
+    m_vertices.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        m_vertices.push_back(PackedVertex::pack(
+            vertex.position, vertex.normal, vertex.texture_coordinates, vertex.tangent, vertex.handedness));
+    }
+}
+
+MeshGeometry ImportedMesh::get_geometry() const {
+    return MeshGeometry{
+        .vertices = m_vertices,
+        .indices = m_indices,
+        .lods = m_lods,
+        .bounds = m_bounds,
+        .bounding_sphere = m_bounding_sphere,
+        .imported_cache_statistics = m_imported_cache_statistics,
+        .cache_statistics = m_cache_statistics,
+    };
+}
+
+void ImportedMesh::optimize(std::vector<Vertex>& vertices, std::vector<u32>& indices) {
+    m_imported_cache_statistics = analyze_vertex_cache(indices, (u32)vertices.size());
+
+    const auto clusters = optimize_vertex_cache(indices, (u32)vertices.size());
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        positions.push_back(vertex.position);
+    }
+    optimize_overdraw(indices, positions, clusters);
+
+    const auto remap = optimize_vertex_fetch(indices, (u32)vertices.size());
+    vertices = remap_vertices<Vertex>(vertices, remap);
+
+    m_cache_statistics = analyze_vertex_cache(indices, (u32)vertices.size());
+}
+
+void ImportedMesh::compute_bounds(const std::vector<Vertex>& vertices) {
+    for (const auto& vertex : vertices) {
+        m_bounds.expand(vertex.position);
+    }
+
+    m_bounding_sphere.center = m_bounds.center();
+    for (const auto& vertex : vertices) {
+        const glm::vec3 offset = vertex.position - m_bounding_sphere.center;
+        m_bounding_sphere.radius = std::max(m_bounding_sphere.radius, glm::dot(offset, offset));
+    }
+    m_bounding_sphere.radius = std::sqrt(m_bounding_sphere.radius);
+}
+
+std::vector<std::vector<u32>> ImportedMesh::generate_lods(const std::vector<Vertex>& vertices,
+                                                          const std::vector<u32>& indices) {
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texture_coordinates;
+    positions.reserve(vertices.size());
+    normals.reserve(vertices.size());
+    texture_coordinates.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        positions.push_back(vertex.position);
+        normals.push_back(vertex.normal);
+        texture_coordinates.push_back(vertex.texture_coordinates);
+    }
+
+    const f32 radius = std::max(m_bounding_sphere.radius, std::numeric_limits<f32>::epsilon());
+
+    std::vector<std::vector<u32>> lod_indices;
+    lod_indices.reserve(MESH_MAX_LODS);
+    // Errors of every level, ranges are filled once all indices are known
+    m_lods = {MeshLOD{.range = {}, .error = 0.0f}};
+
+    // Each level halves the triangles of the previous one, errors add up along the chain
+    const std::vector<u32>* previous = &indices;
+    f32 error = 0.0f;
+
+    for (u32 level = 1; level < MESH_MAX_LODS; ++level) {
+        const auto target = (u32)(previous->size() / 6 * 3);
+        const f32 max_error = MESH_LOD_MAX_ERROR * radius - error;
+        if (target == 0 || max_error <= 0.0f)
+            break;
+
+        f32 level_error;
+        auto simplified = simplify(
+            SimplifyInput{
+                .indices = *previous,
+                .positions = positions,
+                .normals = normals,
+                .texture_coordinates = texture_coordinates,
+            },
+            target, max_error, level_error);
+
+        // Not worth a level if locked vertices or the error bound stopped it early
+        if (simplified.empty() || simplified.size() > previous->size() * 3 / 4)
+            break;
+
+        optimize_vertex_cache(simplified, (u32)vertices.size());
+
+        error += level_error;
+        m_lods.push_back(MeshLOD{.range = {}, .error = error / radius});
+        lod_indices.push_back(std::move(simplified));
+        previous = &lod_indices.back();
+    }
+
+    return lod_indices;
+}
+
+} // namespace Hydrogen
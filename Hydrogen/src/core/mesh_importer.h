@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "assimp/scene.h"
+
+#include "material/material.h"
+#include "renderer/vertex_format.h"
+#include "renderer/image.h"
+#include "core/mesh.h"
+#include "core/mesh_simplifier.h"
+
+namespace Hydrogen {
+
+// Levels of detail generated at import, including the full detail one
+#define MESH_MAX_LODS 5
+// Simplification stops once the error reaches this fraction of the bounding sphere radius
+#define MESH_LOD_MAX_ERROR 0.25f
+
+// Values of an imported material, enough to create the material again without the source file.
+// Texture paths are relative to the model directory and empty when the material has no such texture
+struct HG_API MaterialDescription {
+    enum class Shading { Phong, PBR };
+    Shading shading = Shading::PBR;
+
+    // Phong
+    glm::vec3 ambient{1.0f, 1.0f, 1.0f};
+    std::optional<glm::vec3> diffuse;
+    std::optional<glm::vec3> specular;
+    std::optional<f32> shininess;
+
+    std::string diffuse_map;
+    std::string specular_map;
+
+    // PBR
+    std::optional<glm::vec3> albedo;
+    std::optional<f32> metallic;
+    std::optional<f32> roughness;
+
+    std::string albedo_map;
+    std::string metallic_map;
+    std::string roughness_map;
+    std::string ao_map;
+
+    bool metallic_roughness_same_texture = false;
+    bool metallic_roughness_ao_same_texture = false;
+
+    // Both
+    std::string normal_map;
+};
+
+struct MaterialTextureSlot {
+    std::string MaterialDescription::*path;
+    TextureUsage usage;
+};
+
+// Texture paths of MaterialDescription, in the order they are baked
+inline constexpr MaterialTextureSlot MATERIAL_DESCRIPTION_TEXTURES[] = {
+    {&MaterialDescription::diffuse_map, TextureUsage::Color},
+    {&MaterialDescription::specular_map, TextureUsage::Color},
+    {&MaterialDescription::albedo_map, TextureUsage::Color},
+    {&MaterialDescription::metallic_map, TextureUsage::Data},
+    {&MaterialDescription::roughness_map, TextureUsage::Data},
+    {&MaterialDescription::ao_map, TextureUsage::Data},
+    {&MaterialDescription::normal_map, TextureUsage::Normal},
+};
+
+HG_API MaterialDescription describe_material(const aiMaterial* material);
+// Whether create_material places the textures in layers of texture arrays instead of separate textures
+HG_API bool uses_texture_layers(const MaterialDescription& description);
+// Acquires the textures and builds the material
+HG_API IMaterial* create_material(const MaterialDescription& description, const std::string& directory);
+
+// CPU side of importing a mesh: vertex conversion, triangle reordering, LOD generation and quantization.
+// Touches no GL state, so meshes can be imported on the job system. The result is uploaded by constructing
+// a Mesh from get_geometry()
+class HG_API ImportedMesh {
+  public:
+    explicit ImportedMesh(const aiMesh* mesh);
+    ~ImportedMesh() = default;
+
+    MeshGeometry get_geometry() const;
+    // Index of the material in the scene
+    u32 get_material() const { return m_material; }
+
+  private:
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texture_coordinates;
+        glm::vec3 tangent;
+        // Sign of the bitangent relative to cross(normal, tangent)
+        f32 handedness = 1.0f;
+    };
+
+    std::vector<PackedVertex> m_vertices;
+    // Full detail indices followed by the indices of every other level
+    std::vector<u32> m_indices;
+    std::vector<MeshLOD> m_lods;
+    u32 m_material;
+
+    AABB m_bounds;
+    BoundingSphere m_bounding_sphere;
+
+    VertexCacheStatistics m_imported_cache_statistics;
+    VertexCacheStatistics m_cache_statistics;
+
+    // Reorders triangles and vertices for the vertex caches and to reduce overdraw
+    void optimize(std::vector<Vertex>& vertices, std::vector<u32>& indices);
+    void compute_bounds(const std::vector<Vertex>& vertices);
+    // Returns the indices of every level after the first one
+    std::vector<std::vector<u32>> generate_lods(const std::vector<Vertex>& vertices, const std::vector<u32>& indices);
+};
+
+} // namespace Hydrogen
@@ -0,0 +1,307 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Hydrogen {
+
+//
+// Cache simulation
+//
+
+// FIFO cache, a vertex is cached while fewer than cache_size misses happened since it was loaded
+class VertexCache {
+  public:
+    VertexCache(u32 vertex_count, u32 cache_size)
+        : m_timestamps(vertex_count, 0), m_cache_size(cache_size), m_time(cache_size + 1) {}
+
+    // Returns true on a miss
+    bool access(u32 vertex) {
+        if (m_time - m_timestamps[vertex] <= m_cache_size)
+            return false;
+
+        m_timestamps[vertex] = m_time++;
+        return true;
+    }
+
+    // Empties the cache
+    void flush() { m_time += m_cache_size + 1; }
+
+  private:
+    std::vector<u32> m_timestamps;
+    u32 m_cache_size;
+    u32 m_time;
+};
+
+VertexCacheStatistics& VertexCacheStatistics::operator+=(const VertexCacheStatistics& other) {
+    triangle_count += other.triangle_count;
+    vertex_count += other.vertex_count;
+    cache_misses += other.cache_misses;
+    return *this;
+}
+
+VertexCacheStatistics analyze_vertex_cache(std::span<const u32> indices, u32 vertex_count, u32 cache_size) {
+    VertexCacheStatistics statistics{
+        .triangle_count = (u32)indices.size() / 3,
+        .vertex_count = vertex_count,
+        .cache_misses = 0,
+    };
+
+    VertexCache cache(vertex_count, cache_size);
+    for (u32 index : indices) {
+        if (cache.access(index))
+            ++statistics.cache_misses;
+    }
+
+    return statistics;
+}
+
+//
+// Vertex cache
+//
+
+// Triangles using each vertex, in compressed rows
+struct TriangleAdjacency {
+    std::vector<u32> offsets;
+    std::vector<u32> triangles;
+
+    TriangleAdjacency(std::span<const u32> indices, u32 vertex_count) : offsets(vertex_count + 1, 0) {
+        for (u32 index : indices) {
+            ++offsets[index + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+        triangles.resize(indices.size());
+        for (u32 i = 0; i < indices.size(); ++i) {
+            triangles[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::span<const u32> get(u32 vertex) const {
+        return std::span(triangles).subspan(offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+    }
+};
+
+std::vector<u32> optimize_vertex_cache(std::span<u32> indices, u32 vertex_count, u32 cache_size) {
+    HG_ASSERT(indices.size() % 3 == 0, "Vertex cache optimization needs a triangle list");
+
+    const u32 triangle_count = (u32)indices.size() / 3;
+    const TriangleAdjacency adjacency(indices, vertex_count);
+
+    // Triangles not emitted yet using each vertex
+    std::vector<u32> live_triangles(vertex_count);
+    for (u32 v = 0; v < vertex_count; ++v) {
+        live_triangles[v] = (u32)adjacency.get(v).size();
+    }
+
+    std::vector<u32> cache_timestamps(vertex_count, 0);
+    u32 time = cache_size + 1;
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<u32> dead_end_stack;
+    std::vector<u32> candidates;
+    u32 cursor = 0;
+
+    std::vector<u32> output;
+    output.reserve(indices.size());
+    std::vector<u32> clusters;
+
+    // Recently used vertex with live triangles, otherwise the next one in input order
+    const auto skip_dead_end = [&]() -> u32 {
+        while (!dead_end_stack.empty()) {
+            const u32 vertex = dead_end_stack.back();
+            dead_end_stack.pop_back();
+            if (live_triangles[vertex] > 0)
+                return vertex;
+        }
+
+        for (; cursor < vertex_count; ++cursor) {
+            if (live_triangles[cursor] > 0)
+                return cursor;
+        }
+        return INVALID_VERTEX;
+    };
+
+    u32 fanning_vertex = skip_dead_end();
+    while (fanning_vertex != INVALID_VERTEX) {
+        candidates.clear();
+
+        for (u32 triangle : adjacency.get(fanning_vertex)) {
+            if (emitted[triangle])
+                continue;
+
+            for (u32 corner = 0; corner < 3; ++corner) {
+                const u32 vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                --live_triangles[vertex];
+
+                if (time - cache_timestamps[vertex] > cache_size)
+                    cache_timestamps[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // Oldest candidate that stays in the cache while its remaining triangles are emitted. Candidates
+        // that would leave it keep priority 0 and are never picked, the dead-end stack is used instead
+        u32 next_vertex = INVALID_VERTEX;
+        i64 best_priority = 0;
+        for (u32 vertex : candidates) {
+            if (live_triangles[vertex] == 0)
+                continue;
+
+            i64 priority = 0;
+            const i64 age = (i64)time - (i64)cache_timestamps[vertex];
+            if (age + 2 * (i64)live_triangles[vertex] <= (i64)cache_size)
+                priority = age;
+
+            if (priority > best_priority) {
+                best_priority = priority;
+                next_vertex = vertex;
+            }
+        }
+
+        if (next_vertex == INVALID_VERTEX) {
+            next_vertex = skip_dead_end();
+            // The next fan does not start from a cached vertex
+            if (next_vertex != INVALID_VERTEX)
+                clusters.push_back((u32)output.size() / 3);
+        }
+
+        fanning_vertex = next_vertex;
+    }
+
+    HG_ASSERT(output.size() == indices.size(), "Vertex cache optimization lost triangles");
+    std::copy(output.begin(), output.end(), indices.begin());
+
+    clusters.insert(clusters.begin(), 0);
+    return clusters;
+}
+
+//
+// Overdraw
+//
+void optimize_overdraw(std::span<u32> indices,
+                       std::span<const glm::vec3> positions,
+                       std::span<const u32> clusters,
+                       f32 threshold,
+                       u32 cache_size) {
+    const u32 triangle_count = (u32)indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    const f32 mesh_acmr = analyze_vertex_cache(indices, (u32)positions.size(), cache_size).get_acmr();
+
+    // Split clusters where the part emitted so far already has a good enough miss ratio.
+    // Each cluster starts with an empty cache, as it may be drawn after any other cluster
+    std::vector<u32> soft_clusters;
+    VertexCache cache((u32)positions.size(), cache_size);
+
+    for (u32 c = 0; c < clusters.size(); ++c) {
+        const u32 begin = clusters[c];
+        const u32 end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+        cache.flush();
+        soft_clusters.push_back(begin);
+
+        u32 cluster_misses = 0;
+        u32 cluster_triangles = 0;
+        for (u32 triangle = begin; triangle < end; ++triangle) {
+            for (u32 corner = 0; corner < 3; ++corner) {
+                if (cache.access(indices[triangle * 3 + corner]))
+                    ++cluster_misses;
+            }
+            ++cluster_triangles;
+
+            if (triangle + 1 < end && (f32)cluster_misses <= (f32)cluster_triangles * mesh_acmr * threshold) {
+                cache.flush();
+                soft_clusters.push_back(triangle + 1);
+                cluster_misses = 0;
+                cluster_triangles = 0;
+            }
+        }
+    }
+
+    // Area weighted centroid and normal of every cluster
+    struct Cluster {
+        u32 begin;
+        u32 end;
+        f32 sort_key;
+    };
+
+    std::vector<Cluster> sorted;
+    sorted.reserve(soft_clusters.size());
+
+    glm::vec3 mesh_centroid(0.0f);
+    f32 mesh_area = 0.0f;
+    std::vector<glm::vec3> cluster_centroids;
+    std::vector<glm::vec3> cluster_normals;
+
+    for (u32 c = 0; c < soft_clusters.size(); ++c) {
+        const u32 begin = soft_clusters[c];
+        const u32 end = c + 1 < soft_clusters.size() ? soft_clusters[c + 1] : triangle_count;
+
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        f32 area = 0.0f;
+
+        for (u32 triangle = begin; triangle < end; ++triangle) {
+            const glm::vec3& p0 = positions[indices[triangle * 3 + 0]];
+            const glm::vec3& p1 = positions[indices[triangle * 3 + 1]];
+            const glm::vec3& p2 = positions[indices[triangle * 3 + 2]];
+
+            // Length is twice the area of the triangle
+            const glm::vec3 area_normal = glm::cross(p1 - p0, p2 - p0);
+            const f32 triangle_area = glm::length(area_normal);
+
+            centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            normal += area_normal;
+            area += triangle_area;
+        }
+
+        mesh_centroid += centroid;
+        mesh_area += area;
+
+        cluster_centroids.push_back(area > 0.0f ? centroid / area : centroid);
+        cluster_normals.push_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : normal);
+        sorted.push_back(Cluster{.begin = begin, .end = end, .sort_key = 0.0f});
+    }
+
+    if (mesh_area > 0.0f)
+        mesh_centroid /= mesh_area;
+
+    for (u32 c = 0; c < sorted.size(); ++c) {
+        sorted[c].sort_key = glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c]);
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sort_key > b.sort_key;
+    });
+
+    std::vector<u32> output;
+    output.reserve(indices.size());
+    for (const auto& cluster : sorted) {
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+//
+// Vertex fetch
+//
+std::vector<u32> optimize_vertex_fetch(std::span<u32> indices, u32 vertex_count) {
+    std::vector<u32> remap(vertex_count, INVALID_VERTEX);
+
+    u32 next = 0;
+    for (u32& index : indices) {
+        if (remap[index] == INVALID_VERTEX)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    return remap;
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core.h"
+
+#include <limits>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Hydrogen {
+
+// Triangle list reordering run when meshes are imported:
+//  1. optimize_vertex_cache: Tipsify, orders triangles for the post-transform cache
+//  2. optimize_overdraw: reorders clusters of that output so outward facing parts are drawn first
+//  3. optimize_vertex_fetch: renumbers vertices in order of first use, for the pre-transform cache
+// Reference: Sander, Nehab, Barczak. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+
+#define VERTEX_CACHE_SIZE 16
+// Clusters are split where their cache miss ratio is within this factor of the whole mesh
+#define OVERDRAW_CLUSTER_THRESHOLD 1.05f
+
+#define INVALID_VERTEX std::numeric_limits<u32>::max()
+
+// Post-transform cache efficiency of an index buffer, simulated with a FIFO cache
+struct HG_API VertexCacheStatistics {
+    u32 triangle_count = 0;
+    u32 vertex_count = 0;
+    u32 cache_misses = 0;
+
+    // Average cache miss ratio, transformed vertices per triangle. 0.5 is the best case for large meshes
+    f32 get_acmr() const { return triangle_count > 0 ? (f32)cache_misses / (f32)triangle_count : 0.0f; }
+    // Average transform to vertex ratio, 1 means every vertex is transformed once
+    f32 get_atvr() const { return vertex_count > 0 ? (f32)cache_misses / (f32)vertex_count : 0.0f; }
+
+    VertexCacheStatistics& operator+=(const VertexCacheStatistics& other);
+};
+
+HG_API VertexCacheStatistics analyze_vertex_cache(std::span<const u32> indices,
+                                                  u32 vertex_count,
+                                                  u32 cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders triangles in place. Returns the first triangle of each cluster, clusters start where the
+// algorithm had to jump to a vertex outside the cache
+HG_API std::vector<u32> optimize_vertex_cache(std::span<u32> indices,
+                                              u32 vertex_count,
+                                              u32 cache_size = VERTEX_CACHE_SIZE);
+
+// Splits the clusters further where the cache allows it and sorts them so clusters facing away from
+// the center of the mesh come first, as they are likely to occlude the rest
+HG_API void optimize_overdraw(std::span<u32> indices,
+                              std::span<const glm::vec3> positions,
+                              std::span<const u32> clusters,
+                              f32 threshold = OVERDRAW_CLUSTER_THRESHOLD,
+                              u32 cache_size = VERTEX_CACHE_SIZE);
+
+// Renumbers vertices in order of first use and rewrites the indices. Returns the new index of every
+// old vertex, INVALID_VERTEX for vertices no triangle uses. Apply it with remap_vertices
+HG_API std::vector<u32> optimize_vertex_fetch(std::span<u32> indices, u32 vertex_count);
+
+template <typename T>
+std::vector<T> remap_vertices(std::span<const T> vertices, std::span<const u32> remap) {
+    u32 used = 0;
+    for (u32 index : remap) {
+        if (index != INVALID_VERTEX)
+            ++used;
+    }
+
+    std::vector<T> remapped(used);
+    for (u32 i = 0; i < vertices.size(); ++i) {
+        if (remap[i] != INVALID_VERTEX)
+            remapped[remap[i]] = vertices[i];
+    }
+    return remapped;
+}
+
+} // namespace Hydrogen
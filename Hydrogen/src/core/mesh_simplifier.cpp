@@ -0,0 +1,350 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace Hydrogen {
+
+// Collapse passes before giving up on reaching the target
+#define SIMPLIFY_MAX_PASSES 100
+
+//
+// Quadric
+//
+
+// Sum of squared distances to a set of planes, weighted by the area of the triangles they come from
+struct Quadric {
+    f64 a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    f64 b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    f64 c = 0.0;
+    f64 weight = 0.0;
+
+    // Plane n.p + d = 0 with unit normal n
+    void add_plane(const glm::dvec3& n, f64 d, f64 w) {
+        a00 += w * n.x * n.x;
+        a01 += w * n.x * n.y;
+        a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y;
+        a12 += w * n.y * n.z;
+        a22 += w * n.z * n.z;
+        b0 += w * n.x * d;
+        b1 += w * n.y * d;
+        b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // Average squared distance from p to the planes
+    f64 error(const glm::dvec3& p) const {
+        if (weight <= 0.0)
+            return 0.0;
+
+        const f64 rx = a00 * p.x + a01 * p.y + a02 * p.z;
+        const f64 ry = a01 * p.x + a11 * p.y + a12 * p.z;
+        const f64 rz = a02 * p.x + a12 * p.y + a22 * p.z;
+
+        const f64 e = p.x * rx + p.y * ry + p.z * rz + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return std::max(e, 0.0) / weight;
+    }
+};
+
+//
+// Topology
+//
+
+// Groups vertices sharing a position, returns the smallest vertex index of each group
+static std::vector<u32> find_position_groups(std::span<const glm::vec3> positions) {
+    std::vector<u32> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    const auto less = [&](u32 a, u32 b) {
+        const auto& pa = positions[a];
+        const auto& pb = positions[b];
+        if (pa.x != pb.x)
+            return pa.x < pb.x;
+        if (pa.y != pb.y)
+            return pa.y < pb.y;
+        if (pa.z != pb.z)
+            return pa.z < pb.z;
+        return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<u32> group(positions.size());
+    for (u32 i = 0; i < order.size(); ++i) {
+        const bool same = i > 0 && positions[order[i]] == positions[order[i - 1]];
+        group[order[i]] = same ? group[order[i - 1]] : order[i];
+    }
+    return group;
+}
+
+// Locks vertices on attribute seams and on open borders
+static std::vector<bool> find_locked_vertices(std::span<const u32> indices, std::span<const glm::vec3> positions) {
+    const auto group = find_position_groups(positions);
+    std::vector<bool> locked(positions.size(), false);
+
+    // Seams: more than one vertex of a group is referenced
+    std::vector<u32> used_vertex(positions.size(), std::numeric_limits<u32>::max());
+    for (u32 index : indices) {
+        u32& used = used_vertex[group[index]];
+        if (used == std::numeric_limits<u32>::max())
+            used = index;
+        else if (used != index)
+            locked[group[index]] = true;
+    }
+
+    // Borders: edges between groups used by a single triangle. Opposite half edges cancel out
+    std::vector<std::pair<u32, u32>> edges;
+    edges.reserve(indices.size());
+    for (u32 i = 0; i < indices.size(); i += 3) {
+        for (u32 corner = 0; corner < 3; ++corner) {
+            const u32 a = group[indices[i + corner]];
+            const u32 b = group[indices[i + (corner + 1) % 3]];
+            edges.emplace_back(std::min(a, b), std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (u32 i = 0; i < edges.size();) {
+        u32 j = i;
+        while (j < edges.size() && edges[j] == edges[i])
+            ++j;
+
+        if (j - i == 1) {
+            locked[edges[i].first] = true;
+            locked[edges[i].second] = true;
+        }
+        i = j;
+    }
+
+    // Propagate from the group representative to every vertex of the group
+    for (u32 v = 0; v < positions.size(); ++v) {
+        locked[v] = locked[group[v]];
+    }
+    return locked;
+}
+
+//
+// Simplification
+//
+struct Collapse {
+    u32 from;
+    u32 to;
+    f64 cost;
+};
+
+// Collapsing from into to must not turn any remaining triangle around from upside down
+static bool flips_triangles(std::span<const u32> indices,
+                            std::span<const glm::vec3> positions,
+                            const std::vector<u32>& adjacency_offsets,
+                            const std::vector<u32>& adjacency,
+                            u32 from,
+                            u32 to) {
+    for (u32 k = adjacency_offsets[from]; k < adjacency_offsets[from + 1]; ++k) {
+        const u32 triangle = adjacency[k];
+        const u32 i0 = indices[triangle * 3 + 0];
+        const u32 i1 = indices[triangle * 3 + 1];
+        const u32 i2 = indices[triangle * 3 + 2];
+
+        // Triangles containing the edge disappear
+        if (i0 == to || i1 == to || i2 == to)
+            continue;
+
+        const glm::vec3 p0 = positions[i0];
+        const glm::vec3 p1 = positions[i1];
+        const glm::vec3 p2 = positions[i2];
+        const glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+
+        const glm::vec3 q0 = i0 == from ? positions[to] : p0;
+        const glm::vec3 q1 = i1 == from ? positions[to] : p1;
+        const glm::vec3 q2 = i2 == from ? positions[to] : p2;
+        const glm::vec3 after = glm::cross(q1 - q0, q2 - q0);
+
+        if (glm::dot(before, after) <= 0.0f)
+            return true;
+    }
+    return false;
+}
+
+std::vector<u32> simplify(const SimplifyInput& input, u32 target_index_count, f32 max_error, f32& error) {
+    HG_ASSERT(input.indices.size() % 3 == 0, "Simplification needs a triangle list");
+
+    const auto positions = input.positions;
+    const auto vertex_count = (u32)positions.size();
+    const bool has_normals = input.normals.size() == positions.size();
+    const bool has_texture_coordinates = input.texture_coordinates.size() == positions.size();
+
+    std::vector<u32> indices(input.indices.begin(), input.indices.end());
+    error = 0.0f;
+
+    if (indices.size() <= target_index_count || vertex_count == 0)
+        return indices;
+
+    const std::vector<bool> locked = find_locked_vertices(indices, positions);
+
+    // Attribute differences are measured against the size of the mesh
+    glm::vec3 min = positions[0], max = positions[0];
+    for (const auto& position : positions) {
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    const f64 attribute_scale = (f64)SIMPLIFY_ATTRIBUTE_WEIGHT * (f64)glm::length(max - min);
+    const f64 attribute_weight = attribute_scale * attribute_scale;
+
+    std::vector<Quadric> quadrics(vertex_count);
+    for (u32 i = 0; i < indices.size(); i += 3) {
+        const glm::dvec3 p0 = positions[indices[i + 0]];
+        const glm::dvec3 p1 = positions[indices[i + 1]];
+        const glm::dvec3 p2 = positions[indices[i + 2]];
+
+        const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const f64 length = glm::length(normal);
+        if (length <= 0.0)
+            continue;
+
+        const glm::dvec3 n = normal / length;
+        // Area weighted
+        const f64 w = length * 0.5;
+        for (u32 corner = 0; corner < 3; ++corner) {
+            quadrics[indices[i + corner]].add_plane(n, -glm::dot(n, p0), w);
+        }
+    }
+
+    const auto attribute_error = [&](u32 a, u32 b) {
+        f64 distance = 0.0;
+        if (has_normals) {
+            const glm::vec3 d = input.normals[a] - input.normals[b];
+            distance += (f64)glm::dot(d, d);
+        }
+        if (has_texture_coordinates) {
+            const glm::vec2 d = input.texture_coordinates[a] - input.texture_coordinates[b];
+            distance += (f64)glm::dot(d, d);
+        }
+        return distance * attribute_weight;
+    };
+
+    const f64 max_cost = (f64)max_error * (f64)max_error;
+    f64 largest_cost = 0.0;
+
+    std::vector<Collapse> collapses;
+    std::vector<u32> adjacency_offsets(vertex_count + 1);
+    std::vector<u32> adjacency;
+    std::vector<u32> collapse_target(vertex_count);
+    std::vector<bool> touched(vertex_count);
+
+    for (u32 pass = 0; pass < SIMPLIFY_MAX_PASSES && indices.size() > target_index_count; ++pass) {
+        // Triangles around every vertex
+        std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+        for (u32 index : indices) {
+            ++adjacency_offsets[index + 1];
+        }
+        std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+
+        std::vector<u32> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        adjacency.resize(indices.size());
+        for (u32 i = 0; i < indices.size(); ++i) {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+
+        // Candidate collapses along every edge, in both directions
+        collapses.clear();
+        for (u32 i = 0; i < indices.size(); i += 3) {
+            for (u32 corner = 0; corner < 3; ++corner) {
+                const u32 a = indices[i + corner];
+                const u32 b = indices[i + (corner + 1) % 3];
+
+                if (!locked[a])
+                    collapses.push_back(Collapse{
+                        .from = a,
+                        .to = b,
+                        .cost = quadrics[a].error(positions[b]) + attribute_error(a, b),
+                    });
+                if (!locked[b])
+                    collapses.push_back(Collapse{
+                        .from = b,
+                        .to = a,
+                        .cost = quadrics[b].error(positions[a]) + attribute_error(a, b),
+                    });
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        std::iota(collapse_target.begin(), collapse_target.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        // Every collapse removes about two triangles
+        const u32 triangles_to_remove = ((u32)indices.size() - target_index_count) / 3;
+        u32 removed = 0;
+        u32 collapsed = 0;
+
+        for (const auto& collapse : collapses) {
+            if (collapse.cost > max_cost || removed >= triangles_to_remove)
+                break;
+
+            // The flip test only holds while the neighbourhood does not change in this pass
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            if (flips_triangles(indices, positions, adjacency_offsets, adjacency, collapse.from, collapse.to))
+                continue;
+
+            collapse_target[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            largest_cost = std::max(largest_cost, collapse.cost);
+
+            for (u32 k = adjacency_offsets[collapse.from]; k < adjacency_offsets[collapse.from + 1]; ++k) {
+                const u32 triangle = adjacency[k];
+                for (u32 corner = 0; corner < 3; ++corner) {
+                    touched[indices[triangle * 3 + corner]] = true;
+                }
+            }
+
+            removed += 2;
+            ++collapsed;
+        }
+
+        if (collapsed == 0)
+            break;
+
+        // Apply the collapses and drop triangles that became degenerate
+        u32 write = 0;
+        for (u32 i = 0; i < indices.size(); i += 3) {
+            const u32 i0 = collapse_target[indices[i + 0]];
+            const u32 i1 = collapse_target[indices[i + 1]];
+            const u32 i2 = collapse_target[indices[i + 2]];
+
+            if (i0 == i1 || i1 == i2 || i0 == i2)
+                continue;
+
+            indices[write++] = i0;
+            indices[write++] = i1;
+            indices[write++] = i2;
+        }
+        indices.resize(write);
+    }
+
+    error = (f32)std::sqrt(largest_cost);
+    return indices;
+}
+
+} // namespace Hydrogen
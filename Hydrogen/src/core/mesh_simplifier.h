@@ -0,0 +1,31 @@
+#pragma once
+
+#include "core.h"
+
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Hydrogen {
+
+// Weight of normal and texture coordinate differences against position error, relative to the mesh size
+#define SIMPLIFY_ATTRIBUTE_WEIGHT 0.05f
+
+// Edge collapse simplification driven by quadric error metrics. Vertices are collapsed into one of
+// their neighbours, so the result indexes the same vertex buffer and LODs can share it.
+// Vertices on open borders and on attribute seams (several vertices at one position) are locked,
+// which keeps the outline of the mesh and avoids cracks along uv seams.
+struct HG_API SimplifyInput {
+    std::span<const u32> indices;
+    std::span<const glm::vec3> positions;
+    // Optional, one per vertex when present
+    std::span<const glm::vec3> normals;
+    std::span<const glm::vec2> texture_coordinates;
+};
+
+// Collapses edges until the index count is at most target_index_count or the next collapse would move
+// the surface further than max_error. error is set to the largest error introduced, in position units
+HG_API std::vector<u32> simplify(const SimplifyInput& input, u32 target_index_count, f32 max_error, f32& error);
+
+} // namespace Hydrogen
@@ -1,25 +1,77 @@
 #include "model.h"
 
+#include <algorithm>
 #include <iostream>
 
+#include "assimp/DefaultIOSystem.h"
+
+#include "systems/job_system.h"
+#include "systems/texture_system.h"
+
 namespace Hydrogen {
 
-Model::Model(const std::string& path, bool flip_uvs) {
-    Assimp::Importer importer;
+// Meshes referenced by every node, in depth first order
+static void collect_node_meshes_r(const aiNode* node, std::vector<u32>& node_meshes) {
+    node_meshes.insert(node_meshes.end(), node->mMeshes, node->mMeshes + node->mNumMeshes);
 
-    u32 flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace;
-    if (flip_uvs)
-        flags |= aiProcess_FlipUVs;
+    for (u32 i = 0; i < node->mNumChildren; ++i) {
+        collect_node_meshes_r(node->mChildren[i], node_meshes);
+    }
+}
 
-    const aiScene* scene = importer.ReadFile(path, flags);
+// Records the files assimp reads besides the source, such as the buffers of a .gltf or the .mtl of an .obj
+class DependencyTrackingIOSystem : public Assimp::DefaultIOSystem {
+  public:
+    explicit DependencyTrackingIOSystem(const std::string& source) : m_source(source) {}
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
-        HG_LOG_ERROR("Error loading model {} with error: {}", path, importer.GetErrorString());
+    using Assimp::DefaultIOSystem::Open;
+    Assimp::IOStream* Open(const char* file, const char* mode) override {
+        Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(file, mode);
+
+        const std::string path = file;
+        if (stream != nullptr && path != m_source
+            && std::find(m_dependencies.begin(), m_dependencies.end(), path) == m_dependencies.end())
+            m_dependencies.push_back(path);
+        return stream;
+    }
+
+    const std::vector<std::string>& get_dependencies() const { return m_dependencies; }
+
+  private:
+    std::string m_source;
+    std::vector<std::string> m_dependencies;
+};
+
+Model::Model(const std::string& path, bool flip_uvs, bool split_positions) : m_split_positions(split_positions) {
+    const auto source_hash = MeshFile::hash_source(path, flip_uvs ? 1 : 0);
+    if (!source_hash.has_value()) {
+        HG_LOG_ERROR("Error loading model {}: could not read the file", path);
         return;
     }
 
     m_directory = path.substr(0, path.find_last_of('/')) + "/";
-    process_node_r(scene->mRootNode, scene);
+
+    const MeshFile baked(path + MESH_FILE_EXTENSION, source_hash.value());
+    if (baked.is_valid()) {
+        load_baked(baked);
+    } else if (!import(path, flip_uvs, source_hash.value())) {
+        return;
+    }
+
+    VertexCacheStatistics imported_statistics, statistics;
+    for (const auto* mesh : m_meshes) {
+        imported_statistics += mesh->imported_cache_statistics;
+        statistics += mesh->cache_statistics;
+    }
+    HG_LOG_INFO("Loaded model {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", path, imported_statistics.get_acmr(),
+                statistics.get_acmr(), imported_statistics.get_atvr(), statistics.get_atvr());
+
+    std::vector<AABB> mesh_bounds;
+    mesh_bounds.reserve(m_meshes.size());
+    for (const auto* mesh : m_meshes) {
+        mesh_bounds.push_back(mesh->bounds);
+    }
+    m_bvh.build(mesh_bounds);
 }
 
 Model::~Model() {
@@ -32,16 +84,123 @@ const std::vector<Mesh*>& Model::get_meshes() const {
     return m_meshes;
 }
 
-void Model::process_node_r(aiNode* node, const aiScene* scene) {
-    for (u32 i = 0; i < node->mNumMeshes; ++i) {
-        const aiMesh* m = scene->mMeshes[node->mMeshes[i]];
+std::optional<RayHit> Model::raycast(const glm::vec3& origin, const glm::vec3& direction, f32 max_distance) const {
+    return raycast(Ray{.origin = origin, .direction = direction}, max_distance);
+}
+
+void Model::raycast(std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) const {
+    HG_ASSERT(rays.size() == hits.size(), "Number of rays and hits must match");
 
-        auto* mesh = new Mesh(m, scene, m_directory);
-        m_meshes.push_back(mesh);
+    for (usize i = 0; i < rays.size(); ++i) {
+        hits[i] = raycast(rays[i], std::numeric_limits<f32>::max());
     }
+}
 
-    for (u32 i = 0; i < node->mNumChildren; ++i) {
-        process_node_r(node->mChildren[i], scene);
+std::optional<RayHit> Model::raycast(const Ray& ray, f32 max_distance) const {
+    f32 closest = max_distance;
+    RayHit hit{};
+
+    const bool found = m_bvh.traverse(ray, closest, [&](u32 position, f32& t_closest) {
+        const u32 mesh = m_bvh.get_primitive(position);
+        if (!m_meshes[mesh]->raycast(ray, t_closest, hit))
+            return false;
+
+        hit.mesh = mesh;
+        return true;
+    });
+
+    if (!found)
+        return std::nullopt;
+
+    return hit;
+}
+
+bool Model::import(const std::string& path, bool flip_uvs, u64 source_hash) {
+    Assimp::Importer importer;
+    // Owned by the importer
+    auto* io_system = new DependencyTrackingIOSystem(path);
+    importer.SetIOHandler(io_system);
+
+    u32 flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace;
+    if (flip_uvs)
+        flags |= aiProcess_FlipUVs;
+
+    const aiScene* scene = importer.ReadFile(path, flags);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+        HG_LOG_ERROR("Error loading model {} with error: {}", path, importer.GetErrorString());
+        return false;
+    }
+
+    std::vector<MaterialDescription> materials;
+    materials.reserve(scene->mNumMaterials);
+    for (u32 i = 0; i < scene->mNumMaterials; ++i) {
+        materials.push_back(describe_material(scene->mMaterials[i]));
+    }
+
+    // Meshes are independent, each job converts, reorders and simplifies one
+    std::vector<ImportedMesh*> meshes(scene->mNumMeshes);
+    JobSystem::instance->parallel_for(scene->mNumMeshes, [&](u32 i) {
+        meshes[i] = new ImportedMesh(scene->mMeshes[i]);
+    });
+
+    std::vector<u32> node_meshes;
+    collect_node_meshes_r(scene->mRootNode, node_meshes);
+
+    std::vector<MeshGeometry> geometries;
+    std::vector<MaterialDescription> mesh_materials;
+    for (u32 mesh : node_meshes) {
+        geometries.push_back(meshes[mesh]->get_geometry());
+        mesh_materials.push_back(materials[meshes[mesh]->get_material()]);
+    }
+    create_meshes(geometries, mesh_materials);
+
+    const std::string baked_path = path + MESH_FILE_EXTENSION;
+    if (!MeshFile::write(baked_path, source_hash, meshes, materials, node_meshes, io_system->get_dependencies()))
+        HG_LOG_WARN("Could not write baked model {}", baked_path);
+
+    for (auto* mesh : meshes) {
+        delete mesh;
+    }
+
+    return true;
+}
+
+void Model::load_baked(const MeshFile& baked) {
+    std::vector<MeshGeometry> geometries;
+    std::vector<MaterialDescription> mesh_materials;
+    for (u32 mesh : baked.get_node_meshes()) {
+        geometries.push_back(baked.get_geometry(mesh));
+        mesh_materials.push_back(baked.get_material(baked.get_material_index(mesh)));
+    }
+    create_meshes(geometries, mesh_materials);
+}
+
+void Model::create_meshes(std::span<const MeshGeometry> geometries, std::span<const MaterialDescription> materials) {
+    // Every texture is decoded at once, creating the materials then finds them loaded
+    std::vector<std::pair<std::string, TextureUsage>> textures;
+    std::vector<std::pair<std::string, TextureUsage>> layers;
+    for (const auto& material : materials) {
+        auto& destination = uses_texture_layers(material) ? layers : textures;
+        for (const auto& texture : MATERIAL_DESCRIPTION_TEXTURES) {
+            if (!(material.*texture.path).empty())
+                destination.emplace_back(m_directory + material.*texture.path, texture.usage);
+        }
+    }
+    TextureSystem::instance->preload(textures);
+    TextureSystem::instance->preload(layers, true);
+
+    std::vector<TriangleBVH> bvhs(geometries.size());
+    JobSystem::instance->parallel_for((u32)geometries.size(), [&](u32 i) {
+        bvhs[i] = Mesh::build_bvh(geometries[i]);
+    });
+
+    // GL objects are created on this thread
+    for (u32 i = 0; i < geometries.size(); ++i) {
+        auto* mesh =
+            new Mesh(geometries[i], create_material(materials[i], m_directory), std::move(bvhs[i]), m_split_positions);
+        m_bounds.expand(mesh->bounds);
+        m_meshes.push_back(mesh);
     }
 }
 
@@ -2,6 +2,9 @@
 
 #include "core.h"
 
+#include <limits>
+#include <optional>
+#include <span>
 #include <vector>
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
@@ -9,21 +12,47 @@
 
 #include "renderer/shader.h"
 #include "mesh.h"
+#include "mesh_file.h"
 
 namespace Hydrogen {
 
 class HG_API Model {
   public:
-    Model(const std::string& path, bool flip_uvs = false);
+    // split_positions stores mesh positions in their own vertex buffer, see Mesh::position_VAO.
+    // The first load imports the source and bakes it next to it (path + MESH_FILE_EXTENSION), later loads
+    // map the baked file while the source does not change
+    Model(const std::string& path, bool flip_uvs = false, bool split_positions = false);
     ~Model();
 
     const std::vector<Mesh*>& get_meshes() const;
+    const AABB& get_bounds() const { return m_bounds; }
+
+    // Closest triangle hit by a model space ray, direction does not need to be normalized
+    // and distances are measured in units of its length
+    std::optional<RayHit> raycast(const glm::vec3& origin,
+                                  const glm::vec3& direction,
+                                  f32 max_distance = std::numeric_limits<f32>::max()) const;
+    // Casts a batch of rays, hits[i] is the result for rays[i]
+    void raycast(std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) const;
 
   private:
     std::vector<Mesh*> m_meshes;
     std::string m_directory;
+    bool m_split_positions;
+
+    // Union of the bounds of all meshes
+    AABB m_bounds;
+    // Top level hierarchy over the bounds of the meshes
+    BVH m_bvh;
+
+    std::optional<RayHit> raycast(const Ray& ray, f32 max_distance) const;
 
-    void process_node_r(aiNode* node, const aiScene* scene);
+    // Returns false if assimp could not read the source
+    bool import(const std::string& path, bool flip_uvs, u64 source_hash);
+    void load_baked(const MeshFile& baked);
+    // Creates one mesh per geometry. Textures are decoded and BVHs built on the job system, the calling
+    // thread only uploads
+    void create_meshes(std::span<const MeshGeometry> geometries, std::span<const MaterialDescription> materials);
 };
 
 } // namespace Hydrogen
@@ -0,0 +1,84 @@
+#include "range_allocator.h"
+
+namespace Hydrogen {
+
+RangeAllocator::RangeAllocator(u32 capacity) : m_capacity(capacity), m_free_space(0) {
+    if (capacity > 0)
+        free(0, capacity);
+}
+
+std::optional<u32> RangeAllocator::allocate(u32 size) {
+    if (size == 0)
+        return std::nullopt;
+
+    auto best = m_free_ranges.end();
+    for (auto it = m_free_ranges.begin(); it != m_free_ranges.end(); ++it) {
+        if (it->second < size)
+            continue;
+
+        if (best == m_free_ranges.end() || it->second < best->second) {
+            best = it;
+            if (best->second == size)
+                break;
+        }
+    }
+
+    if (best == m_free_ranges.end())
+        return std::nullopt;
+
+    const u32 offset = best->first;
+    const u32 remaining = best->second - size;
+
+    m_free_ranges.erase(best);
+    if (remaining > 0) {
+        m_free_ranges.insert({offset + size, remaining});
+    }
+
+    m_free_space -= size;
+    return offset;
+}
+
+void RangeAllocator::free(u32 offset, u32 size) {
+    if (size == 0)
+        return;
+
+    HG_ASSERT(offset + size <= m_capacity, "Freed range is outside of the allocator");
+    m_free_space += size;
+
+    auto next = m_free_ranges.lower_bound(offset);
+
+    // Merge with the previous free range
+    if (next != m_free_ranges.begin()) {
+        auto previous = std::prev(next);
+        HG_ASSERT(previous->first + previous->second <= offset, "Range freed twice");
+
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            m_free_ranges.erase(previous);
+        }
+    }
+
+    // Merge with the next free range
+    if (next != m_free_ranges.end()) {
+        HG_ASSERT(offset + size <= next->first, "Range freed twice");
+
+        if (offset + size == next->first) {
+            size += next->second;
+            m_free_ranges.erase(next);
+        }
+    }
+
+    m_free_ranges.insert({offset, size});
+}
+
+void RangeAllocator::grow(u32 capacity) {
+    if (capacity <= m_capacity)
+        return;
+
+    const u32 old_capacity = m_capacity;
+    m_capacity = capacity;
+    free(old_capacity, capacity - old_capacity);
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "core.h"
+
+#include <map>
+#include <optional>
+
+namespace Hydrogen {
+
+// Hands out ranges of [0, capacity) from a free list, adjacent free ranges are merged on release
+class HG_API RangeAllocator {
+  public:
+    explicit RangeAllocator(u32 capacity);
+    ~RangeAllocator() = default;
+
+    // Best fit, empty if no free range is large enough
+    std::optional<u32> allocate(u32 size);
+    void free(u32 offset, u32 size);
+
+    // Extends the managed range, the new space is free
+    void grow(u32 capacity);
+
+    u32 get_capacity() const { return m_capacity; }
+    u32 get_free_space() const { return m_free_space; }
+
+  private:
+    u32 m_capacity;
+    u32 m_free_space;
+
+    // Size of each free range by offset
+    std::map<u32, u32> m_free_ranges;
+};
+
+} // namespace Hydrogen
@@ -11,12 +11,17 @@ namespace Hydrogen {
 
 using ShaderId = usize;
 
+// Binding point of the MaterialBlock uniform block, after Camera (0) and Lights (1)
+#define MATERIAL_UNIFORM_BLOCK_SLOT 2
+
 class IMaterial {
   public:
     virtual ~IMaterial() = default;
 
     virtual void build() = 0;
-    virtual Shader* bind(u32 slot = 0) const = 0;
+    // The instanced variant reads the model matrix from per-instance vertex attributes
+    virtual Shader* bind(u32 slot = 0, bool instanced = false) const = 0;
+    virtual Shader* get_shader(bool instanced = false) const = 0;
 };
 
 } // namespace Hydrogen
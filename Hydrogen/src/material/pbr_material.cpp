@@ -1,15 +1,31 @@
 #include "pbr_material.h"
 
 #include "systems/shader_system.h"
-#include "pbr_shader_compiler.h"
+#include "systems/texture_system.h"
 
 namespace Hydrogen {
 
-PBRMaterial::PBRMaterial() : m_shader_id(), m_built(false) {
+PBRMaterial::PBRMaterial() : m_shader_id(), m_built(false), m_uniform_buffer(nullptr) {
 }
 
 PBRMaterial::~PBRMaterial() {
     ShaderSystem::instance->release(m_shader_id);
+    delete m_uniform_buffer;
+
+    if (m_instanced_shader_id.has_value()) {
+        ShaderSystem::instance->release(m_instanced_shader_id.value());
+    }
+
+    // Unreferenced textures can then be evicted
+    for (const auto& map : {albedo_map, metallic_map, roughness_map, ao_map, normal_map}) {
+        if (map.has_value())
+            TextureSystem::instance->release(map.value());
+    }
+    // Arrays left without used layers are deleted
+    for (const auto& layer : {albedo_layer, metallic_layer, roughness_layer, ao_layer, normal_layer}) {
+        if (layer.has_value())
+            TextureSystem::instance->release(layer.value());
+    }
 }
 
 void PBRMaterial::build() {
@@ -18,82 +34,109 @@ void PBRMaterial::build() {
         return;
     }
 
-    auto compiler = PBRShaderCompiler(PBRShaderArguments{
-        .albedo = albedo,
-        .metallic = metallic,
-        .roughness = roughness,
-        .ao = ao,
-        .albedo_map = albedo_map,
-        .metallic_map = metallic_map,
-        .roughness_map = roughness_map,
-        .ao_map = ao_map,
-        .normal_map = normal_map,
-
-        .metallic_roughness_same_texture = metallic_roughness_same_texture,
-        .metallic_roughness_ao_same_texture = metallic_roughness_ao_same_texture
-    });
+    auto compiler = PBRShaderCompiler(get_shader_arguments(false));
 
     m_shader_id = ShaderSystem::instance->acquire_from_compiler(compiler);
+    m_uniform_buffer = new UniformBuffer(sizeof(UniformData));
     m_built = true;
 }
 
-Shader* PBRMaterial::bind(u32 slot) const {
-    HG_ASSERT(m_built, "You must build the Material before binding it");
-
-    auto* shader = ShaderSystem::instance->get(m_shader_id);
-    HG_ASSERT(shader != nullptr, "Unexpected error: shader is null");
+// Binds the texture array of the layer if the material samples one, the texture otherwise
+static void bind_map(const std::optional<Texture*>& map,
+                     const std::optional<TextureLayer>& layer,
+                     UniformName name,
+                     Shader* shader,
+                     u32 slot) {
+    if (layer.has_value())
+        layer->page->bind(name, shader, slot);
+    else if (map.has_value())
+        map.value()->bind(name, shader, slot);
+}
 
-    // Albedo color
-    if (albedo.has_value()) {
-        shader->set_uniform_vec3("Material.albedo", albedo.value());
-    }
+static f32 get_layer_index(const std::optional<TextureLayer>& layer) {
+    return layer.has_value() ? (f32)layer->layer : 0.0f;
+}
 
-    // Metallic value
-    if (metallic.has_value()) {
-        shader->set_uniform_float("Material.metallic", metallic.value());
-    }
+Shader* PBRMaterial::bind(u32 slot, bool instanced) const {
+    HG_ASSERT(m_built, "You must build the Material before binding it");
 
-    // Roughness value
-    if (roughness.has_value()) {
-        shader->set_uniform_float("Material.roughness", roughness.value());
-    }
+    auto* shader = get_shader(instanced);
+    HG_ASSERT(shader != nullptr, "Unexpected error: shader is null");
 
-    // AO value
-    if (ao.has_value()) {
-        shader->set_uniform_float("Material.ao", ao.value());
-    }
+    // Material values, only reach the GPU when they differ from the last upload
+    const UniformData data = get_uniform_data();
+    m_uniform_buffer->update(&data, sizeof(UniformData));
+    m_uniform_buffer->flush();
+    shader->assign_uniform_buffer("MaterialBlock", m_uniform_buffer, MATERIAL_UNIFORM_BLOCK_SLOT);
 
     // Albedo map
-    if (albedo_map.has_value()) {
-        const Texture* albedo_map_texture = albedo_map.value();
-        albedo_map_texture->bind("Material.albedo_map", shader, slot);
-    }
+    bind_map(albedo_map, albedo_layer, "AlbedoMap", shader, slot);
 
     // Metallic map
-    if (metallic_map.has_value()) {
-        const Texture* metallic_map_texture = metallic_map.value();
-        metallic_map_texture->bind("Material.metallic_map", shader, slot + 1);
-    }
+    bind_map(metallic_map, metallic_layer, "MetallicMap", shader, slot + 1);
 
     // Roughness map
-    if (roughness_map.has_value()) {
-        const Texture* roughness_map_texture = roughness_map.value();
-        roughness_map_texture->bind("Material.roughness_map", shader, slot + 2);
-    }
+    bind_map(roughness_map, roughness_layer, "RoughnessMap", shader, slot + 2);
 
     // AO map
-    if (ao_map.has_value()) {
-        const Texture* ao_map_texture = ao_map.value();
-        ao_map_texture->bind("Material.ao_map", shader, slot + 3);
-    }
+    bind_map(ao_map, ao_layer, "AOMap", shader, slot + 3);
 
     // Normal map
-    if (normal_map.has_value()) {
-        const Texture* normal_map_texture = normal_map.value();
-        normal_map_texture->bind("Material.normal_map", shader, slot + 4);
-    }
+    bind_map(normal_map, normal_layer, "NormalMap", shader, slot + 4);
 
     return shader;
 }
 
+Shader* PBRMaterial::get_shader(bool instanced) const {
+    HG_ASSERT(m_built, "You must build the Material before using its shader");
+
+    if (!instanced) {
+        return ShaderSystem::instance->get(m_shader_id);
+    }
+
+    if (!m_instanced_shader_id.has_value()) {
+        auto compiler = PBRShaderCompiler(get_shader_arguments(true));
+        m_instanced_shader_id = ShaderSystem::instance->acquire_from_compiler(compiler);
+    }
+    return ShaderSystem::instance->get(m_instanced_shader_id.value());
+}
+
+PBRMaterial::UniformData PBRMaterial::get_uniform_data() const {
+    return UniformData{
+        .albedo = glm::vec4(albedo.value_or(glm::vec3(0.0f)), 1.0f),
+        .metallic = metallic.value_or(0.0f),
+        .roughness = roughness.value_or(0.0f),
+        .ao = ao.value_or(0.0f),
+        .normal_layer = get_layer_index(normal_layer),
+        .layers = glm::vec4(get_layer_index(albedo_layer),
+                            get_layer_index(metallic_layer),
+                            get_layer_index(roughness_layer),
+                            get_layer_index(ao_layer)),
+    };
+}
+
+PBRShaderArguments PBRMaterial::get_shader_arguments(bool instanced) const {
+    return PBRShaderArguments{
+        .albedo = albedo,
+        .metallic = metallic,
+        .roughness = roughness,
+        .ao = ao,
+        .albedo_map = albedo_map,
+        .metallic_map = metallic_map,
+        .roughness_map = roughness_map,
+        .ao_map = ao_map,
+        .normal_map = normal_map,
+        .albedo_layer = albedo_layer,
+        .metallic_layer = metallic_layer,
+        .roughness_layer = roughness_layer,
+        .ao_layer = ao_layer,
+        .normal_layer = normal_layer,
+
+        .metallic_roughness_same_texture = metallic_roughness_same_texture,
+        .metallic_roughness_ao_same_texture = metallic_roughness_ao_same_texture,
+
+        .instanced = instanced
+    };
+}
+
 } // namespace Hydrogen
@@ -3,6 +3,7 @@
 #include "core.h"
 
 #include "material.h"
+#include "pbr_shader_compiler.h"
 
 namespace Hydrogen {
 
@@ -11,13 +12,38 @@ class HG_API PBRMaterial : public IMaterial {
     PBRMaterial();
     ~PBRMaterial() override;
 
+    // Owns its uniform buffer and references to its textures
+    PBRMaterial(const PBRMaterial&) = delete;
+    PBRMaterial& operator=(const PBRMaterial&) = delete;
+
     void build() override;
-    Shader* bind(u32 slot) const override;
+    Shader* bind(u32 slot, bool instanced) const override;
+    Shader* get_shader(bool instanced) const override;
+
+    // Layout of the MaterialBlock uniform block in base.pbr.frag
+    struct UniformData {
+        glm::vec4 albedo;
+        f32 metallic;
+        f32 roughness;
+        f32 ao;
+        f32 normal_layer;
+        // Layers sampled from albedo, metallic, roughness and ao texture arrays
+        glm::vec4 layers;
+    };
 
   private:
     ShaderId m_shader_id;
     bool m_built;
 
+    // Only uploaded when the material values change
+    UniformBuffer* m_uniform_buffer;
+
+    // Acquired the first time the material is drawn instanced
+    mutable std::optional<ShaderId> m_instanced_shader_id;
+
+    PBRShaderArguments get_shader_arguments(bool instanced) const;
+    UniformData get_uniform_data() const;
+
   public:
     // Material values
     std::optional<glm::vec3> albedo;
@@ -25,12 +51,21 @@ class HG_API PBRMaterial : public IMaterial {
     std::optional<float> roughness;
     std::optional<float> ao;
 
+    // Acquired from TextureSystem, released with the material
     std::optional<Texture*> albedo_map;
     std::optional<Texture*> metallic_map;
     std::optional<Texture*> roughness_map;
     std::optional<Texture*> ao_map;
     std::optional<Texture*> normal_map;
 
+    // Used in place of the maps above, also released with the material. Materials sampling the same arrays
+    // share their bindings, and only the layers in their uniform block change between them
+    std::optional<TextureLayer> albedo_layer;
+    std::optional<TextureLayer> metallic_layer;
+    std::optional<TextureLayer> roughness_layer;
+    std::optional<TextureLayer> ao_layer;
+    std::optional<TextureLayer> normal_layer;
+
     bool metallic_roughness_same_texture = false;
     bool metallic_roughness_ao_same_texture = false;
 };
@@ -18,6 +18,10 @@ namespace Hydrogen {
     result += m_arguments.opt.has_value() * (usize)(1 << iter); \
     iter++;
 
+#define REGISTER_HASH_COMPONENT_BOOL(cond, result, iter) \
+    result += m_arguments.cond * (usize)(1 << iter);      \
+    iter++;
+
 #define BASE_VERTEX_PATH "shaders/base.pbr.vert"
 #define BASE_FRAGMENT_PATH "shaders/base.pbr.frag"
 
@@ -53,9 +57,20 @@ Shader* PBRShaderCompiler::compile() const {
     REGISTER_DEFINE(roughness_map, "roughness_texture");
     REGISTER_DEFINE(ao_map, "ao_texture");
     REGISTER_DEFINE(normal_map, "normal_texture");
+    REGISTER_DEFINE(albedo_layer, "albedo_layered");
+    REGISTER_DEFINE(metallic_layer, "metallic_layered");
+    REGISTER_DEFINE(roughness_layer, "roughness_layered");
+    REGISTER_DEFINE(ao_layer, "ao_layered");
+    REGISTER_DEFINE(normal_layer, "normal_layered");
     REGISTER_DEFINE_BOOL(metallic_roughness_same_texture, "metallic_roughness_texture");
     REGISTER_DEFINE_BOOL(metallic_roughness_ao_same_texture, "metallic_roughness_ao_texture");
 
+    std::string vertex_defines;
+    if (m_arguments.instanced) {
+        vertex_defines += "#define instanced\n";
+    }
+
+    vertex_source = version + vertex_defines + vertex_source;
     fragment_source = version + defines + fragment_source;
 
     return Shader::from_string(vertex_source, fragment_source);
@@ -73,6 +88,12 @@ usize PBRShaderCompiler::get_hash() const {
     REGISTER_HASH_COMPONENT(roughness_map, hash, iter);
     REGISTER_HASH_COMPONENT(ao_map, hash, iter);
     REGISTER_HASH_COMPONENT(normal_map, hash, iter);
+    REGISTER_HASH_COMPONENT(albedo_layer, hash, iter);
+    REGISTER_HASH_COMPONENT(metallic_layer, hash, iter);
+    REGISTER_HASH_COMPONENT(roughness_layer, hash, iter);
+    REGISTER_HASH_COMPONENT(ao_layer, hash, iter);
+    REGISTER_HASH_COMPONENT(normal_layer, hash, iter);
+    REGISTER_HASH_COMPONENT_BOOL(instanced, hash, iter);
 
     return (hash * 0x08475) % 43476;
 }
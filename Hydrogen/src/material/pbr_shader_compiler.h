@@ -4,6 +4,7 @@
 
 #include "shader_compiler.h"
 #include "renderer/texture.h"
+#include "renderer/texture_array.h"
 
 namespace Hydrogen {
 
@@ -19,8 +20,16 @@ struct PBRShaderArguments {
     std::optional<Texture*> ao_map;
     std::optional<Texture*> normal_map;
 
+    std::optional<TextureLayer> albedo_layer;
+    std::optional<TextureLayer> metallic_layer;
+    std::optional<TextureLayer> roughness_layer;
+    std::optional<TextureLayer> ao_layer;
+    std::optional<TextureLayer> normal_layer;
+
     bool metallic_roughness_same_texture;
     bool metallic_roughness_ao_same_texture;
+
+    bool instanced = false;
 };
 
 class HG_API PBRShaderCompiler : public IShaderCompiler {
@@ -1,15 +1,26 @@
 #include "phong_material.h"
 
 #include "systems/shader_system.h"
-#include "phong_shader_compiler.h"
+#include "systems/texture_system.h"
 
 namespace Hydrogen {
 
-PhongMaterial::PhongMaterial() : m_shader_id(), m_built(false) {
+PhongMaterial::PhongMaterial() : m_shader_id(), m_built(false), m_uniform_buffer(nullptr) {
 }
 
 PhongMaterial::~PhongMaterial() {
     ShaderSystem::instance->release(m_shader_id);
+    delete m_uniform_buffer;
+
+    if (m_instanced_shader_id.has_value()) {
+        ShaderSystem::instance->release(m_instanced_shader_id.value());
+    }
+
+    // Unreferenced textures can then be evicted
+    for (const auto& map : {diffuse_map, specular_map, normal_map}) {
+        if (map.has_value())
+            TextureSystem::instance->release(map.value());
+    }
 }
 
 void PhongMaterial::build() {
@@ -18,63 +29,82 @@ void PhongMaterial::build() {
         return;
     }
 
-    auto compiler = PhongShaderCompiler(PhongShaderArguments{
-        .ambient = ambient,
-        .diffuse = diffuse,
-        .specular = specular,
-        .shininess = shininess,
-        .diffuse_map = diffuse_map,
-        .specular_map = specular_map,
-        .normal_map = normal_map
-    });
+    auto compiler = PhongShaderCompiler(get_shader_arguments(false));
 
     m_shader_id = ShaderSystem::instance->acquire_from_compiler(compiler);
+    m_uniform_buffer = new UniformBuffer(sizeof(UniformData));
     m_built = true;
 }
 
-Shader* PhongMaterial::bind(u32 slot) const {
+Shader* PhongMaterial::bind(u32 slot, bool instanced) const {
     HG_ASSERT(m_built, "You must build the Material before binding it");
 
-    Shader* shader = ShaderSystem::instance->get(m_shader_id);
+    Shader* shader = get_shader(instanced);
     HG_ASSERT(shader != nullptr, "Unexpected error: shader is null");
 
-    // Ambient Color
-    shader->set_uniform_vec3("Material.ambient", ambient);
-
-    // Diffuse Color
-    if (diffuse.has_value()) {
-        shader->set_uniform_vec3("Material.diffuse", diffuse.value());
-    }
-
-    // Specular color
-    if (specular.has_value()) {
-        shader->set_uniform_vec3("Material.specular", specular.value());
-    }
-
-    // Shininess
-    if (shininess.has_value()) {
-        shader->set_uniform_float("Material.shininess", shininess.value());
-    }
+    // Material values, only reach the GPU when they differ from the last upload
+    const UniformData data = get_uniform_data();
+    m_uniform_buffer->update(&data, sizeof(UniformData));
+    m_uniform_buffer->flush();
+    shader->assign_uniform_buffer("MaterialBlock", m_uniform_buffer, MATERIAL_UNIFORM_BLOCK_SLOT);
 
     // Diffuse Texture
     if (diffuse_map.has_value()) {
         const Texture* diffuse_map_texture = diffuse_map.value();
-        diffuse_map_texture->bind("Material.diffuse_map", shader, slot);
+        diffuse_map_texture->bind("DiffuseMap", shader, slot);
     }
 
     // Specular Texture
     if (specular_map.has_value()) {
         const Texture* specular_map_texture = specular_map.value();
-        specular_map_texture->bind("Material.specular_map", shader, slot + 1);
+        specular_map_texture->bind("SpecularMap", shader, slot + 1);
     }
 
     // Normal Texture
     if (normal_map.has_value()) {
         const Texture* normal_map_texture = normal_map.value();
-        normal_map_texture->bind("Material.normal_map", shader, slot + 2);
+        normal_map_texture->bind("NormalMap", shader, slot + 2);
     }
 
     return shader;
 }
 
+Shader* PhongMaterial::get_shader(bool instanced) const {
+    HG_ASSERT(m_built, "You must build the Material before using its shader");
+
+    if (!instanced) {
+        return ShaderSystem::instance->get(m_shader_id);
+    }
+
+    if (!m_instanced_shader_id.has_value()) {
+        auto compiler = PhongShaderCompiler(get_shader_arguments(true));
+        m_instanced_shader_id = ShaderSystem::instance->acquire_from_compiler(compiler);
+    }
+    return ShaderSystem::instance->get(m_instanced_shader_id.value());
+}
+
+PhongMaterial::UniformData PhongMaterial::get_uniform_data() const {
+    return UniformData{
+        .ambient = glm::vec4(ambient, 1.0f),
+        .diffuse = glm::vec4(diffuse.value_or(glm::vec3(0.0f)), 1.0f),
+        .specular = glm::vec4(specular.value_or(glm::vec3(0.0f)), 1.0f),
+        .shininess = shininess.value_or(0.0f),
+        .padding = {},
+    };
+}
+
+PhongShaderArguments PhongMaterial::get_shader_arguments(bool instanced) const {
+    return PhongShaderArguments{
+        .ambient = ambient,
+        .diffuse = diffuse,
+        .specular = specular,
+        .shininess = shininess,
+        .diffuse_map = diffuse_map,
+        .specular_map = specular_map,
+        .normal_map = normal_map,
+
+        .instanced = instanced
+    };
+}
+
 } // namespace Hydrogen
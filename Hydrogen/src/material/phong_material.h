@@ -3,6 +3,7 @@
 #include "core.h"
 
 #include "material.h"
+#include "phong_shader_compiler.h"
 
 namespace Hydrogen {
 
@@ -11,13 +12,36 @@ class HG_API PhongMaterial : public IMaterial {
     PhongMaterial();
     ~PhongMaterial() override;
 
+    // Owns its uniform buffer and references to its textures
+    PhongMaterial(const PhongMaterial&) = delete;
+    PhongMaterial& operator=(const PhongMaterial&) = delete;
+
     void build() override;
-    Shader* bind(u32 slot) const override;
+    Shader* bind(u32 slot, bool instanced) const override;
+    Shader* get_shader(bool instanced) const override;
+
+    // Layout of the MaterialBlock uniform block in base.phong.frag
+    struct UniformData {
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+        f32 shininess;
+        f32 padding[3];
+    };
 
   private:
     ShaderId m_shader_id;
     bool m_built;
 
+    // Only uploaded when the material values change
+    UniformBuffer* m_uniform_buffer;
+
+    // Acquired the first time the material is drawn instanced
+    mutable std::optional<ShaderId> m_instanced_shader_id;
+
+    PhongShaderArguments get_shader_arguments(bool instanced) const;
+    UniformData get_uniform_data() const;
+
   public:
     // Material values
     glm::vec3 ambient{1.0f, 1.0f, 1.0f};
@@ -25,6 +49,7 @@ class HG_API PhongMaterial : public IMaterial {
     std::optional<glm::vec3> specular;
     std::optional<f32> shininess;
 
+    // Acquired from TextureSystem, released with the material
     std::optional<Texture*> diffuse_map;
     std::optional<Texture*> specular_map;
     std::optional<Texture*> normal_map;
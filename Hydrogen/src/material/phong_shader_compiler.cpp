@@ -13,6 +13,10 @@ namespace Hydrogen {
     result += m_arguments.opt.has_value() * (usize)(1 << iter); \
     iter++;
 
+#define REGISTER_HASH_COMPONENT_BOOL(cond, result, iter) \
+    result += m_arguments.cond * (usize)(1 << iter);      \
+    iter++;
+
 #define BASE_VERTEX_PATH "shaders/base.phong.vert"
 #define BASE_FRAGMENT_PATH "shaders/base.phong.frag"
 
@@ -46,6 +50,12 @@ Shader* PhongShaderCompiler::compile() const {
     REGISTER_DEFINE(specular_map, "specular_texture");
     REGISTER_DEFINE(normal_map, "normal_texture");
 
+    std::string vertex_defines;
+    if (m_arguments.instanced) {
+        vertex_defines += "#define instanced\n";
+    }
+
+    vertex_source = version + vertex_defines + vertex_source;
     fragment_source = version + defines + fragment_source;
 
     return Shader::from_string(vertex_source, fragment_source);
@@ -60,6 +70,7 @@ usize PhongShaderCompiler::get_hash() const {
     REGISTER_HASH_COMPONENT(diffuse_map, hash, iter);
     REGISTER_HASH_COMPONENT(specular_map, hash, iter);
     REGISTER_HASH_COMPONENT(normal_map, hash, iter);
+    REGISTER_HASH_COMPONENT_BOOL(instanced, hash, iter);
 
     return ((hash << 45) * 0x14573) % 62819;
 }
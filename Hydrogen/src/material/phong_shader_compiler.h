@@ -16,6 +16,8 @@ struct PhongShaderArguments {
     std::optional<Texture*> diffuse_map;
     std::optional<Texture*> specular_map;
     std::optional<Texture*> normal_map;
+
+    bool instanced = false;
 };
 
 class PhongShaderCompiler : public IShaderCompiler {
@@ -0,0 +1,464 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+namespace Hydrogen {
+
+#define BLOCK_PIXELS 16
+// Power iterations used to find the axis colors of a block spread along
+#define BLOCK_AXIS_ITERATIONS 8
+
+bool BlockFormatSupport::supports(TextureFormat format) const {
+    switch (format) {
+        case TextureFormat::RGBA8:
+            return true;
+        case TextureFormat::BC1:
+        case TextureFormat::BC3:
+            return s3tc;
+        case TextureFormat::BC4:
+        case TextureFormat::BC5:
+            return rgtc;
+        case TextureFormat::BC7:
+            return bptc;
+    }
+    return false;
+}
+
+bool is_block_compressed(TextureFormat format) {
+    return format != TextureFormat::RGBA8;
+}
+
+static u32 get_block_size(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::BC1:
+        case TextureFormat::BC4:
+            return 8;
+        case TextureFormat::BC3:
+        case TextureFormat::BC5:
+        case TextureFormat::BC7:
+            return 16;
+        case TextureFormat::RGBA8:
+            break;
+    }
+    return 0;
+}
+
+u64 get_level_size(TextureFormat format, i32 width, i32 height) {
+    if (!is_block_compressed(format))
+        return (u64)width * (u64)height * 4;
+
+    const auto blocks_x = ((u64)width + 3) / 4;
+    const auto blocks_y = ((u64)height + 3) / 4;
+    return blocks_x * blocks_y * get_block_size(format);
+}
+
+//
+// Endpoint fitting
+//
+
+// Writes values least significant bit first, the order every BC format packs its fields in
+class BlockWriter {
+  public:
+    explicit BlockWriter(u8* block) : m_block(block) {}
+
+    void write(u64 value, u32 bits) {
+        for (u32 i = 0; i < bits; ++i, ++m_position) {
+            if (((value >> i) & 1) != 0)
+                m_block[m_position / 8] |= (u8)(1u << (m_position % 8));
+        }
+    }
+
+  private:
+    u8* m_block;
+    u32 m_position = 0;
+};
+
+// Direction the pixels vary most along, found by power iteration on their covariance
+template <typename Vector, typename Matrix>
+static Vector principal_axis(const std::array<Vector, BLOCK_PIXELS>& pixels, const Vector& mean) {
+    Matrix covariance(0.0f);
+    for (const auto& pixel : pixels) {
+        const Vector offset = pixel - mean;
+        covariance += glm::outerProduct(offset, offset);
+    }
+
+    Vector axis(1.0f);
+    for (u32 i = 0; i < BLOCK_AXIS_ITERATIONS; ++i) {
+        const Vector next = covariance * axis;
+        const f32 length = glm::length(next);
+        if (length < 1e-6f)
+            return Vector(0.0f);
+        axis = next / length;
+    }
+    return axis;
+}
+
+// Extremes of the pixels projected on their principal axis
+template <typename Vector, typename Matrix>
+static std::pair<Vector, Vector> fit_endpoints(const std::array<Vector, BLOCK_PIXELS>& pixels) {
+    Vector mean(0.0f);
+    for (const auto& pixel : pixels) {
+        mean += pixel;
+    }
+    mean /= (f32)BLOCK_PIXELS;
+
+    const Vector axis = principal_axis<Vector, Matrix>(pixels, mean);
+
+    f32 low = std::numeric_limits<f32>::max();
+    f32 high = std::numeric_limits<f32>::lowest();
+    for (const auto& pixel : pixels) {
+        const f32 t = glm::dot(pixel - mean, axis);
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+
+    return {glm::clamp(mean + axis * low, 0.0f, 255.0f), glm::clamp(mean + axis * high, 0.0f, 255.0f)};
+}
+
+// Endpoints minimizing the squared error of the pixels, each interpolated weights[i] of the way from the
+// first endpoint to the second. Returns false if the weights do not constrain both endpoints
+template <typename Vector>
+static bool refit_endpoints(const std::array<Vector, BLOCK_PIXELS>& pixels,
+                            const std::array<f32, BLOCK_PIXELS>& weights,
+                            Vector& first,
+                            Vector& second) {
+    f32 aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    Vector ax(0.0f), bx(0.0f);
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+        const f32 a = 1.0f - weights[i];
+        const f32 b = weights[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax += a * pixels[i];
+        bx += b * pixels[i];
+    }
+
+    const f32 determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+
+    first = glm::clamp((bb * ax - ab * bx) / determinant, 0.0f, 255.0f);
+    second = glm::clamp((aa * bx - ab * ax) / determinant, 0.0f, 255.0f);
+    return true;
+}
+
+// Index of the closest palette entry for every pixel, returns the total squared error
+template <typename Vector, usize N>
+static f32 select_indices(const std::array<Vector, BLOCK_PIXELS>& pixels,
+                          const std::array<Vector, N>& palette,
+                          std::array<u8, BLOCK_PIXELS>& indices) {
+    f32 total = 0.0f;
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+        f32 best = std::numeric_limits<f32>::max();
+        for (u32 entry = 0; entry < N; ++entry) {
+            const Vector difference = pixels[i] - palette[entry];
+            const f32 error = glm::dot(difference, difference);
+            if (error < best) {
+                best = error;
+                indices[i] = (u8)entry;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+//
+// BC4
+//
+
+// One channel with 8 interpolated values, or 6 plus exact 0 and 255 when that fits the block better
+static void encode_bc4(const std::array<f32, BLOCK_PIXELS>& values, u8* block) {
+    std::array<glm::vec1, BLOCK_PIXELS> pixels;
+    f32 low = 255.0f, high = 0.0f;
+    f32 inner_low = 255.0f, inner_high = 0.0f;
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+        pixels[i] = glm::vec1(values[i]);
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+        if (values[i] > 0.0f && values[i] < 255.0f) {
+            inner_low = std::min(inner_low, values[i]);
+            inner_high = std::max(inner_high, values[i]);
+        }
+    }
+
+    // First endpoint larger selects the 8 value palette
+    auto first = (u8)std::lround(high);
+    auto second = (u8)std::lround(low);
+    std::array<glm::vec1, 8> palette;
+    palette[0] = glm::vec1(first);
+    palette[1] = glm::vec1(second);
+    for (u32 i = 2; i < 8; ++i) {
+        palette[i] = glm::vec1(std::round((f32)((8 - i) * first + (i - 1) * second) / 7.0f));
+    }
+
+    std::array<u8, BLOCK_PIXELS> indices{};
+    f32 error = first == second ? 0.0f : select_indices(pixels, palette, indices);
+
+    if (first != second && inner_low <= inner_high) {
+        const auto low_6 = (u8)std::lround(inner_low);
+        const auto high_6 = (u8)std::lround(inner_high);
+        std::array<glm::vec1, 8> palette_6;
+        palette_6[0] = glm::vec1(low_6);
+        palette_6[1] = glm::vec1(high_6);
+        for (u32 i = 2; i < 6; ++i) {
+            palette_6[i] = glm::vec1(std::round((f32)((6 - i) * low_6 + (i - 1) * high_6) / 5.0f));
+        }
+        palette_6[6] = glm::vec1(0.0f);
+        palette_6[7] = glm::vec1(255.0f);
+
+        std::array<u8, BLOCK_PIXELS> indices_6{};
+        const f32 error_6 = select_indices(pixels, palette_6, indices_6);
+        if (error_6 < error) {
+            first = low_6;
+            second = high_6;
+            indices = indices_6;
+        }
+    }
+
+    BlockWriter writer(block);
+    writer.write(first, 8);
+    writer.write(second, 8);
+    for (u8 index : indices) {
+        writer.write(index, 3);
+    }
+}
+
+//
+// BC1
+//
+
+static u16 pack_565(const glm::vec3& color) {
+    const auto r = (u16)std::lround(color.r * 31.0f / 255.0f);
+    const auto g = (u16)std::lround(color.g * 63.0f / 255.0f);
+    const auto b = (u16)std::lround(color.b * 31.0f / 255.0f);
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+static glm::vec3 unpack_565(u16 color) {
+    const u32 r = (color >> 11) & 31;
+    const u32 g = (color >> 5) & 63;
+    const u32 b = color & 31;
+    return {(f32)((r << 3) | (r >> 2)), (f32)((g << 2) | (g >> 4)), (f32)((b << 3) | (b >> 2))};
+}
+
+// Palette in index order: both endpoints, then the colors a third and two thirds of the way between them
+static std::array<glm::vec3, 4> bc1_palette(u16 first, u16 second) {
+    const glm::vec3 a = unpack_565(first);
+    const glm::vec3 b = unpack_565(second);
+    return {a, b, glm::round((2.0f * a + b) / 3.0f), glm::round((a + 2.0f * b) / 3.0f)};
+}
+
+// Always uses the 4 color mode, which BC3 requires and opaque textures prefer
+static void encode_bc1(const std::array<glm::vec3, BLOCK_PIXELS>& pixels, u8* block) {
+    static constexpr std::array<f32, 4> INDEX_WEIGHTS = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+    auto [low, high] = fit_endpoints<glm::vec3, glm::mat3>(pixels);
+    u16 first = pack_565(high);
+    u16 second = pack_565(low);
+
+    std::array<u8, BLOCK_PIXELS> indices{};
+    f32 error = select_indices(pixels, bc1_palette(first, second), indices);
+
+    // One least squares pass with the indices found, kept only if it lowers the error
+    std::array<f32, BLOCK_PIXELS> weights;
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+        weights[i] = INDEX_WEIGHTS[indices[i]];
+    }
+    glm::vec3 refit_first, refit_second;
+    if (refit_endpoints(pixels, weights, refit_first, refit_second)) {
+        const u16 packed_first = pack_565(refit_first);
+        const u16 packed_second = pack_565(refit_second);
+
+        std::array<u8, BLOCK_PIXELS> refit_indices{};
+        const f32 refit_error = select_indices(pixels, bc1_palette(packed_first, packed_second), refit_indices);
+        if (refit_error < error) {
+            first = packed_first;
+            second = packed_second;
+            indices = refit_indices;
+            error = refit_error;
+        }
+    }
+
+    // The 4 color mode needs the first endpoint larger, swapping them swaps the matching indices
+    if (first < second) {
+        std::swap(first, second);
+        for (auto& index : indices) {
+            index ^= 1;
+        }
+    } else if (first == second) {
+        indices.fill(0);
+    }
+
+    BlockWriter writer(block);
+    writer.write(first, 16);
+    writer.write(second, 16);
+    for (u8 index : indices) {
+        writer.write(index, 2);
+    }
+}
+
+//
+// BC7
+//
+
+static constexpr std::array<u32, 16> BC7_WEIGHTS = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BC7Endpoints {
+    // 7 bit values, the p-bit is the shared eighth bit of every channel
+    glm::uvec4 first, second;
+    u32 first_p, second_p;
+};
+
+static std::array<glm::vec4, 16> bc7_palette(const BC7Endpoints& endpoints) {
+    const glm::uvec4 a = endpoints.first * 2u + endpoints.first_p;
+    const glm::uvec4 b = endpoints.second * 2u + endpoints.second_p;
+
+    std::array<glm::vec4, 16> palette;
+    for (u32 i = 0; i < 16; ++i) {
+        palette[i] = glm::vec4(((64 - BC7_WEIGHTS[i]) * a + BC7_WEIGHTS[i] * b + 32u) >> 6u);
+    }
+    return palette;
+}
+
+static glm::uvec4 bc7_quantize(const glm::vec4& value, u32 p) {
+    return glm::uvec4(glm::clamp(glm::round((value - (f32)p) / 2.0f), 0.0f, 127.0f));
+}
+
+// Tries every p-bit pair for the endpoints and keeps the one with the lowest error
+static f32 bc7_quantize_endpoints(const std::array<glm::vec4, BLOCK_PIXELS>& pixels,
+                                  const glm::vec4& first,
+                                  const glm::vec4& second,
+                                  BC7Endpoints& endpoints,
+                                  std::array<u8, BLOCK_PIXELS>& indices) {
+    f32 best = std::numeric_limits<f32>::max();
+    for (u32 p = 0; p < 4; ++p) {
+        BC7Endpoints candidate;
+        candidate.first_p = p & 1;
+        candidate.second_p = p >> 1;
+        candidate.first = bc7_quantize(first, candidate.first_p);
+        candidate.second = bc7_quantize(second, candidate.second_p);
+
+        std::array<u8, BLOCK_PIXELS> candidate_indices{};
+        const f32 error = select_indices(pixels, bc7_palette(candidate), candidate_indices);
+        if (error < best) {
+            best = error;
+            endpoints = candidate;
+            indices = candidate_indices;
+        }
+    }
+    return best;
+}
+
+// Mode 6: a single subset with 7.7.7.7 endpoints, a p-bit each and 4 bit indices
+static void encode_bc7(const std::array<glm::vec4, BLOCK_PIXELS>& pixels, u8* block) {
+    const auto [low, high] = fit_endpoints<glm::vec4, glm::mat4>(pixels);
+
+    BC7Endpoints endpoints{};
+    std::array<u8, BLOCK_PIXELS> indices{};
+    const f32 error = bc7_quantize_endpoints(pixels, low, high, endpoints, indices);
+
+    std::array<f32, BLOCK_PIXELS> weights;
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+        weights[i] = (f32)BC7_WEIGHTS[indices[i]] / 64.0f;
+    }
+    glm::vec4 refit_low, refit_high;
+    if (refit_endpoints(pixels, weights, refit_low, refit_high)) {
+        BC7Endpoints refit_endpoints_quantized{};
+        std::array<u8, BLOCK_PIXELS> refit_indices{};
+        const f32 refit_error =
+            bc7_quantize_endpoints(pixels, refit_low, refit_high, refit_endpoints_quantized, refit_indices);
+        if (refit_error < error) {
+            endpoints = refit_endpoints_quantized;
+            indices = refit_indices;
+        }
+    }
+
+    // The first index is stored without its top bit, which must be 0
+    if (indices[0] >= 8) {
+        std::swap(endpoints.first, endpoints.second);
+        std::swap(endpoints.first_p, endpoints.second_p);
+        for (auto& index : indices) {
+            index = (u8)(15 - index);
+        }
+    }
+
+    BlockWriter writer(block);
+    writer.write(1u << 6, 7);
+    for (i32 channel = 0; channel < 4; ++channel) {
+        writer.write(endpoints.first[channel], 7);
+        writer.write(endpoints.second[channel], 7);
+    }
+    writer.write(endpoints.first_p, 1);
+    writer.write(endpoints.second_p, 1);
+
+    writer.write(indices[0], 3);
+    for (u32 i = 1; i < BLOCK_PIXELS; ++i) {
+        writer.write(indices[i], 4);
+    }
+}
+
+//
+// Levels
+//
+
+void compress_block_row(TextureFormat format, const u8* pixels, i32 width, i32 height, u32 row, u8* blocks) {
+    const u32 block_size = get_block_size(format);
+    const auto blocks_x = (u32)(width + 3) / 4;
+
+    for (u32 column = 0; column < blocks_x; ++column) {
+        std::array<glm::vec4, BLOCK_PIXELS> block;
+        for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+            const auto x = (usize)std::min((i32)(column * 4 + i % 4), width - 1);
+            const auto y = (usize)std::min((i32)(row * 4 + i / 4), height - 1);
+            const u8* pixel = pixels + (y * (usize)width + x) * 4;
+            block[i] = glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]);
+        }
+
+        u8* output = blocks + column * block_size;
+        std::fill(output, output + block_size, (u8)0);
+
+        std::array<glm::vec3, BLOCK_PIXELS> colors;
+        std::array<f32, BLOCK_PIXELS> channel;
+        switch (format) {
+            case TextureFormat::BC1:
+            case TextureFormat::BC3:
+                for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+                    colors[i] = glm::vec3(block[i]);
+                    channel[i] = block[i].a;
+                }
+                if (format == TextureFormat::BC3) {
+                    encode_bc4(channel, output);
+                    output += 8;
+                }
+                encode_bc1(colors, output);
+                break;
+            case TextureFormat::BC4:
+            case TextureFormat::BC5:
+                for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+                    channel[i] = block[i].r;
+                }
+                encode_bc4(channel, output);
+                if (format == TextureFormat::BC5) {
+                    for (u32 i = 0; i < BLOCK_PIXELS; ++i) {
+                        channel[i] = block[i].g;
+                    }
+                    encode_bc4(channel, output + 8);
+                }
+                break;
+            case TextureFormat::BC7:
+                encode_bc7(block, output);
+                break;
+            case TextureFormat::RGBA8:
+                break;
+        }
+    }
+}
+
+} // namespace Hydrogen
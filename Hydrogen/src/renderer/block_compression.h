@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core.h"
+
+namespace Hydrogen {
+
+// Layout of texture pixels. Block compressed formats store 4x4 pixel blocks of fixed size
+enum class HG_API TextureFormat {
+    RGBA8,
+    // RGB with 5:6:5 endpoints, 4 bits per pixel
+    BC1,
+    // BC1 color with a BC4 alpha, 8 bits per pixel
+    BC3,
+    // Single channel, 4 bits per pixel
+    BC4,
+    // Two BC4 channels, 8 bits per pixel
+    BC5,
+    // RGBA with 7 bit endpoints, 8 bits per pixel
+    BC7
+};
+
+// Families of block compressed formats available for a texture
+struct HG_API BlockFormatSupport {
+    // BC1 and BC3
+    bool s3tc = false;
+    // BC4 and BC5
+    bool rgtc = false;
+    // BC7
+    bool bptc = false;
+
+    bool supports(TextureFormat format) const;
+};
+
+HG_API bool is_block_compressed(TextureFormat format);
+// Bytes of a width x height level, levels smaller than a block still take a whole one
+HG_API u64 get_level_size(TextureFormat format, i32 width, i32 height);
+
+// Encodes one row of 4x4 blocks of an RGBA8 level into blocks. Blocks past the right or bottom edge repeat
+// the last column or row. Rows are independent, so a level can be encoded by several threads at once.
+// BC4 encodes red and BC5 red and green, BC7 only uses its single subset RGBA mode
+HG_API void compress_block_row(TextureFormat format, const u8* pixels, i32 width, i32 height, u32 row, u8* blocks);
+
+} // namespace Hydrogen
@@ -2,6 +2,11 @@
 
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "renderer_api.h"
 
 namespace Hydrogen {
 
@@ -12,8 +17,22 @@ static u32 get_opengl_type(const ShaderType& type) {
     switch (type) {
         case ShaderType::Float32:
             return GL_FLOAT;
+        case ShaderType::Float16:
+            return GL_HALF_FLOAT;
+        case ShaderType::Int:
+            return GL_INT;
         case ShaderType::UnsignedInt:
             return GL_UNSIGNED_INT;
+        case ShaderType::Int16:
+            return GL_SHORT;
+        case ShaderType::UnsignedInt16:
+            return GL_UNSIGNED_SHORT;
+        case ShaderType::Int8:
+            return GL_BYTE;
+        case ShaderType::UnsignedInt8:
+            return GL_UNSIGNED_BYTE;
+        case ShaderType::Int2_10_10_10_Rev:
+            return GL_INT_2_10_10_10_REV;
         case ShaderType::Bool:
             return GL_BOOL;
     }
@@ -23,22 +42,115 @@ static u32 get_opengl_type(const ShaderType& type) {
 static u32 get_type_size(const ShaderType& type) {
     switch (type) {
         case ShaderType::Float32:
+        case ShaderType::Int:
         case ShaderType::UnsignedInt:
             return 4;
+        case ShaderType::Float16:
+        case ShaderType::Int16:
+        case ShaderType::UnsignedInt16:
+            return 2;
+        case ShaderType::Int8:
+        case ShaderType::UnsignedInt8:
         case ShaderType::Bool:
             return 1;
+        case ShaderType::Int2_10_10_10_Rev:
+            // Size of the whole attribute, see get_attribute_size
+            return 4;
     }
     return 0;
 }
 
+static u32 get_attribute_size(const VertexLayout& element) {
+    // Packed types store every component in a single 32 bit value
+    if (element.type == ShaderType::Int2_10_10_10_Rev)
+        return get_type_size(element.type);
+    return element.count * get_type_size(element.type);
+}
+
+static bool is_integer_type(const ShaderType& type) {
+    switch (type) {
+        case ShaderType::Int:
+        case ShaderType::UnsignedInt:
+        case ShaderType::Int16:
+        case ShaderType::UnsignedInt16:
+        case ShaderType::Int8:
+        case ShaderType::UnsignedInt8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static u32 get_opengl_usage(BufferUsage usage) {
+    switch (usage) {
+        case BufferUsage::Static:
+            return GL_STATIC_DRAW;
+        case BufferUsage::Dynamic:
+            return GL_DYNAMIC_DRAW;
+        case BufferUsage::Stream:
+            return GL_STREAM_DRAW;
+    }
+    return 0;
+}
+
+// Moves the contents of a buffer into a new one of a different size
+static void reallocate_buffer(u32& id, u32 old_size, u32 new_size, BufferUsage usage) {
+    u32 new_id;
+    glGenBuffers(1, &new_id);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_size, nullptr, get_opengl_usage(usage));
+
+    glBindBuffer(GL_COPY_READ_BUFFER, id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, std::min(old_size, new_size));
+
+    glDeleteBuffers(1, &id);
+    id = new_id;
+}
+
+// Writes data at offset through the copy target, so the element buffer binding of the bound vertex array
+// is not touched. Storage is respecified on the same buffer name when growing
+static void update_buffer(u32 id, u32& capacity, BufferUsage usage, const void* data, u32 size, u32 offset) {
+    HG_ASSERT(data != nullptr || size == 0, "Buffer update without data");
+
+    const u32 required = offset + size;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+
+    if (offset == 0) {
+        // Orphan the old storage, draws still reading it keep using it until they finish
+        if (required > capacity)
+            capacity = std::max(required, capacity * 2);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, get_opengl_usage(usage));
+    } else if (required > capacity) {
+        // Keep the first offset bytes, staged in a temporary buffer while the storage is respecified
+        const u32 new_capacity = std::max(required, capacity * 2);
+
+        u32 temporary;
+        glGenBuffers(1, &temporary);
+        glBindBuffer(GL_COPY_READ_BUFFER, temporary);
+        glBufferData(GL_COPY_READ_BUFFER, offset, nullptr, GL_STREAM_COPY);
+        glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, offset);
+
+        glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, nullptr, get_opengl_usage(usage));
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, offset);
+        glDeleteBuffers(1, &temporary);
+
+        capacity = new_capacity;
+    }
+
+    if (size > 0)
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
 //
 // Vertex Buffer
 //
-VertexBuffer::VertexBuffer(const void* vertices, u32 size) {
+VertexBuffer::VertexBuffer(const void* vertices, u32 size, BufferUsage usage)
+    : m_usage(usage), m_size(size), m_capacity(size) {
     glGenBuffers(1, &ID);
     bind();
 
-    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices, get_opengl_usage(m_usage));
 }
 
 VertexBuffer::~VertexBuffer() {
@@ -53,34 +165,84 @@ void VertexBuffer::unbind() const {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void VertexBuffer::set_layout(const std::vector<VertexLayout>& layout) const {
+void VertexBuffer::set_layout(const std::vector<VertexLayout>& layout, u32 first_location, u32 offset) const {
     bind();
 
-    u32 generic_stride = 0;
-    for (auto element : layout) {
-        generic_stride += element.count * get_type_size(element.type);
-    }
+    const u32 generic_stride = get_stride(layout);
 
-    u32 stride = 0;
+    u32 stride = offset;
     for (u32 i = 0; i < layout.size(); ++i) {
         auto element = layout[i];
-        glVertexAttribPointer(i, (i32)element.count, get_opengl_type(element.type),
-                              element.normalized ? GL_TRUE : GL_FALSE, generic_stride,
-                              reinterpret_cast<const void*>(stride));
-        glEnableVertexAttribArray(i);
+        const u32 location = first_location + i;
+
+        if (element.integer) {
+            HG_ASSERT(is_integer_type(element.type), "Integer vertex attributes need an integer type");
+            glVertexAttribIPointer(location, (i32)element.count, get_opengl_type(element.type), (i32)generic_stride,
+                                   reinterpret_cast<const void*>(stride));
+        } else {
+            HG_ASSERT(element.type != ShaderType::Int2_10_10_10_Rev || element.count == 4,
+                      "Packed 2_10_10_10 attributes have 4 components");
+            glVertexAttribPointer(location, (i32)element.count, get_opengl_type(element.type),
+                                  element.normalized ? GL_TRUE : GL_FALSE, (i32)generic_stride,
+                                  reinterpret_cast<const void*>(stride));
+        }
+        glVertexAttribDivisor(location, element.divisor);
+        glEnableVertexAttribArray(location);
+
+        stride += get_attribute_size(element);
+    }
+}
+
+void VertexBuffer::set_sub_data(const void* data, u32 size, u32 offset) {
+    HG_ASSERT(offset + size <= m_size, "Vertex buffer write out of bounds");
+
+    bind();
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+}
+
+void VertexBuffer::update(const void* data, u32 size, u32 offset) {
+    HG_ASSERT(offset <= m_size, "Vertex buffer update leaves a gap");
+
+    update_buffer(ID, m_capacity, m_usage, data, size, offset);
+    m_size = offset + size;
+}
 
-        stride += element.count * get_type_size(element.type);
+void VertexBuffer::resize(u32 size) {
+    reallocate_buffer(ID, m_capacity, size, m_usage);
+    m_size = size;
+    m_capacity = size;
+}
+
+u32 VertexBuffer::get_stride(const std::vector<VertexLayout>& layout) {
+    u32 stride = 0;
+    for (const auto& element : layout) {
+        stride += get_attribute_size(element);
     }
+    return stride;
 }
 
 //
 // Index Buffer
 //
-IndexBuffer::IndexBuffer(const u32* indices, u32 number_indices) : m_count(number_indices) {
+static IndexType choose_index_type(const u32* indices, u32 number_indices) {
+    // Storage for dynamic buffers is created empty, so nothing tells how large indices will get
+    if (indices == nullptr || number_indices == 0)
+        return IndexType::UnsignedInt;
+
+    const u32 max_index = *std::max_element(indices, indices + number_indices);
+    return max_index <= std::numeric_limits<u16>::max() ? IndexType::UnsignedShort : IndexType::UnsignedInt;
+}
+
+IndexBuffer::IndexBuffer(const u32* indices, u32 number_indices, BufferUsage usage)
+    : IndexBuffer(indices, number_indices, choose_index_type(indices, number_indices), usage) {}
+
+IndexBuffer::IndexBuffer(const u32* indices, u32 number_indices, IndexType type, BufferUsage usage)
+    : m_type(type), m_usage(usage), m_count(number_indices), m_capacity(number_indices) {
     glGenBuffers(1, &ID);
     bind();
 
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<i32>(number_indices * sizeof(u32)), indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<i32>(number_indices * get_index_size()),
+                 convert_indices(indices, number_indices), get_opengl_usage(m_usage));
 }
 
 IndexBuffer::~IndexBuffer() {
@@ -95,57 +257,251 @@ void IndexBuffer::unbind() const {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+void IndexBuffer::set_sub_data(const u32* indices, u32 number_indices, u32 offset) {
+    HG_ASSERT(offset + number_indices <= m_count, "Index buffer write out of bounds");
+
+    bind();
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset * get_index_size(), number_indices * get_index_size(),
+                    convert_indices(indices, number_indices));
+}
+
+void IndexBuffer::update(const u32* indices, u32 number_indices, u32 offset) {
+    HG_ASSERT(offset <= m_count, "Index buffer update leaves a gap");
+
+    const u32 index_size = get_index_size();
+    u32 capacity = m_capacity * index_size;
+    update_buffer(ID, capacity, m_usage, convert_indices(indices, number_indices), number_indices * index_size,
+                  offset * index_size);
+
+    m_capacity = capacity / index_size;
+    m_count = offset + number_indices;
+}
+
+void IndexBuffer::resize(u32 number_indices) {
+    reallocate_buffer(ID, m_capacity * get_index_size(), number_indices * get_index_size(), m_usage);
+    m_count = number_indices;
+    m_capacity = number_indices;
+}
+
+IndexType IndexBuffer::get_index_type(u32 vertex_count) {
+    return vertex_count <= (u32)std::numeric_limits<u16>::max() + 1 ? IndexType::UnsignedShort
+                                                                     : IndexType::UnsignedInt;
+}
+
+const void* IndexBuffer::convert_indices(const u32* indices, u32 number_indices) const {
+    if (m_type == IndexType::UnsignedInt || indices == nullptr)
+        return indices;
+
+    // Reused between calls, the data is consumed by the GL call that follows
+    static std::vector<u16> narrowed;
+    narrowed.resize(number_indices);
+
+    for (u32 i = 0; i < number_indices; ++i) {
+        HG_ASSERT(indices[i] <= std::numeric_limits<u16>::max(), "Index {} does not fit a 16 bit index buffer",
+                  indices[i]);
+        narrowed[i] = (u16)indices[i];
+    }
+    return narrowed.data();
+}
+
+//
+// Uniform Buffer Layout
+//
+static u32 get_std140_alignment(UniformType type) {
+    switch (type) {
+        case UniformType::Int:
+        case UniformType::Float:
+            return 4;
+        case UniformType::Vec2:
+            return 8;
+        case UniformType::Vec3:
+        case UniformType::Vec4:
+        case UniformType::IVec4:
+        case UniformType::Mat4:
+            return 16;
+    }
+    return 0;
+}
+
+static u32 get_std140_size(UniformType type) {
+    switch (type) {
+        case UniformType::Int:
+        case UniformType::Float:
+            return 4;
+        case UniformType::Vec2:
+            return 8;
+        case UniformType::Vec3:
+            return 12;
+        case UniformType::Vec4:
+        case UniformType::IVec4:
+            return 16;
+        case UniformType::Mat4:
+            return 64;
+    }
+    return 0;
+}
+
+static u32 align_up(u32 value, u32 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformBufferLayout& UniformBufferLayout::add(UniformName name, UniformType type, u32 array_count) {
+    u32 alignment = get_std140_alignment(type);
+    u32 size = get_std140_size(type);
+
+    // Array elements are aligned to a vec4
+    u32 array_stride = 0;
+    if (array_count > 0) {
+        alignment = align_up(alignment, 16);
+        array_stride = align_up(size, 16);
+        size = array_stride * array_count;
+    }
+
+    const u32 offset = align_up(m_size, alignment);
+    add_element(name, offset, array_stride);
+
+    m_size = offset + size;
+    return *this;
+}
+
+void UniformBufferLayout::add_element(UniformName name, u32 offset, u32 array_stride) {
+    HG_ASSERT(find(name) == nullptr, "Uniform block member '{}' added twice", name.name);
+    m_elements.push_back({.hash = name.hash, .offset = offset, .array_stride = array_stride});
+}
+
+const UniformBufferLayout::Element* UniformBufferLayout::find(UniformName name) const {
+    for (const auto& element : m_elements) {
+        if (element.hash == name.hash)
+            return &element;
+    }
+    return nullptr;
+}
+
 //
 // Uniform Buffer
 //
-UniformBuffer::UniformBuffer(u32 size) {
+UniformBuffer::UniformBuffer(u32 size, bool streaming)
+    : ID(0), m_stream(nullptr), m_stream_offset(0), m_staging(size), m_dirty_begin(size), m_dirty_end(0)
+{
+    if (streaming) {
+        m_stream = new StreamBuffer(size);
+        // Initial contents, so the buffer can be bound before the first flush
+        m_stream_offset = m_stream->write(m_staging.data(), size);
+        return;
+    }
+
     glGenBuffers(1, &ID);
 
     bind();
-    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+    // Starts out matching the zeroed staging copy, so writes skipped for being unchanged are still on the GPU
+    glBufferData(GL_UNIFORM_BUFFER, size, m_staging.data(), GL_DYNAMIC_DRAW);
+}
+
+// Blocks are padded to a multiple of a vec4, drivers may report the padded size as the minimum
+UniformBuffer::UniformBuffer(const UniformBufferLayout& layout, bool streaming)
+    : UniformBuffer(align_up(layout.get_size(), 16), streaming)
+{
+    m_layout = layout;
 }
 
 UniformBuffer::~UniformBuffer() {
+    if (m_stream != nullptr) {
+        delete m_stream;
+        return;
+    }
+
+    RendererAPI::forget_buffer(ID);
     glDeleteBuffers(1, &ID);
 }
 
 void UniformBuffer::assign_slot(u32 slot) {
-    if (current_slot == slot)
+    m_slot = slot;
+
+    if (m_stream != nullptr) {
+        RendererAPI::bind_uniform_buffer_range(slot, m_stream->get_id(), m_stream_offset, (u32)m_staging.size());
         return;
+    }
 
-    current_slot = slot;
-    glBindBufferBase(GL_UNIFORM_BUFFER, slot, ID);
+    RendererAPI::bind_uniform_buffer(slot, ID);
 }
 
 void UniformBuffer::bind() const {
-    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_stream != nullptr ? m_stream->get_id() : ID);
 }
 
 void UniformBuffer::unbind() const {
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void UniformBuffer::set_vec3(u32 pos, const glm::vec3& data) {
-    set_data(pos, 16, data);
+void UniformBuffer::set_int(UniformName name, i32 data, u32 index) {
+    set_data(name, index, &data, sizeof(data));
 }
 
-void UniformBuffer::set_vec4(u32 pos, const glm::vec4& data) {
-    set_data(pos, 16, data);
+void UniformBuffer::set_float(UniformName name, f32 data, u32 index) {
+    set_data(name, index, &data, sizeof(data));
 }
 
-void UniformBuffer::set_mat4(u32 pos, const glm::mat4& data) {
-    set_data(pos, sizeof(glm::mat4), data);
+void UniformBuffer::set_vec3(UniformName name, const glm::vec3& data, u32 index) {
+    set_data(name, index, glm::value_ptr(data), sizeof(data));
 }
 
-template <typename T>
-void UniformBuffer::set_data(u32 pos, i32 size, const T& data) {
-    HG_ASSERT(pos < MAX_UNIFORM_POSITIONS, "You can't use more than {} uniform positions", MAX_UNIFORM_POSITIONS);
+void UniformBuffer::set_vec4(UniformName name, const glm::vec4& data, u32 index) {
+    set_data(name, index, glm::value_ptr(data), sizeof(data));
+}
 
-    i32 offset = pos == 0 ? 0 : m_position_offset[pos-1];
-    m_position_offset[pos] = offset + size;
+void UniformBuffer::set_mat4(UniformName name, const glm::mat4& data, u32 index) {
+    set_data(name, index, glm::value_ptr(data), sizeof(data));
+}
+
+void UniformBuffer::update(const void* data, u32 size, u32 offset) {
+    if (size == 0)
+        return;
+
+    HG_ASSERT(offset + size <= m_staging.size(), "Uniform buffer update out of bounds");
 
-    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, glm::value_ptr(data));
+    // Unchanged data does not need to be uploaded again
+    u8* destination = m_staging.data() + offset;
+    if (std::memcmp(destination, data, size) == 0)
+        return;
+
+    std::memcpy(destination, data, size);
+    m_dirty_begin = std::min(m_dirty_begin, offset);
+    m_dirty_end = std::max(m_dirty_end, offset + size);
 }
 
+void UniformBuffer::flush() {
+    if (m_dirty_begin >= m_dirty_end)
+        return;
+
+    if (m_stream != nullptr) {
+        // Draws issued since the last flush read the previous range, the new data goes to the next segment
+        m_stream->fence();
+        m_stream_offset = m_stream->write(m_staging.data(), (u32)m_staging.size());
+
+        m_dirty_begin = (u32)m_staging.size();
+        m_dirty_end = 0;
+
+        if (m_slot.has_value())
+            assign_slot(m_slot.value());
+        return;
+    }
+
+    bind();
+    glBufferSubData(GL_UNIFORM_BUFFER, m_dirty_begin, m_dirty_end - m_dirty_begin, m_staging.data() + m_dirty_begin);
+
+    m_dirty_begin = (u32)m_staging.size();
+    m_dirty_end = 0;
+}
+
+void UniformBuffer::set_data(UniformName name, u32 index, const void* data, u32 size) {
+    const auto* element = m_layout.find(name);
+    if (element == nullptr) {
+        HG_LOG_WARN("Uniform block member '{}' not found", name.name);
+        return;
+    }
+
+    HG_ASSERT(index == 0 || element->array_stride > 0, "Uniform block member '{}' is not an array", name.name);
+    update(data, size, element->offset + index * element->array_stride);
+}
 
-} // namespace renderer
\ No newline at end of file
+} // namespace Hydrogen
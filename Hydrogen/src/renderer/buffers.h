@@ -3,17 +3,49 @@
 #include "core.h"
 
 #include <glm/glm.hpp>
-#include <array>
+#include <vector>
+
+#include "uniform_name.h"
+#include "stream_buffer.h"
 
 namespace Hydrogen {
 
 // Attribute Data
-enum class HG_API ShaderType { Float32, UnsignedInt, Bool };
+enum class HG_API ShaderType {
+    Float32,
+    Float16,
+    Int,
+    UnsignedInt,
+    Int16,
+    UnsignedInt16,
+    Int8,
+    UnsignedInt8,
+    // Four components packed in 32 bits, x in the lowest 10 bits and w in the highest 2
+    Int2_10_10_10_Rev,
+    Bool
+};
 
 struct HG_API VertexLayout {
     ShaderType type;
     u32 count;
+    // Integer types are mapped to [-1, 1] or [0, 1] instead of being converted as they are
     bool normalized;
+    // 0 advances the attribute every vertex, N advances it every N instances
+    u32 divisor = 0;
+    // Integer types are read as ivec or uvec by the shader, without conversion to float
+    bool integer = false;
+
+    bool operator==(const VertexLayout& other) const = default;
+};
+
+// How often the contents of a buffer are expected to change
+enum class HG_API BufferUsage {
+    // Uploaded once, like mesh geometry
+    Static,
+    // Updated now and then and drawn many times
+    Dynamic,
+    // Rewritten every frame, like debug lines or particles
+    Stream,
 };
 
 //
@@ -21,42 +53,111 @@ struct HG_API VertexLayout {
 //
 class HG_API VertexBuffer {
   public:
-    VertexBuffer(const void* vertices, u32 size);
+    VertexBuffer(const void* vertices, u32 size, BufferUsage usage = BufferUsage::Static);
     ~VertexBuffer();
 
     void bind() const;
     void unbind() const;
 
-    void set_layout(const std::vector<VertexLayout>& layout) const;
+    void set_layout(const std::vector<VertexLayout>& layout, u32 first_location = 0, u32 offset = 0) const;
+    void set_sub_data(const void* data, u32 size, u32 offset);
+    // Replaces the contents from offset on, the buffer ends up holding offset + size bytes.
+    // Writing from offset 0 orphans the storage so the driver does not wait for draws still reading it,
+    // the capacity grows geometrically and keeps the buffer name, so attribute pointers stay valid
+    void update(const void* data, u32 size, u32 offset = 0);
+    // Reallocates the buffer keeping its contents, the vertex array has to set the layout again
+    void resize(u32 size);
+
+    u32 get_size() const { return m_size; }
+    u32 get_capacity() const { return m_capacity; }
+    static u32 get_stride(const std::vector<VertexLayout>& layout);
 
   private:
     u32 ID;
+    BufferUsage m_usage;
+    u32 m_size;
+    u32 m_capacity;
 };
 
 //
 // Index Buffer
 //
+enum class HG_API IndexType { UnsignedShort, UnsignedInt };
+
+// Indices are always passed as u32 and narrowed when the buffer stores 16 bit indices
 class HG_API IndexBuffer {
   public:
-    IndexBuffer(const u32* indices, u32 number_indices);
+    // Stores 16 bit indices when every index fits in them
+    IndexBuffer(const u32* indices, u32 number_indices, BufferUsage usage = BufferUsage::Static);
+    IndexBuffer(const u32* indices, u32 number_indices, IndexType type, BufferUsage usage = BufferUsage::Static);
     ~IndexBuffer();
 
     void bind() const;
     void unbind() const;
 
+    // The owning vertex array must be bound
+    void set_sub_data(const u32* indices, u32 number_indices, u32 offset);
+    // Same as VertexBuffer::update, counted in indices. No vertex array has to be bound
+    void update(const u32* indices, u32 number_indices, u32 offset = 0);
+    // Reallocates the buffer keeping its contents, the vertex array has to bind it again
+    void resize(u32 number_indices);
+
     u32 get_count() const { return m_count; }
+    u32 get_capacity() const { return m_capacity; }
+    IndexType get_type() const { return m_type; }
+    u32 get_index_size() const { return m_type == IndexType::UnsignedShort ? 2 : 4; }
+
+    // Smallest index type that can address vertex_count vertices
+    static IndexType get_index_type(u32 vertex_count);
 
   private:
     u32 ID;
+    IndexType m_type;
+    BufferUsage m_usage;
     u32 m_count;
+    u32 m_capacity;
+
+    const void* convert_indices(const u32* indices, u32 number_indices) const;
 };
 
 //
 // Uniform Buffer
 //
+enum class HG_API UniformType { Int, Float, Vec2, Vec3, Vec4, IVec4, Mat4 };
+
+// Offsets of the members of a uniform block, either following std140 rules or queried from a linked shader
+class HG_API UniformBufferLayout {
+  public:
+    struct Element {
+        u32 hash;
+        u32 offset;
+        // Distance between array elements, 0 if the member is not an array
+        u32 array_stride;
+    };
+
+    UniformBufferLayout() = default;
+
+    // Appends a member using std140 alignment rules
+    UniformBufferLayout& add(UniformName name, UniformType type, u32 array_count = 0);
+    // Adds a member at a known offset, used when reflecting shaders
+    void add_element(UniformName name, u32 offset, u32 array_stride);
+    void set_size(u32 size) { m_size = size; }
+
+    const Element* find(UniformName name) const;
+    u32 get_size() const { return m_size; }
+
+  private:
+    std::vector<Element> m_elements;
+    u32 m_size = 0;
+};
+
+// Writes go into a CPU side copy of the buffer and flush() uploads the modified range in a single call.
+// Streaming buffers are rewritten every frame, each flush copies the whole block into a new range of a
+// StreamBuffer instead of updating storage the GPU may still be reading.
 class HG_API UniformBuffer {
   public:
-    UniformBuffer(u32 size);
+    UniformBuffer(u32 size, bool streaming = false);
+    UniformBuffer(const UniformBufferLayout& layout, bool streaming = false);
     ~UniformBuffer();
 
     void assign_slot(u32 slot);
@@ -64,19 +165,30 @@ class HG_API UniformBuffer {
     void bind() const;
     void unbind() const;
 
-    void set_vec3(u32 pos, const glm::vec3& data);
-    void set_vec4(u32 pos, const glm::vec4& data);
-    void set_mat4(u32 pos, const glm::mat4& data);
+    void set_int(UniformName name, i32 data, u32 index = 0);
+    void set_float(UniformName name, f32 data, u32 index = 0);
+    void set_vec3(UniformName name, const glm::vec3& data, u32 index = 0);
+    void set_vec4(UniformName name, const glm::vec4& data, u32 index = 0);
+    void set_mat4(UniformName name, const glm::mat4& data, u32 index = 0);
+
+    // Copies raw data, for blocks mirrored by a std140 struct
+    void update(const void* data, u32 size, u32 offset = 0);
+    void flush();
 
   private:
     u32 ID;
-    u32 current_slot;
+    UniformBufferLayout m_layout;
+
+    StreamBuffer* m_stream;
+    u32 m_stream_offset;
+    // Slot the buffer was last assigned to, rebound when a flush moves the data
+    std::optional<u32> m_slot;
 
-    #define MAX_UNIFORM_POSITIONS 10
-    std::array<i32, MAX_UNIFORM_POSITIONS> m_position_offset;
+    std::vector<u8> m_staging;
+    u32 m_dirty_begin;
+    u32 m_dirty_end;
 
-    template <typename T>
-    void set_data(u32 pos, i32 size, const T& data);
+    void set_data(UniformName name, u32 index, const void* data, u32 size);
 };
 
-} // namespace Hydrogen
\ No newline at end of file
+} // namespace Hydrogen
@@ -20,7 +20,7 @@ namespace Hydrogen {
 
 Cubemap::Cubemap(bool is_mipmap) {
     glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Cubemap, ID);
 
     i32 min_filter = is_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
 
@@ -50,7 +50,7 @@ Cubemap::Cubemap(const f32* data, u32 width, u32 height) : Cubemap(false) {
 }
 
 Cubemap::Cubemap(const Components& faces, bool flip) : Cubemap() {
-    stbi_set_flip_vertically_on_load(flip);
+    stbi_set_flip_vertically_on_load_thread(flip);
 
     load_face_path(faces.right, GL_TEXTURE_CUBE_MAP_POSITIVE_X);
     load_face_path(faces.left, GL_TEXTURE_CUBE_MAP_NEGATIVE_X);
@@ -59,12 +59,12 @@ Cubemap::Cubemap(const Components& faces, bool flip) : Cubemap() {
     load_face_path(faces.front, GL_TEXTURE_CUBE_MAP_POSITIVE_Z);
     load_face_path(faces.back, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Cubemap, 0);
 }
 
 Cubemap::Cubemap(const std::string& equirectangular_image_path, bool flip) : Cubemap() {
     // Load image
-    stbi_set_flip_vertically_on_load(flip);
+    stbi_set_flip_vertically_on_load_thread(flip);
 
     i32 width, height, components;
     f32* data = stbi_loadf(equirectangular_image_path.c_str(), &width, &height, &components, 0);
@@ -135,6 +135,7 @@ Cubemap::Cubemap(const std::string& equirectangular_image_path, bool flip) : Cub
 }
 
 Cubemap::~Cubemap() {
+    RendererAPI::forget_texture(ID);
     glDeleteTextures(1, &ID);
 }
 
@@ -147,14 +148,13 @@ void Cubemap::attach_to_framebuffer(Framebuffer::AttachmentType attachment_type,
     glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, m_current_framebuffer_face, ID, (i32)level);
 }
 
-void Cubemap::bind(const std::string& name, Shader* shader, u32 slot) const {
+void Cubemap::bind(UniformName name, Shader* shader, u32 slot) const {
     shader->set_uniform_int(name, (i32)slot);
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Cubemap, slot, ID);
 }
 
 void Cubemap::unbind() const {
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Cubemap, 0);
 }
 
 void Cubemap::load_face_path(const std::string& path, u32 face) const {
@@ -3,12 +3,10 @@
 #include "core.h"
 
 #include "framebuffer.h"
+#include "shader.h"
 
 namespace Hydrogen {
 
-// Forward declaration
-class Shader;
-
 class HG_API Cubemap : public IFramebufferAttachable {
   public:
     struct Components {
@@ -31,7 +29,7 @@ class HG_API Cubemap : public IFramebufferAttachable {
     void attach_to_framebuffer(Framebuffer::AttachmentType attachment_type,
                                u32 level) const override;
 
-    void bind(const std::string& name, Shader* shader, u32 slot) const;
+    void bind(UniformName name, Shader* shader, u32 slot) const;
     void unbind() const;
 
   private:
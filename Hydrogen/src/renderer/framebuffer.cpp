@@ -2,6 +2,8 @@
 
 #include <glad/glad.h>
 
+#include "renderer_api.h"
+
 namespace Hydrogen {
 
 Framebuffer::Framebuffer() {
@@ -10,15 +12,16 @@ Framebuffer::Framebuffer() {
 }
 
 Framebuffer::~Framebuffer() {
+    RendererAPI::forget_framebuffer(ID);
     glDeleteFramebuffers(1, &ID);
 }
 
 void Framebuffer::bind() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, ID);
+    RendererAPI::bind_framebuffer(ID);
 }
 
 void Framebuffer::unbind() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RendererAPI::bind_framebuffer(0);
 }
 
 void Framebuffer::attach(const IFramebufferAttachable& attachable,
@@ -0,0 +1,148 @@
+#include "geometry_pool.h"
+
+#include <algorithm>
+
+namespace Hydrogen {
+
+#define GEOMETRY_POOL_INITIAL_VERTICES (1u << 16)
+#define GEOMETRY_POOL_INITIAL_INDICES (1u << 18)
+
+GeometryPool::GeometryPool(const std::vector<VertexStream>& streams, IndexType index_type)
+    : m_streams(streams),
+      m_index_type(index_type),
+      m_vertex_allocator(GEOMETRY_POOL_INITIAL_VERTICES),
+      m_index_allocator(GEOMETRY_POOL_INITIAL_INDICES)
+{
+    HG_ASSERT(!m_streams.empty(), "Geometry pool needs at least one vertex stream");
+
+    m_vertex_array = new VertexArray();
+    m_position_vertex_array = m_streams.size() > 1 ? new VertexArray(false) : m_vertex_array;
+
+    for (const auto& stream : m_streams) {
+        const u32 vertex_size = VertexBuffer::get_stride(stream);
+        m_vertex_sizes.push_back(vertex_size);
+
+        auto* vbo = new VertexBuffer(nullptr, GEOMETRY_POOL_INITIAL_VERTICES * vertex_size);
+        m_vertex_buffers.push_back(vbo);
+        m_vertex_array->add_vertex_buffer(vbo);
+    }
+
+    m_index_buffer = new IndexBuffer(nullptr, GEOMETRY_POOL_INITIAL_INDICES, m_index_type);
+    m_vertex_array->set_index_buffer(m_index_buffer);
+
+    if (m_position_vertex_array != m_vertex_array) {
+        m_position_vertex_array->add_vertex_buffer(m_vertex_buffers[0]);
+        m_position_vertex_array->set_index_buffer(m_index_buffer);
+    }
+
+    set_layouts();
+}
+
+GeometryPool::~GeometryPool() {
+    // The position vertex array only references the buffers, the main one owns them
+    if (m_position_vertex_array != m_vertex_array)
+        delete m_position_vertex_array;
+    delete m_vertex_array;
+}
+
+GeometryAllocation GeometryPool::allocate(std::span<const void* const> stream_vertices,
+                                          u32 vertex_count,
+                                          const u32* indices,
+                                          u32 index_count) {
+    HG_ASSERT(stream_vertices.size() == m_streams.size(), "Expected {} vertex streams, got {}", m_streams.size(),
+              stream_vertices.size());
+
+    GeometryAllocation allocation{
+        .first_vertex = allocate_vertices(vertex_count),
+        .vertex_count = vertex_count,
+        .first_index = allocate_indices(index_count),
+        .index_count = index_count,
+    };
+
+    for (u32 i = 0; i < m_vertex_buffers.size(); ++i) {
+        const u32 vertex_size = m_vertex_sizes[i];
+        m_vertex_buffers[i]->set_sub_data(
+            stream_vertices[i], vertex_count * vertex_size, allocation.first_vertex * vertex_size);
+    }
+
+    m_vertex_array->bind();
+    m_index_buffer->set_sub_data(indices, index_count, allocation.first_index);
+    m_vertex_array->unbind();
+
+    return allocation;
+}
+
+void GeometryPool::free(const GeometryAllocation& allocation) {
+    m_vertex_allocator.free(allocation.first_vertex, allocation.vertex_count);
+    m_index_allocator.free(allocation.first_index, allocation.index_count);
+}
+
+u32 GeometryPool::allocate_vertices(u32 vertex_count) {
+    // Empty meshes get an empty range, which free() ignores and the renderer never draws
+    if (vertex_count == 0)
+        return 0;
+
+    auto offset = m_vertex_allocator.allocate(vertex_count);
+    if (offset.has_value())
+        return offset.value();
+
+    // Grow geometrically so loading many meshes only copies the buffer a few times
+    const u32 capacity = std::max(m_vertex_allocator.get_capacity() * 2, m_vertex_allocator.get_capacity() + vertex_count);
+    HG_LOG_INFO("Growing geometry pool vertex buffer to {} vertices", capacity);
+
+    for (u32 i = 0; i < m_vertex_buffers.size(); ++i) {
+        m_vertex_buffers[i]->resize(capacity * m_vertex_sizes[i]);
+    }
+    m_vertex_allocator.grow(capacity);
+
+    // Attribute pointers still reference the old buffers
+    set_layouts();
+
+    return m_vertex_allocator.allocate(vertex_count).value();
+}
+
+u32 GeometryPool::allocate_indices(u32 index_count) {
+    // Empty meshes get an empty range, which free() ignores and the renderer never draws
+    if (index_count == 0)
+        return 0;
+
+    auto offset = m_index_allocator.allocate(index_count);
+    if (offset.has_value())
+        return offset.value();
+
+    const u32 capacity = std::max(m_index_allocator.get_capacity() * 2, m_index_allocator.get_capacity() + index_count);
+    HG_LOG_INFO("Growing geometry pool index buffer to {} indices", capacity);
+
+    m_index_buffer->resize(capacity);
+    m_index_allocator.grow(capacity);
+
+    // The element buffer binding is part of the vertex array state
+    for (const auto* vao : {m_vertex_array, m_position_vertex_array}) {
+        vao->bind();
+        m_index_buffer->bind();
+    }
+    m_vertex_array->unbind();
+
+    return m_index_allocator.allocate(index_count).value();
+}
+
+void GeometryPool::set_layouts() const {
+    m_vertex_array->bind();
+    m_index_buffer->bind();
+
+    u32 location = 0;
+    for (u32 i = 0; i < m_streams.size(); ++i) {
+        m_vertex_buffers[i]->set_layout(m_streams[i], location);
+        location += (u32)m_streams[i].size();
+    }
+
+    if (m_position_vertex_array != m_vertex_array) {
+        m_position_vertex_array->bind();
+        m_index_buffer->bind();
+        m_vertex_buffers[0]->set_layout(m_streams[0]);
+    }
+
+    m_vertex_array->unbind();
+}
+
+} // namespace Hydrogen
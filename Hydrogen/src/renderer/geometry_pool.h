@@ -0,0 +1,74 @@
+#pragma once
+
+#include "core.h"
+
+#include <span>
+#include <vector>
+
+#include "renderer/vertex_array.h"
+#include "renderer/buffers.h"
+#include "core/range_allocator.h"
+
+namespace Hydrogen {
+
+struct HG_API GeometryAllocation {
+    u32 first_vertex = 0;
+    u32 vertex_count = 0;
+    u32 first_index = 0;
+    u32 index_count = 0;
+
+    DrawRange get_draw_range() const {
+        return DrawRange{.first_index = first_index, .index_count = index_count, .base_vertex = (i32)first_vertex};
+    }
+};
+
+// Attributes stored together in one vertex buffer of a pool
+typedef std::vector<VertexLayout> VertexStream;
+
+// Shared vertex and index buffers for meshes with the same vertex streams and index type. Meshes get ranges
+// of the buffers and are drawn with base vertex draws, so they do not need to switch vertex arrays.
+// Indices are relative to the first vertex of each mesh, so 16 bit pools hold any number of meshes
+// as long as each one has at most 65536 vertices.
+//
+// Each stream lives in its own vertex buffer and takes the attribute locations following the previous one.
+// Keeping positions in the first stream lets depth only passes fetch nothing else.
+class HG_API GeometryPool {
+  public:
+    GeometryPool(const std::vector<VertexStream>& streams, IndexType index_type);
+    ~GeometryPool();
+
+    // stream_vertices[i] holds vertex_count vertices of stream i.
+    // Indices are relative to the first vertex of the allocation
+    GeometryAllocation allocate(std::span<const void* const> stream_vertices,
+                                u32 vertex_count,
+                                const u32* indices,
+                                u32 index_count);
+    void free(const GeometryAllocation& allocation);
+
+    const VertexArray* get_vertex_array() const { return m_vertex_array; }
+    // Reads only the first stream, the same vertex array as get_vertex_array() for single stream pools
+    const VertexArray* get_position_vertex_array() const { return m_position_vertex_array; }
+
+    const std::vector<VertexStream>& get_streams() const { return m_streams; }
+    IndexType get_index_type() const { return m_index_type; }
+
+  private:
+    std::vector<VertexStream> m_streams;
+    std::vector<u32> m_vertex_sizes;
+    IndexType m_index_type;
+
+    VertexArray* m_vertex_array;
+    VertexArray* m_position_vertex_array;
+    std::vector<VertexBuffer*> m_vertex_buffers;
+    IndexBuffer* m_index_buffer;
+
+    RangeAllocator m_vertex_allocator;
+    RangeAllocator m_index_allocator;
+
+    u32 allocate_vertices(u32 vertex_count);
+    u32 allocate_indices(u32 index_count);
+
+    void set_layouts() const;
+};
+
+} // namespace Hydrogen
@@ -0,0 +1,302 @@
+#include "image.h"
+
+#include <array>
+#include <cmath>
+#include <filesystem>
+
+#include <glm/glm.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "core/mapped_file.h"
+#include "renderer/texture_container.h"
+#include "systems/job_system.h"
+
+namespace Hydrogen {
+
+// Gamma the shaders decode color textures with
+#define IMAGE_COLOR_GAMMA 2.2f
+
+Image::Image(const std::string& path, TextureUsage usage, bool flip_vertically) {
+    HG_ASSERT(std::filesystem::exists(path), "Could not open " + path);
+
+    if (is_texture_container(path)) {
+        load_container(path, usage, flip_vertically);
+        return;
+    }
+
+    // The flag is per thread, images decoded at the same time do not interfere
+    stbi_set_flip_vertically_on_load_thread(flip_vertically);
+    u8* pixels = stbi_load(path.c_str(), &m_width, &m_height, &m_channels, 4);
+
+    if (pixels == nullptr) {
+        HG_LOG_ERROR("Could not decode image {}: {}", path, stbi_failure_reason());
+        return;
+    }
+
+    analyze(pixels);
+    generate_mips(pixels, usage);
+    stbi_image_free(pixels);
+}
+
+Image::~Image() = default;
+
+void Image::load_container(const std::string& path, TextureUsage usage, bool flip_vertically) {
+    const MappedFile file(path);
+    if (!file.is_valid()) {
+        HG_LOG_ERROR("Could not read {}", path);
+        return;
+    }
+
+    const auto container = read_texture_container(file.get_bytes(), path);
+    if (!container.has_value())
+        return;
+
+    // Block data cannot be flipped cheaply, containers are baked with the row order the engine samples in
+    if (container->bottom_row_first.has_value() && *container->bottom_row_first != flip_vertically)
+        HG_LOG_WARN("{} stores its rows in the opposite order than requested, uploading it as stored", path);
+
+    m_width = container->width;
+    m_height = container->height;
+    m_format = container->format;
+    m_channels = m_format == TextureFormat::BC4 ? 1 : m_format == TextureFormat::BC5 ? 2 : 4;
+
+    for (const auto& level : container->levels) {
+        m_level_offsets.push_back(m_data.size());
+        m_data.insert(m_data.end(), level.begin(), level.end());
+    }
+
+    if (m_format != TextureFormat::RGBA8)
+        return;
+
+    if (container->swap_red_blue) {
+        for (usize i = 0; i < m_data.size(); i += 4) {
+            std::swap(m_data[i], m_data[i + 2]);
+        }
+    }
+
+    analyze(get_pixels(0));
+
+    // Uncompressed files without mips get them like decoded images
+    if (get_level_count() == 1) {
+        const std::vector<u8> pixels = std::move(m_data);
+        m_data.clear();
+        m_level_offsets.clear();
+        generate_mips(pixels.data(), usage);
+    }
+}
+
+void Image::drop_levels(u32 count) {
+    count = std::min(count, get_level_count() > 0 ? get_level_count() - 1 : 0);
+    if (count == 0)
+        return;
+
+    const usize start = m_level_offsets[count];
+    m_data.erase(m_data.begin(), m_data.begin() + (i64)start);
+    m_level_offsets.erase(m_level_offsets.begin(), m_level_offsets.begin() + count);
+    for (auto& offset : m_level_offsets) {
+        offset -= start;
+    }
+
+    m_width = get_width(count);
+    m_height = get_height(count);
+}
+
+void Image::analyze(const u8* pixels) {
+    const usize pixel_count = (usize)m_width * (usize)m_height;
+    for (usize i = 0; i < pixel_count; ++i) {
+        const u8* pixel = pixels + i * 4;
+        m_has_alpha = m_has_alpha || pixel[3] != 255;
+        m_is_grayscale = m_is_grayscale && pixel[0] == pixel[1] && pixel[1] == pixel[2];
+    }
+}
+
+TextureFormat Image::choose_format(TextureUsage usage, const BlockFormatSupport& support) const {
+    switch (usage) {
+        case TextureUsage::Color:
+            if (!m_has_alpha && support.s3tc)
+                return TextureFormat::BC1;
+            if (support.bptc)
+                return TextureFormat::BC7;
+            return support.s3tc ? TextureFormat::BC3 : TextureFormat::RGBA8;
+        case TextureUsage::Normal:
+            // Z is rebuilt from X and Y by the shaders
+            return support.rgtc ? TextureFormat::BC5 : TextureFormat::RGBA8;
+        case TextureUsage::Data:
+            if (m_is_grayscale && support.rgtc)
+                return TextureFormat::BC4;
+            // Packed channels such as occlusion, roughness and metallic are not correlated like colors,
+            // which BC7 handles better than BC1
+            if (support.bptc)
+                return TextureFormat::BC7;
+            return support.s3tc ? TextureFormat::BC1 : TextureFormat::RGBA8;
+    }
+    return TextureFormat::RGBA8;
+}
+
+void Image::compress(TextureFormat format) {
+    HG_ASSERT(m_format == TextureFormat::RGBA8, "Image is already compressed");
+    if (!is_valid() || !is_block_compressed(format))
+        return;
+
+    std::vector<usize> offsets;
+    usize size = 0;
+    for (u32 level = 0; level < get_level_count(); ++level) {
+        offsets.push_back(size);
+        size += get_level_size(format, get_width(level), get_height(level));
+    }
+    std::vector<u8> blocks(size);
+
+    for (u32 level = 0; level < get_level_count(); ++level) {
+        const i32 width = get_width(level);
+        const i32 height = get_height(level);
+        const u64 row_size = get_level_size(format, width, 4);
+        const auto rows = (u32)(height + 3) / 4;
+
+        u8* level_blocks = blocks.data() + offsets[level];
+        const u8* pixels = get_pixels(level);
+        JobSystem::instance->parallel_for(rows, [&](u32 row) {
+            compress_block_row(format, pixels, width, height, row, level_blocks + (usize)row * row_size);
+        });
+    }
+
+    m_data = std::move(blocks);
+    m_level_offsets = std::move(offsets);
+    m_format = format;
+}
+
+//
+// Mip generation
+//
+
+// Source pixel covered by a destination pixel along one axis, weight is the covered fraction
+struct MipTap {
+    i32 index;
+    f32 weight;
+};
+
+struct MipFootprint {
+    // Odd sizes make a destination pixel cover parts of up to 4 source pixels
+    std::array<MipTap, 4> taps;
+    u32 count = 0;
+};
+
+// Box filter footprints, exact for odd sizes instead of dropping the last row or column
+static std::vector<MipFootprint> compute_footprints(i32 source_size, i32 size) {
+    std::vector<MipFootprint> footprints((usize)size);
+    const f64 scale = (f64)source_size / (f64)size;
+
+    for (i32 i = 0; i < size; ++i) {
+        const f64 start = i * scale;
+        const f64 end = (i + 1) * scale;
+
+        auto& footprint = footprints[(usize)i];
+        for (i32 j = (i32)start; j < source_size && j < end; ++j) {
+            const f64 covered = std::min(end, (f64)(j + 1)) - std::max(start, (f64)j);
+            if (covered > 0.0 && footprint.count < footprint.taps.size())
+                footprint.taps[footprint.count++] = MipTap{j, (f32)(covered / scale)};
+        }
+    }
+    return footprints;
+}
+
+static const std::array<f32, 256>& get_color_decode_table() {
+    static const std::array<f32, 256> table = []() {
+        std::array<f32, 256> values{};
+        for (u32 i = 0; i < values.size(); ++i) {
+            values[i] = std::pow((f32)i / 255.0f, IMAGE_COLOR_GAMMA);
+        }
+        return values;
+    }();
+    return table;
+}
+
+static glm::vec4 decode_texel(const u8* texel, TextureUsage usage) {
+    const glm::vec4 value = glm::vec4(texel[0], texel[1], texel[2], texel[3]) / 255.0f;
+
+    switch (usage) {
+        case TextureUsage::Color: {
+            const auto& table = get_color_decode_table();
+            return {table[texel[0]], table[texel[1]], table[texel[2]], value.a};
+        }
+        case TextureUsage::Normal:
+            return {glm::vec3(value) * 2.0f - 1.0f, value.a};
+        case TextureUsage::Data:
+            return value;
+    }
+    return value;
+}
+
+static void encode_texel(glm::vec4 value, TextureUsage usage, u8* texel) {
+    switch (usage) {
+        case TextureUsage::Color:
+            value = glm::vec4(glm::pow(glm::vec3(value), glm::vec3(1.0f / IMAGE_COLOR_GAMMA)), value.a);
+            break;
+        case TextureUsage::Normal: {
+            // Averaged normals get shorter where they diverge
+            const glm::vec3 normal = glm::length(glm::vec3(value)) > 1e-6f ? glm::normalize(glm::vec3(value))
+                                                                           : glm::vec3(0.0f, 0.0f, 1.0f);
+            value = glm::vec4(normal * 0.5f + 0.5f, value.a);
+            break;
+        }
+        case TextureUsage::Data:
+            break;
+    }
+
+    for (u32 channel = 0; channel < 4; ++channel) {
+        texel[channel] = (u8)std::lround(std::clamp(value[(i32)channel], 0.0f, 1.0f) * 255.0f);
+    }
+}
+
+static void downsample(const u8* source,
+                       i32 source_width,
+                       i32 source_height,
+                       u8* destination,
+                       i32 width,
+                       i32 height,
+                       TextureUsage usage) {
+    const auto columns = compute_footprints(source_width, width);
+    const auto rows = compute_footprints(source_height, height);
+
+    for (i32 y = 0; y < height; ++y) {
+        const auto& row = rows[(usize)y];
+
+        for (i32 x = 0; x < width; ++x) {
+            const auto& column = columns[(usize)x];
+
+            glm::vec4 sum(0.0f);
+            for (u32 i = 0; i < row.count; ++i) {
+                for (u32 j = 0; j < column.count; ++j) {
+                    const usize texel = (usize)row.taps[i].index * (usize)source_width + (usize)column.taps[j].index;
+                    sum += row.taps[i].weight * column.taps[j].weight * decode_texel(source + texel * 4, usage);
+                }
+            }
+
+            encode_texel(sum, usage, destination + ((usize)y * (usize)width + (usize)x) * 4);
+        }
+    }
+}
+
+void Image::generate_mips(const u8* pixels, TextureUsage usage) {
+    usize size = 0;
+    for (u32 level = 0; level == 0 || (m_width >> level) > 0 || (m_height >> level) > 0; ++level) {
+        m_level_offsets.push_back(size);
+        size += get_size(level);
+    }
+    m_data.resize(size);
+    std::copy(pixels, pixels + get_size(0), m_data.begin());
+
+    // Each level is filtered from the previous one, which is cheap and close to filtering the full image
+    for (u32 level = 1; level < get_level_count(); ++level) {
+        downsample(get_pixels(level - 1),
+                   get_width(level - 1),
+                   get_height(level - 1),
+                   m_data.data() + m_level_offsets[level],
+                   get_width(level),
+                   get_height(level),
+                   usage);
+    }
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "renderer/block_compression.h"
+
+namespace Hydrogen {
+
+// What the pixels of a texture hold, decides how its mip levels are filtered
+enum class HG_API TextureUsage {
+    // Colors encoded with the gamma the shaders decode, averaged in linear space
+    Color,
+    // Tangent space normals, renormalized after averaging
+    Normal,
+    // Linear values such as metallic, roughness or occlusion
+    Data
+};
+
+// Image file decoded to RGBA8 pixels with its full mip chain, optionally block compressed afterwards.
+// KTX2 and DDS files are read instead with the levels and format they were baked with. Nothing here touches
+// GL state, so images can be loaded on any thread and uploaded later with the Texture constructor
+class HG_API Image {
+  public:
+    explicit Image(const std::string& path, TextureUsage usage = TextureUsage::Color, bool flip_vertically = true);
+    ~Image();
+
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+
+    // False if the file could not be decoded
+    bool is_valid() const { return !m_level_offsets.empty(); }
+
+    // Replaces every level with its blocks in format, on the job system
+    void compress(TextureFormat format);
+    // Removes the count largest levels, keeping at least the smallest one
+    void drop_levels(u32 count);
+    // Compressed format for the usage and contents of the image among the supported ones, RGBA8 if none fits
+    TextureFormat choose_format(TextureUsage usage, const BlockFormatSupport& support) const;
+
+    TextureFormat get_format() const { return m_format; }
+
+    // Level 0 is the image itself, every level halves the size of the previous one down to 1x1
+    u32 get_level_count() const { return (u32)m_level_offsets.size(); }
+    const u8* get_pixels(u32 level = 0) const { return m_data.data() + m_level_offsets[level]; }
+    i32 get_width(u32 level = 0) const { return std::max(m_width >> level, 1); }
+    i32 get_height(u32 level = 0) const { return std::max(m_height >> level, 1); }
+    // Bytes of a single level, and of every level together
+    u32 get_size(u32 level) const { return (u32)get_level_size(m_format, get_width(level), get_height(level)); }
+    u32 get_total_size() const { return (u32)m_data.size(); }
+    // Channels in the file, pixels always have 4
+    i32 get_channels() const { return m_channels; }
+
+  private:
+    i32 m_width = 0;
+    i32 m_height = 0;
+    i32 m_channels = 0;
+    TextureFormat m_format = TextureFormat::RGBA8;
+
+    // Found while decoding, they decide the compressed format
+    bool m_has_alpha = false;
+    bool m_is_grayscale = true;
+
+    // Every level one after another
+    std::vector<u8> m_data;
+    std::vector<usize> m_level_offsets;
+
+    void load_container(const std::string& path, TextureUsage usage, bool flip_vertically);
+    // Finds whether the level 0 pixels use alpha and differ between color channels
+    void analyze(const u8* pixels);
+    void generate_mips(const u8* pixels, TextureUsage usage);
+};
+
+} // namespace Hydrogen
@@ -2,16 +2,50 @@
 
 #include <iostream>
 #include "renderer_api.h"
+#include "vertex_format.h"
 #include <glm/gtx/transform.hpp>
 #include <cmath>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
 
 namespace Hydrogen {
 
+// Model matrix of each instance, one vec4 attribute per column
+#define INSTANCE_ATTRIBUTE_LOCATION 4
+static const std::vector<VertexLayout> INSTANCE_LAYOUT = {
+    {.type = ShaderType::Float32, .count = 4, .normalized = false, .divisor = 1},
+    {.type = ShaderType::Float32, .count = 4, .normalized = false, .divisor = 1},
+    {.type = ShaderType::Float32, .count = 4, .normalized = false, .divisor = 1},
+    {.type = ShaderType::Float32, .count = 4, .normalized = false, .divisor = 1},
+};
+
+// Model matrix of non instanced material draws, bound as a range of the object stream
+#define OBJECT_UNIFORM_BLOCK_SLOT 3
+#define OBJECT_STREAM_INITIAL_SIZE (64 * 1024)
+
+// Largest projected error of a level of detail, as a fraction of the screen height (a pixel at 1080p)
+#define LOD_ERROR_THRESHOLD (1.0f / 1080.0f)
+#define LOD_DEFAULT_HYSTERESIS 0.2f
+
+// Object space bounds of the primitives
+static const AABB CUBE_BOUNDS = AABB{.min = glm::vec3(-0.5f), .max = glm::vec3(0.5f)};
+static const AABB SPHERE_BOUNDS = AABB{.min = glm::vec3(-1.0f), .max = glm::vec3(1.0f)};
+
 void Renderer3D::init() {
     // Rendering Context
     m_context = new RenderingContext{};
-    // camera_ubo = mat4 (Projection) + mat4 (View) + vec3 (which has the same size as vec4)
-    m_context->camera_ubo = new UniformBuffer(2 * sizeof(glm::mat4) + sizeof(glm::vec4));
+    m_context->camera_ubo = new UniformBuffer(UniformBufferLayout()
+                                                  .add("Projection", UniformType::Mat4)
+                                                  .add("View", UniformType::Mat4)
+                                                  .add("CameraPosition", UniformType::Vec3),
+                                              true);
+    m_context->lights_ubo = new UniformBuffer(sizeof(LightsBlock), true);
+    m_context->instance_vbo = new VertexBuffer(nullptr, 0, BufferUsage::Stream);
+    m_context->object_stream = new StreamBuffer(OBJECT_STREAM_INITIAL_SIZE);
+    m_context->lod_bias = 1.0f;
+    m_context->lod_hysteresis = LOD_DEFAULT_HYSTERESIS;
 
     // Rendering Resources
     m_resources = new RendererResources{};
@@ -29,37 +63,109 @@ void Renderer3D::free() {
     delete m_resources;
 
     delete m_context->camera_ubo;
+    delete m_context->lights_ubo;
+    delete m_context->instance_vbo;
+    delete m_context->object_stream;
     delete m_context;
 }
 
 void Renderer3D::begin_frame(const Camera& camera) {
-    m_context->camera_ubo->set_mat4(0, camera.get_projection());
-    m_context->camera_ubo->set_mat4(1, camera.get_view());
-    m_context->camera_ubo->set_vec3(2, camera.get_position());
+    m_context->camera_ubo->set_mat4("Projection", camera.get_projection());
+    m_context->camera_ubo->set_mat4("View", camera.get_view());
+    m_context->camera_ubo->set_vec3("CameraPosition", camera.get_position());
+    m_context->camera_ubo->flush();
+
+    m_context->view = camera.get_view();
+    m_context->projection = camera.get_projection();
+    m_context->frustum = camera.get_frustum();
+    m_context->recording = true;
 }
 
 void Renderer3D::end_frame() {
+    submit_scene();
+
     // Draw lights
-    for (const Light& light : m_context->lights) {
-        Renderer3D::draw_cube(light.position, {0.25f, 0.25f, 0.25f}, light.diffuse);
+    const auto& block = m_context->lights_block;
+    for (i32 i = 0; i < block.count.x; ++i) {
+        const PointLightData& light = block.point_lights[i];
+        Renderer3D::draw_cube(glm::vec3(light.position), {0.25f, 0.25f, 0.25f}, glm::vec3(light.diffuse));
     }
-    m_context->lights.clear();
 
     // Draw Skybox
     if (m_context->skybox != nullptr) {
-        glDepthFunc(GL_LEQUAL);
+        auto model = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f, 2.0f, 2.0f));
+
+        submit(RenderCommand{
+            .type = CommandType::Skybox,
+            .pass = RenderPass::Skybox,
+            .primitive = RendererAPI::Primitive::Triangles,
+            .vao = m_resources->quad,
+            .range = m_resources->quad->get_draw_range(),
+            .shader = nullptr,
+            .material = nullptr,
+            .texture = nullptr,
+            .color = glm::vec3(1.0f),
+            .transform = model,
+            .instance_offset = 0,
+            .instance_count = 0,
+        });
+    }
 
-        auto* shader = m_context->skybox->bind(0);
-        Renderer3D::draw_cube({0.0f, 0.0f, 0.0f}, {2.0f, 2.0f, 2.0f}, shader);
-        m_context->skybox->unbind();
+    upload_lights();
+    flush();
 
-        glDepthFunc(GL_LESS);
-    }
+    m_context->lights_block.count = glm::ivec4(0);
+    m_context->recording = false;
 }
 
 void Renderer3D::add_light_source(const Light& light) {
-    // TODO: Use UBO to pass along lights?
-    m_context->lights.push_back(light);
+    auto& block = m_context->lights_block;
+    if (block.count.x >= MAX_NUMBER_POINT_LIGHTS) {
+        HG_LOG_WARN("Maximum number of point lights ({}) reached", MAX_NUMBER_POINT_LIGHTS);
+        return;
+    }
+
+    block.point_lights[block.count.x++] = PointLightData{
+        .position = glm::vec4(light.position, 1.0f),
+        .attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f),
+        .ambient = glm::vec4(light.ambient, 0.0f),
+        .diffuse = glm::vec4(light.diffuse, 0.0f),
+        .specular = glm::vec4(light.specular, 0.0f),
+    };
+}
+
+void Renderer3D::add_light_source(const DirectionalLight& light) {
+    auto& block = m_context->lights_block;
+    if (block.count.y >= MAX_NUMBER_DIRECTIONAL_LIGHTS) {
+        HG_LOG_WARN("Maximum number of directional lights ({}) reached",
+                    MAX_NUMBER_DIRECTIONAL_LIGHTS);
+        return;
+    }
+
+    block.directional_lights[block.count.y++] = DirectionalLightData{
+        .direction = glm::vec4(glm::normalize(light.direction), 0.0f),
+        .ambient = glm::vec4(light.ambient, 0.0f),
+        .diffuse = glm::vec4(light.diffuse, 0.0f),
+        .specular = glm::vec4(light.specular, 0.0f),
+    };
+}
+
+void Renderer3D::add_light_source(const SpotLight& light) {
+    auto& block = m_context->lights_block;
+    if (block.count.z >= MAX_NUMBER_SPOT_LIGHTS) {
+        HG_LOG_WARN("Maximum number of spot lights ({}) reached", MAX_NUMBER_SPOT_LIGHTS);
+        return;
+    }
+
+    block.spot_lights[block.count.z++] = SpotLightData{
+        .position = glm::vec4(light.position, 1.0f),
+        .direction = glm::vec4(glm::normalize(light.direction), 0.0f),
+        .attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f),
+        .cut_off = glm::vec4(std::cos(light.inner_cut_off), std::cos(light.outer_cut_off), 0.0f, 0.0f),
+        .ambient = glm::vec4(light.ambient, 0.0f),
+        .diffuse = glm::vec4(light.diffuse, 0.0f),
+        .specular = glm::vec4(light.specular, 0.0f),
+    };
 }
 
 void Renderer3D::set_skybox(const Skybox* skybox) {
@@ -71,139 +177,688 @@ void Renderer3D::draw_cube(const glm::vec3& pos, const glm::vec3& dim, Shader* s
     model = glm::translate(model, pos);
     model = glm::scale(model, dim);
 
-    shader->set_uniform_mat4("Model", model);
-    shader->assign_uniform_buffer("Camera", m_context->camera_ubo, 0);
-
-    RendererAPI::send(m_resources->quad, shader);
+    if (!is_visible(CUBE_BOUNDS, model))
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::Shader,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::Triangles,
+        .vao = m_resources->quad,
+        .range = m_resources->quad->get_draw_range(),
+        .shader = shader,
+        .material = nullptr,
+        .texture = nullptr,
+        .color = glm::vec3(1.0f),
+        .transform = model,
+        .instance_offset = 0,
+        .instance_count = 0,
+    });
 }
 
 void Renderer3D::draw_cube(const glm::vec3& pos, const glm::vec3& dim, const Texture* texture) {
-    m_resources->flat_color_shader->bind();
-    texture->bind("Texture", m_resources->flat_color_shader, 0);
-    m_resources->flat_color_shader->set_uniform_vec3("Color", glm::vec3(1.0f, 1.0f, 1.0f));
+    auto model = glm::mat4(1.0f);
+    model = glm::translate(model, pos);
+    model = glm::scale(model, dim);
 
-    Renderer3D::draw_cube(pos, dim, m_resources->flat_color_shader);
+    if (!is_visible(CUBE_BOUNDS, model))
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::FlatColor,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::Triangles,
+        .vao = m_resources->quad,
+        .range = m_resources->quad->get_draw_range(),
+        .shader = m_resources->flat_color_shader,
+        .material = nullptr,
+        .texture = texture,
+        .color = glm::vec3(1.0f),
+        .transform = model,
+        .instance_offset = 0,
+        .instance_count = 0,
+    });
 }
 
 void Renderer3D::draw_cube(const glm::vec3& pos, const glm::vec3& dim, const glm::vec3& color) {
-    m_resources->flat_color_shader->bind();
-    m_resources->white_texture->bind("Texture", m_resources->flat_color_shader, 0);
-    m_resources->flat_color_shader->set_uniform_vec3("Color", color);
+    auto model = glm::mat4(1.0f);
+    model = glm::translate(model, pos);
+    model = glm::scale(model, dim);
 
-    Renderer3D::draw_cube(pos, dim, m_resources->flat_color_shader);
+    if (!is_visible(CUBE_BOUNDS, model))
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::FlatColor,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::Triangles,
+        .vao = m_resources->quad,
+        .range = m_resources->quad->get_draw_range(),
+        .shader = m_resources->flat_color_shader,
+        .material = nullptr,
+        .texture = m_resources->white_texture,
+        .color = color,
+        .transform = model,
+        .instance_offset = 0,
+        .instance_count = 0,
+    });
 }
 
 void Renderer3D::draw_cube(const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material) {
-    Shader* shader = material.bind();
-    Renderer3D::draw_cube(pos, dim, shader);
+    auto model = glm::mat4(1.0f);
+    model = glm::translate(model, pos);
+    model = glm::scale(model, dim);
+
+    if (!is_visible(CUBE_BOUNDS, model))
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::Material,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::Triangles,
+        .vao = m_resources->quad,
+        .range = m_resources->quad->get_draw_range(),
+        .shader = material.get_shader(),
+        .material = &material,
+        .texture = nullptr,
+        .color = glm::vec3(1.0f),
+        .transform = model,
+        .instance_offset = 0,
+        .instance_count = 0,
+    });
 }
 
 void Renderer3D::draw_sphere(const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material) {
-    auto* shader = material.bind();
-    shader->bind();
-
     auto model = glm::mat4(1.0f);
     model = glm::translate(model, pos);
     model = glm::scale(model, dim);
 
-    shader->set_uniform_mat4("Model", model);
-    shader->assign_uniform_buffer("Camera", m_context->camera_ubo, 0);
+    if (!is_visible(SPHERE_BOUNDS, model))
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::Material,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::TriangleStrip,
+        .vao = m_resources->sphere,
+        .range = m_resources->sphere->get_draw_range(),
+        .shader = material.get_shader(),
+        .material = &material,
+        .texture = nullptr,
+        .color = glm::vec3(1.0f),
+        .transform = model,
+        .instance_offset = 0,
+        .instance_count = 0,
+    });
+}
 
-    // Add point lights
-    shader->set_uniform_int("NumberPointLights", (i32)m_context->lights.size());
-    for (u32 i = 0; i < m_context->lights.size(); ++i) {
-        const Light& light = m_context->lights[i];
+void Renderer3D::draw_cube_instanced(std::span<const glm::mat4> transforms, const IMaterial& material) {
+    const u32 instance_offset = push_visible_instances(transforms, CUBE_BOUNDS);
+    const auto instance_count = (u32)m_context->instance_transforms.size() - instance_offset;
+    if (instance_count == 0)
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::Material,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::Triangles,
+        .vao = m_resources->quad,
+        .range = m_resources->quad->get_draw_range(),
+        .shader = material.get_shader(true),
+        .material = &material,
+        .texture = nullptr,
+        .color = glm::vec3(1.0f),
+        .transform = m_context->instance_transforms[instance_offset],
+        .instance_offset = instance_offset,
+        .instance_count = instance_count,
+    });
+}
 
-        const std::string header = "PointLights[" + std::to_string(i) + "]";
-        shader->set_uniform_vec3(header + ".position", light.position);
-        shader->set_uniform_vec3(header + ".diffuse", light.diffuse);
+void Renderer3D::draw_sphere_instanced(std::span<const glm::mat4> transforms, const IMaterial& material) {
+    const u32 instance_offset = push_visible_instances(transforms, SPHERE_BOUNDS);
+    const auto instance_count = (u32)m_context->instance_transforms.size() - instance_offset;
+    if (instance_count == 0)
+        return;
+
+    submit(RenderCommand{
+        .type = CommandType::Material,
+        .pass = RenderPass::Opaque,
+        .primitive = RendererAPI::Primitive::TriangleStrip,
+        .vao = m_resources->sphere,
+        .range = m_resources->sphere->get_draw_range(),
+        .shader = material.get_shader(true),
+        .material = &material,
+        .texture = nullptr,
+        .color = glm::vec3(1.0f),
+        .transform = m_context->instance_transforms[instance_offset],
+        .instance_offset = instance_offset,
+        .instance_count = instance_count,
+    });
+}
+
+void Renderer3D::draw_model(const Model& model, const glm::vec3& pos, const glm::vec3& dim) {
+    auto m = glm::mat4(1.0f);
+    m = glm::translate(m, pos);
+    m = glm::scale(m, dim);
+
+    auto visibility = Frustum::Intersection::Inside;
+    if (m_context->recording) {
+        visibility = m_context->frustum.intersects(model.get_bounds().transform(m));
+        if (visibility == Frustum::Intersection::Outside)
+            return;
     }
 
-    // Add skybox
-    if (m_context->skybox != nullptr) {
-        m_context->skybox->bind_to_shader(shader, 10);
+    for (const auto* mesh : model.get_meshes()) {
+        // Meshes only need to be tested if the model is partially visible
+        if (visibility == Frustum::Intersection::Intersecting && !is_visible(mesh->bounds, m))
+            continue;
+
+        submit(RenderCommand{
+            .type = CommandType::Material,
+            .pass = RenderPass::Opaque,
+            .primitive = RendererAPI::Primitive::Triangles,
+            .vao = mesh->VAO,
+            .range = mesh->lods[select_lod(*mesh, m)].range,
+            .shader = mesh->material->get_shader(),
+            .material = mesh->material,
+            .texture = nullptr,
+            .color = glm::vec3(1.0f),
+            .transform = m,
+            .instance_offset = 0,
+            .instance_count = 0,
+        });
+    }
+}
+
+void Renderer3D::draw_model(const Model& model, const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material) {
+    auto m = glm::mat4(1.0f);
+    m = glm::translate(m, pos);
+    m = glm::scale(m, dim);
+
+    Shader* shader = material.get_shader();
+
+    auto visibility = Frustum::Intersection::Inside;
+    if (m_context->recording) {
+        visibility = m_context->frustum.intersects(model.get_bounds().transform(m));
+        if (visibility == Frustum::Intersection::Outside)
+            return;
     }
 
-    m_resources->sphere->bind();
-    glDrawElements(GL_TRIANGLE_STRIP, m_resources->sphere->get_count(), GL_UNSIGNED_INT, 0);
+    for (const auto* mesh : model.get_meshes()) {
+        if (visibility == Frustum::Intersection::Intersecting && !is_visible(mesh->bounds, m))
+            continue;
+
+        submit(RenderCommand{
+            .type = CommandType::Material,
+            .pass = RenderPass::Opaque,
+            .primitive = RendererAPI::Primitive::Triangles,
+            .vao = mesh->VAO,
+            .range = mesh->lods[select_lod(*mesh, m)].range,
+            .shader = shader,
+            .material = &material,
+            .texture = nullptr,
+            .color = glm::vec3(1.0f),
+            .transform = m,
+            .instance_offset = 0,
+            .instance_count = 0,
+        });
+    }
 }
 
-void Renderer3D::draw_model(const Model& model, const glm::vec3& pos, const glm::vec3& dim) {
+void Renderer3D::draw_model_instanced(const Model& model, std::span<const glm::mat4> transforms) {
+    // All meshes of the model share the same range of instance transforms
+    const u32 instance_offset = push_visible_instances(transforms, model.get_bounds());
+    const auto instance_count = (u32)m_context->instance_transforms.size() - instance_offset;
+    if (instance_count == 0)
+        return;
+
+    const auto instances = std::span(m_context->instance_transforms).subspan(instance_offset, instance_count);
+
     for (const auto* mesh : model.get_meshes()) {
-        VertexArray* VAO = mesh->VAO;
+        // The level of the closest instance, so no instance is drawn with less detail than it needs
+        u32 lod = (u32)mesh->lods.size() - 1;
+        for (const auto& transform : instances) {
+            lod = std::min(lod, select_lod(*mesh, transform));
+        }
 
-        auto* shader = mesh->material->bind();
-        shader->assign_uniform_buffer("Camera", m_context->camera_ubo, 0);
+        submit(RenderCommand{
+            .type = CommandType::Material,
+            .pass = RenderPass::Opaque,
+            .primitive = RendererAPI::Primitive::Triangles,
+            .vao = mesh->VAO,
+            .range = mesh->lods[lod].range,
+            .shader = mesh->material->get_shader(true),
+            .material = mesh->material,
+            .texture = nullptr,
+            .color = glm::vec3(1.0f),
+            .transform = m_context->instance_transforms[instance_offset],
+            .instance_offset = instance_offset,
+            .instance_count = instance_count,
+        });
+    }
+}
 
-        auto m = glm::mat4(1.0f);
-        m = glm::translate(m, pos);
-        m = glm::scale(m, dim);
-        shader->set_uniform_mat4("Model", m);
+u32 Renderer3D::push_instances(std::span<const glm::mat4> transforms) {
+    auto& instances = m_context->instance_transforms;
 
-        // Add point lights
-        // TODO: Use UBO to pass along lights?
-        shader->set_uniform_int("NumberPointLights", (i32)m_context->lights.size());
-        for (u32 i = 0; i < m_context->lights.size(); ++i) {
-            const Light& light = m_context->lights[i];
+    // Immediate draws only need the transforms of the current call
+    if (!m_context->recording) {
+        instances.clear();
+    }
 
-            const std::string header = "PointLights[" + std::to_string(i) + "]";
-            shader->set_uniform_vec3(header + ".position", light.position);
+    const auto offset = (u32)instances.size();
+    instances.insert(instances.end(), transforms.begin(), transforms.end());
 
-            shader->set_uniform_float(header + ".constant", light.constant);
-            shader->set_uniform_float(header + ".linear", light.linear);
-            shader->set_uniform_float(header + ".quadratic", light.quadratic);
+    return offset;
+}
 
-            shader->set_uniform_vec3(header + ".ambient", light.ambient);
-            shader->set_uniform_vec3(header + ".diffuse", light.diffuse);
-            shader->set_uniform_vec3(header + ".specular", light.specular);
-        }
+u32 Renderer3D::push_visible_instances(std::span<const glm::mat4> transforms, const AABB& bounds) {
+    if (!m_context->recording)
+        return push_instances(transforms);
+
+    auto& instances = m_context->instance_transforms;
+    const auto offset = (u32)instances.size();
 
-        // Add skybox
-        if (m_context->skybox != nullptr) {
-            m_context->skybox->bind_to_shader(shader, 10);
+    for (const auto& transform : transforms) {
+        if (is_visible(bounds, transform)) {
+            instances.push_back(transform);
         }
+    }
+
+    return offset;
+}
 
-        RendererAPI::send(VAO, shader);
+bool Renderer3D::is_visible(const AABB& bounds, const glm::mat4& transform) {
+    // There is no camera to cull against outside of a frame
+    if (!m_context->recording)
+        return true;
+
+    return m_context->frustum.intersects(bounds.transform(transform)) != Frustum::Intersection::Outside;
+}
+
+void Renderer3D::set_lod_bias(f32 bias) {
+    m_context->lod_bias = bias;
+}
+
+void Renderer3D::set_lod_hysteresis(f32 hysteresis) {
+    m_context->lod_hysteresis = hysteresis;
+}
+
+u32 Renderer3D::select_lod(const Mesh& mesh, const glm::mat4& transform, std::optional<u32> previous_lod) {
+    // Without a camera there is no projected size to choose from
+    if (!m_context->recording || mesh.lods.size() <= 1)
+        return 0;
+
+    const auto& sphere = mesh.bounding_sphere;
+    const glm::vec3 center = transform * glm::vec4(sphere.center, 1.0f);
+    const f32 scale = std::max({glm::length(glm::vec3(transform[0])),
+                                glm::length(glm::vec3(transform[1])),
+                                glm::length(glm::vec3(transform[2]))});
+    const f32 radius = sphere.radius * scale;
+
+    // Projected diameter of the bounding sphere as a fraction of the screen height
+    const auto& projection = m_context->projection;
+    f32 screen_size = radius * projection[1][1];
+    if (projection[2][3] != 0.0f) {
+        const f32 depth = -(m_context->view * glm::vec4(center, 1.0f)).z;
+        if (depth <= radius)
+            return 0;
+        screen_size /= depth;
+    }
+    screen_size *= m_context->lod_bias;
+
+    // Coarsest level whose error stays under a pixel. Levels coarser than the previous one need to be
+    // below the threshold by the hysteresis margin, the others are kept until they exceed it by the margin
+    for (u32 lod = (u32)mesh.lods.size() - 1; lod > 0; --lod) {
+        f32 threshold = LOD_ERROR_THRESHOLD;
+        if (previous_lod.has_value())
+            threshold *= lod > previous_lod.value() ? 1.0f - m_context->lod_hysteresis
+                                                    : 1.0f + m_context->lod_hysteresis;
+
+        if (mesh.lods[lod].error * screen_size <= threshold)
+            return lod;
     }
+
+    return 0;
 }
 
-void Renderer3D::draw_model(const Model& model, const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material) {
+SceneObjectId Renderer3D::add_to_scene(const Model& model, const glm::mat4& transform) {
+    const SceneObjectId id = m_context->next_scene_object_id++;
+    auto& slots = m_context->scene_objects[id];
+
     for (const auto* mesh : model.get_meshes()) {
-        VertexArray* VAO = mesh->VAO;
+        u32 slot;
+        if (!m_context->free_scene_meshes.empty()) {
+            slot = m_context->free_scene_meshes.back();
+            m_context->free_scene_meshes.pop_back();
+        } else {
+            slot = (u32)m_context->scene_meshes.size();
+            m_context->scene_meshes.emplace_back();
+        }
 
-        auto* shader = material.bind();
-        shader->assign_uniform_buffer("Camera", m_context->camera_ubo, 0);
+        const i32 proxy = m_context->scene_bvh.insert(mesh->bounds.transform(transform), slot);
+        m_context->scene_meshes[slot] = SceneMesh{
+            .mesh = mesh,
+            .transform = transform,
+            .proxy = proxy,
+        };
 
-        auto m = glm::mat4(1.0f);
-        m = glm::translate(m, pos);
-        m = glm::scale(m, dim);
-        shader->set_uniform_mat4("Model", m);
+        slots.push_back(slot);
+    }
+
+    return id;
+}
 
-        // Add point lights
-        // TODO: Use UBO to pass along lights?
-        shader->set_uniform_int("NumberPointLights", (i32)m_context->lights.size());
-        for (u32 i = 0; i < m_context->lights.size(); ++i) {
-            const Light& light = m_context->lights[i];
+void Renderer3D::set_scene_transform(SceneObjectId id, const glm::mat4& transform) {
+    HG_ASSERT(m_context->scene_objects.contains(id), "Scene object {} does not exist", id);
 
-            const std::string header = "PointLights[" + std::to_string(i) + "]";
-            shader->set_uniform_vec3(header + ".position", light.position);
+    for (const u32 slot : m_context->scene_objects[id]) {
+        auto& scene_mesh = m_context->scene_meshes[slot];
+        scene_mesh.transform = transform;
+
+        m_context->scene_bvh.move(scene_mesh.proxy, scene_mesh.mesh->bounds.transform(transform));
+    }
+}
+
+void Renderer3D::remove_from_scene(SceneObjectId id) {
+    if (!m_context->scene_objects.contains(id)) {
+        HG_LOG_WARN("Scene object {} does not exist", id);
+        return;
+    }
 
-            shader->set_uniform_float(header + ".constant", light.constant);
-            shader->set_uniform_float(header + ".linear", light.linear);
-            shader->set_uniform_float(header + ".quadratic", light.quadratic);
+    for (const u32 slot : m_context->scene_objects[id]) {
+        auto& scene_mesh = m_context->scene_meshes[slot];
+        m_context->scene_bvh.remove(scene_mesh.proxy);
 
-            shader->set_uniform_vec3(header + ".ambient", light.ambient);
-            shader->set_uniform_vec3(header + ".diffuse", light.diffuse);
-            shader->set_uniform_vec3(header + ".specular", light.specular);
+        scene_mesh.mesh = nullptr;
+        m_context->free_scene_meshes.push_back(slot);
+    }
+
+    m_context->scene_objects.erase(id);
+}
+
+void Renderer3D::submit_scene() {
+    auto& visible = m_context->visible_scene_meshes;
+    visible.clear();
+
+    m_context->scene_bvh.query(m_context->frustum, visible);
+
+    for (const u32 slot : visible) {
+        auto& scene_mesh = m_context->scene_meshes[slot];
+
+        // The BVH keeps enlarged bounds, test the exact ones before drawing
+        if (!is_visible(scene_mesh.mesh->bounds, scene_mesh.transform))
+            continue;
+
+        scene_mesh.lod = select_lod(*scene_mesh.mesh, scene_mesh.transform, scene_mesh.lod);
+
+        submit(RenderCommand{
+            .type = CommandType::Material,
+            .pass = RenderPass::Opaque,
+            .primitive = RendererAPI::Primitive::Triangles,
+            .vao = scene_mesh.mesh->VAO,
+            .range = scene_mesh.mesh->lods[scene_mesh.lod].range,
+            .shader = scene_mesh.mesh->material->get_shader(),
+            .material = scene_mesh.mesh->material,
+            .texture = nullptr,
+            .color = glm::vec3(1.0f),
+            .transform = scene_mesh.transform,
+            .instance_offset = 0,
+            .instance_count = 0,
+        });
+    }
+}
+
+void Renderer3D::submit(const RenderCommand& command) {
+    // Empty meshes have nothing to draw, their range would otherwise reach other meshes of the pool
+    if (command.range.index_count == 0)
+        return;
+
+    // Outside of begin_frame / end_frame (e.g. offscreen passes), draw immediately
+    if (!m_context->recording) {
+        if (command.instance_count > 0) {
+            upload_instances();
         }
 
-        // Add skybox
-        if (m_context->skybox != nullptr) {
-            m_context->skybox->bind_to_shader(shader, 10);
+        execute(command, true, true);
+        return;
+    }
+
+    const auto index = (u32)m_context->commands.size();
+    m_context->commands.push_back(command);
+    m_context->sort_entries.push_back(SortEntry{compute_sort_key(command), index});
+}
+
+void Renderer3D::flush() {
+    upload_instances();
+    upload_objects();
+
+    auto& entries = m_context->sort_entries;
+    std::sort(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b) {
+        return a.key < b.key;
+    });
+
+    RenderPass current_pass = RenderPass::None;
+    const Shader* current_shader = nullptr;
+    const IMaterial* current_material = nullptr;
+
+    usize i = 0;
+    while (i < entries.size()) {
+        const RenderCommand& command = m_context->commands[entries[i].command_index];
+
+        if (command.pass != current_pass) {
+            end_pass(current_pass);
+            begin_pass(command.pass);
+
+            current_pass = command.pass;
+            current_shader = nullptr;
+            current_material = nullptr;
+        }
+
+        const bool shader_changed = command.shader == nullptr || command.shader != current_shader;
+        const bool material_changed = shader_changed || command.material != current_material;
+
+        current_shader = command.shader;
+        current_material = command.material;
+
+        // Meshes of the same model sharing material and geometry pool go out in a single draw
+        usize run_end = i + 1;
+        while (run_end < entries.size()
+               && can_merge(command, m_context->commands[entries[run_end].command_index])) {
+            run_end++;
+        }
+
+        if (run_end - i == 1) {
+            execute(command, shader_changed, material_changed);
+            i++;
+            continue;
+        }
+
+        auto& ranges = m_context->multi_draw_ranges;
+        ranges.clear();
+        for (usize j = i; j < run_end; ++j) {
+            ranges.push_back(m_context->commands[entries[j].command_index].range);
+        }
+
+        Shader* shader = prepare(command, shader_changed, material_changed);
+        bind_object(command, shader);
+        RendererAPI::send_multi(command.vao, shader, ranges, command.primitive);
+
+        i = run_end;
+    }
+    end_pass(current_pass);
+
+    // Every draw reading this frame's object blocks has been issued
+    m_context->object_stream->fence();
+
+    // Keep capacity between frames to avoid reallocating the queue
+    m_context->commands.clear();
+    m_context->sort_entries.clear();
+    m_context->instance_transforms.clear();
+}
+
+void Renderer3D::upload_instances() {
+    const auto& instances = m_context->instance_transforms;
+    if (instances.empty())
+        return;
+
+    m_context->instance_vbo->update(instances.data(), (u32)(instances.size() * sizeof(glm::mat4)));
+}
+
+Shader* Renderer3D::prepare(const RenderCommand& command, bool shader_changed, bool material_changed) {
+    Shader* shader = command.shader;
+
+    switch (command.type) {
+        case CommandType::Shader:
+            break;
+        case CommandType::FlatColor:
+            command.texture->bind("Texture", shader, 0);
+            shader->set_uniform_vec3("Color", command.color);
+            break;
+        case CommandType::Material:
+            if (material_changed) {
+                command.material->bind(0, command.instance_count > 0);
+            }
+            break;
+        case CommandType::Skybox:
+            shader = m_context->skybox->bind(0);
+            break;
+    }
+
+    if (shader_changed) {
+        shader->assign_uniform_buffer("Camera", m_context->camera_ubo, 0);
+
+        if (command.type == CommandType::Material) {
+            shader->assign_uniform_buffer("Lights", m_context->lights_ubo, 1);
+            if (command.instance_count == 0) {
+                shader->set_uniform_block_slot("Object", OBJECT_UNIFORM_BLOCK_SLOT);
+            }
+
+            // Add skybox
+            if (m_context->skybox != nullptr) {
+                m_context->skybox->bind_to_shader(shader, 10);
+            }
         }
+    }
+
+    return shader;
+}
+
+void Renderer3D::execute(const RenderCommand& command, bool shader_changed, bool material_changed) {
+    Shader* shader = prepare(command, shader_changed, material_changed);
+
+    if (command.instance_count == 0) {
+        bind_object(command, shader);
+        RendererAPI::send(command.vao, shader, command.range, command.primitive);
+        return;
+    }
 
-        RendererAPI::send(VAO, shader);
+    // Point the model matrix attributes at this command's range of the instance buffer
+    command.vao->bind();
+    m_context->instance_vbo->set_layout(INSTANCE_LAYOUT, INSTANCE_ATTRIBUTE_LOCATION,
+                                        command.instance_offset * (u32)sizeof(glm::mat4));
+
+    RendererAPI::send_instanced(command.vao, shader, command.range, command.instance_count, command.primitive);
+    command.vao->disable_attributes(INSTANCE_ATTRIBUTE_LOCATION, (u32)INSTANCE_LAYOUT.size());
+}
+
+void Renderer3D::upload_objects() {
+    auto& commands = m_context->commands;
+
+    u32 number_objects = 0;
+    for (const auto& command : commands) {
+        if (command.type == CommandType::Material && command.instance_count == 0)
+            number_objects++;
     }
+
+    if (number_objects == 0)
+        return;
+
+    // Each block starts at a valid uniform buffer offset
+    const u32 alignment = StreamBuffer::get_uniform_alignment();
+    const u32 stride = (u32)(sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+
+    u32 base_offset;
+    auto* data = static_cast<u8*>(m_context->object_stream->map(number_objects * stride, base_offset));
+
+    u32 position = 0;
+    for (auto& command : commands) {
+        if (command.type != CommandType::Material || command.instance_count > 0)
+            continue;
+
+        std::memcpy(data + position, &command.transform, sizeof(glm::mat4));
+        command.object_offset = base_offset + position;
+        position += stride;
+    }
+
+    m_context->object_stream->unmap();
+}
+
+void Renderer3D::bind_object(const RenderCommand& command, Shader* shader) {
+    if (command.type != CommandType::Material) {
+        shader->set_uniform_mat4("Model", command.transform);
+        return;
+    }
+
+    u32 offset = command.object_offset;
+    // Immediate draws are not part of a flush, write their block on the spot
+    if (!m_context->recording) {
+        offset = m_context->object_stream->write(&command.transform, sizeof(glm::mat4));
+    }
+
+    RendererAPI::bind_uniform_buffer_range(OBJECT_UNIFORM_BLOCK_SLOT, m_context->object_stream->get_id(), offset,
+                                           sizeof(glm::mat4));
+}
+
+bool Renderer3D::can_merge(const RenderCommand& a, const RenderCommand& b) {
+    return a.type == CommandType::Material && b.type == CommandType::Material && a.pass == b.pass
+           && a.primitive == b.primitive && a.vao == b.vao && a.shader == b.shader && a.material == b.material
+           && a.instance_count == 0 && b.instance_count == 0 && a.transform == b.transform;
+}
+
+void Renderer3D::begin_pass(RenderPass pass) {
+    if (pass == RenderPass::Skybox) {
+        RendererAPI::set_depth_function(RendererAPI::DepthFunction::LessEqual);
+    }
+}
+
+void Renderer3D::end_pass(RenderPass pass) {
+    if (pass == RenderPass::Skybox) {
+        m_context->skybox->unbind();
+        RendererAPI::set_depth_function(RendererAPI::DepthFunction::Less);
+    }
+}
+
+u64 Renderer3D::compute_sort_key(const RenderCommand& command) {
+    const void* material_ptr = command.material != nullptr ? (const void*)command.material
+                                                           : (const void*)command.texture;
+
+    const u64 pass = (u64)command.pass & 0xF;
+    const u64 shader = command.shader != nullptr ? command.shader->get_id() & 0xFFFF : 0;
+    const u64 material = (reinterpret_cast<uintptr_t>(material_ptr) >> 4) & 0xFFFF;
+    const u64 vao = command.vao->get_id() & 0xFFF;
+
+    // View space depth, non-negative floats keep their ordering when compared as integers,
+    // so the upper 16 bits are enough to sort front to back
+    const f32 depth = std::max(-(m_context->view * command.transform[3]).z, 0.0f);
+    const u64 depth_bits = std::bit_cast<u32>(depth) >> 16;
+
+    return (pass << 60) | (shader << 44) | (material << 28) | (vao << 16) | depth_bits;
+}
+
+void Renderer3D::upload_lights() {
+    // Only upload the header and the used part of each light array
+    const auto& block = m_context->lights_block;
+    auto* ubo = m_context->lights_ubo;
+
+    ubo->update(&block.count, sizeof(block.count), offsetof(LightsBlock, count));
+    ubo->update(block.point_lights, (u32)block.count.x * sizeof(PointLightData),
+                offsetof(LightsBlock, point_lights));
+    ubo->update(block.directional_lights, (u32)block.count.y * sizeof(DirectionalLightData),
+                offsetof(LightsBlock, directional_lights));
+    ubo->update(block.spot_lights, (u32)block.count.z * sizeof(SpotLightData),
+                offsetof(LightsBlock, spot_lights));
+    ubo->flush();
 }
 
 VertexArray* Renderer3D::create_quad() {
@@ -252,7 +907,7 @@ VertexArray* Renderer3D::create_quad() {
         {.type = ShaderType::Float32, .count = 3, .normalized = false},
     });
 
-    const auto* ebo = new IndexBuffer(indices, sizeof(indices) / sizeof(u32));
+    auto* ebo = new IndexBuffer(indices, sizeof(indices) / sizeof(u32));
     ebo->bind();
 
     // Add Vertex Buffer and Index Buffer to Vertex Array
@@ -273,6 +928,7 @@ VertexArray* Renderer3D::create_sphere() {
     std::vector<glm::vec3> positions;
     std::vector<glm::vec2> uv;
     std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> tangents;
     std::vector<u32> indices;
 
     const u32 X_SEGMENTS = 64;
@@ -290,6 +946,7 @@ VertexArray* Renderer3D::create_sphere() {
             positions.push_back(glm::vec3(xPos, yPos, zPos));
             uv.push_back(glm::vec2(xSegment, ySegment));
             normals.push_back(glm::vec3(xPos, yPos, zPos));
+            tangents.push_back(glm::vec3(-std::sin(xSegment * 2.0f * PI), 0.0f, std::cos(xSegment * 2.0f * PI)));
         }
     }
 
@@ -310,30 +967,16 @@ VertexArray* Renderer3D::create_sphere() {
         oddRow = !oddRow;
     }
 
-    std::vector<f32> data;
+    // Same vertex format as meshes, material shaders decode it
+    std::vector<PackedVertex> data;
     for (u32 i = 0; i < positions.size(); ++i) {
-        data.push_back(positions[i].x);
-        data.push_back(positions[i].y);
-        data.push_back(positions[i].z);
-        if (normals.size() > 0) {
-            data.push_back(normals[i].x);
-            data.push_back(normals[i].y);
-            data.push_back(normals[i].z);
-        }
-        if (uv.size() > 0) {
-            data.push_back(uv[i].x);
-            data.push_back(uv[i].y);
-        }
+        data.push_back(PackedVertex::pack(positions[i], normals[i], uv[i], tangents[i]));
     }
 
-    auto* vbo = new VertexBuffer((void*)data.data(), (u32)data.size()*sizeof(float));
-    vbo->set_layout({
-        {.type = ShaderType::Float32, .count = 3, .normalized = false},
-        {.type = ShaderType::Float32, .count = 3, .normalized = false},
-        {.type = ShaderType::Float32, .count = 2, .normalized = false},
-    });
+    auto* vbo = new VertexBuffer(data.data(), (u32)(data.size() * sizeof(PackedVertex)));
+    vbo->set_layout(PackedVertex::get_layout());
 
-    const auto* ebo = new IndexBuffer(indices.data(), (u32)indices.size());
+    auto* ebo = new IndexBuffer(indices.data(), (u32)indices.size());
 
     vao->add_vertex_buffer(vbo);
     vao->set_index_buffer(ebo);
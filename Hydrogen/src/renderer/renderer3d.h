@@ -5,17 +5,24 @@
 #include <glad/glad.h>
 
 #include <glm/glm.hpp>
+#include <glm/trigonometric.hpp>
+#include <optional>
+#include <span>
+#include <unordered_map>
 
 #include "material/material.h"
 #include "core/model.h"
 #include "core/mesh.h"
 
 #include "core/camera.h"
+#include "core/bounds.h"
+#include "core/dynamic_bvh.h"
 #include "vertex_array.h"
 #include "buffers.h"
 #include "shader.h"
 #include "texture.h"
 #include "skybox.h"
+#include "renderer_api.h"
 
 namespace Hydrogen {
 
@@ -31,6 +38,38 @@ struct HG_API Light {
     glm::vec3 specular;
 };
 
+struct HG_API DirectionalLight {
+    glm::vec3 direction;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+struct HG_API SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+
+    // Angles in radians
+    f32 inner_cut_off = glm::radians(12.5f);
+    f32 outer_cut_off = glm::radians(17.5f);
+
+    f32 constant = 1.0f;
+    f32 linear = 0.09f;
+    f32 quadratic = 0.032f;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// Must match the sizes of the Lights uniform block in the base shaders
+#define MAX_NUMBER_POINT_LIGHTS 128
+#define MAX_NUMBER_DIRECTIONAL_LIGHTS 4
+#define MAX_NUMBER_SPOT_LIGHTS 32
+
+typedef u32 SceneObjectId;
+
 class HG_API Renderer3D {
   public:
     static void init();
@@ -41,6 +80,8 @@ class HG_API Renderer3D {
 
     // Scene configuration
     static void add_light_source(const Light& light);
+    static void add_light_source(const DirectionalLight& light);
+    static void add_light_source(const SpotLight& light);
     static void set_skybox(const Skybox* skybox);
 
     // Primitives
@@ -50,9 +91,24 @@ class HG_API Renderer3D {
     static void draw_cube(const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material);
     static void draw_sphere(const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material);
 
+    static void draw_cube_instanced(std::span<const glm::mat4> transforms, const IMaterial& material);
+    static void draw_sphere_instanced(std::span<const glm::mat4> transforms, const IMaterial& material);
+
     // Model
     static void draw_model(const Model& model, const glm::vec3& pos, const glm::vec3& dim);
     static void draw_model(const Model& model, const glm::vec3& pos, const glm::vec3& dim, const IMaterial& material);
+    static void draw_model_instanced(const Model& model, std::span<const glm::mat4> transforms);
+
+    // Mesh levels of detail are picked from the projected size of their bounding sphere.
+    // Larger biases keep detailed levels at longer distances. Hysteresis is the fraction of the error
+    // threshold a scene object has to cross before it switches levels, immediate draws have no history
+    static void set_lod_bias(f32 bias);
+    static void set_lod_hysteresis(f32 hysteresis);
+
+    // Persistent models, culled through a dynamic BVH and drawn every frame
+    static SceneObjectId add_to_scene(const Model& model, const glm::mat4& transform);
+    static void set_scene_transform(SceneObjectId id, const glm::mat4& transform);
+    static void remove_from_scene(SceneObjectId id);
 
   private:
     struct RendererResources {
@@ -64,13 +120,150 @@ class HG_API Renderer3D {
     };
     inline static RendererResources* m_resources;
 
+    // Render queue
+    enum class RenderPass : u8 {
+        Opaque = 0,
+        Skybox = 1,
+        None = 0xF
+    };
+
+    enum class CommandType : u8 {
+        Shader,
+        FlatColor,
+        Material,
+        Skybox
+    };
+
+    struct RenderCommand {
+        CommandType type;
+        RenderPass pass;
+        RendererAPI::Primitive primitive;
+
+        const VertexArray* vao;
+        DrawRange range;
+        Shader* shader;
+        const IMaterial* material;
+        const Texture* texture;
+        glm::vec3 color;
+
+        glm::mat4 transform;
+
+        // Range in RenderingContext::instance_transforms, instance_count == 0 if not instanced
+        u32 instance_offset;
+        u32 instance_count;
+
+        // Position of the Object block in RenderingContext::object_stream, written by flush()
+        u32 object_offset = 0;
+    };
+
+    // Sort key layout (from most to least significant bits):
+    // pass (4) | shader (16) | material (16) | vertex array (12) | depth (16)
+    struct SortEntry {
+        u64 key;
+        u32 command_index;
+    };
+
+    // std140 layout of the Lights uniform block
+    struct PointLightData {
+        glm::vec4 position;
+        glm::vec4 attenuation; // constant, linear, quadratic
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+    };
+
+    struct DirectionalLightData {
+        glm::vec4 direction;
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+    };
+
+    struct SpotLightData {
+        glm::vec4 position;
+        glm::vec4 direction;
+        glm::vec4 attenuation; // constant, linear, quadratic
+        glm::vec4 cut_off;     // cos(inner), cos(outer)
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+    };
+
+    struct LightsBlock {
+        glm::ivec4 count; // point, directional, spot
+        PointLightData point_lights[MAX_NUMBER_POINT_LIGHTS];
+        DirectionalLightData directional_lights[MAX_NUMBER_DIRECTIONAL_LIGHTS];
+        SpotLightData spot_lights[MAX_NUMBER_SPOT_LIGHTS];
+    };
+
+    struct SceneMesh {
+        const Mesh* mesh;
+        glm::mat4 transform;
+        i32 proxy;
+        // Level drawn in the previous frame
+        u32 lod = 0;
+    };
+
     struct RenderingContext {
         UniformBuffer* camera_ubo;
-        std::vector<Light> lights;
+        UniformBuffer* lights_ubo;
+
+        LightsBlock lights_block;
         const Skybox* skybox = nullptr;
+
+        glm::mat4 view{1.0f};
+        glm::mat4 projection{1.0f};
+        Frustum frustum;
+
+        f32 lod_bias;
+        f32 lod_hysteresis;
+        bool recording = false;
+
+        // Scene objects, the BVH leaves point into scene_meshes
+        DynamicBVH scene_bvh;
+        std::vector<SceneMesh> scene_meshes;
+        std::vector<u32> free_scene_meshes;
+        std::unordered_map<SceneObjectId, std::vector<u32>> scene_objects;
+        SceneObjectId next_scene_object_id = 0;
+        std::vector<u32> visible_scene_meshes;
+
+        std::vector<RenderCommand> commands;
+        std::vector<SortEntry> sort_entries;
+
+        // Ranges merged into a single multi draw
+        std::vector<DrawRange> multi_draw_ranges;
+
+        // Per-instance model matrices, uploaded once per flush
+        std::vector<glm::mat4> instance_transforms;
+        VertexBuffer* instance_vbo;
+
+        // Object blocks of non instanced material draws, one aligned range per command
+        StreamBuffer* object_stream;
     };
     inline static RenderingContext* m_context;
 
+    static void submit(const RenderCommand& command);
+    static u32 push_instances(std::span<const glm::mat4> transforms);
+    static u32 push_visible_instances(std::span<const glm::mat4> transforms, const AABB& bounds);
+    static bool is_visible(const AABB& bounds, const glm::mat4& transform);
+    static u32 select_lod(const Mesh& mesh, const glm::mat4& transform, std::optional<u32> previous_lod = {});
+    static void submit_scene();
+    static void flush();
+    static void upload_instances();
+    static void execute(const RenderCommand& command, bool shader_changed, bool material_changed);
+    // Binds the state of a command and returns the shader to draw with
+    static Shader* prepare(const RenderCommand& command, bool shader_changed, bool material_changed);
+    static void upload_objects();
+    static void bind_object(const RenderCommand& command, Shader* shader);
+    // Whether two commands only differ in the range of the vertex array they draw
+    static bool can_merge(const RenderCommand& a, const RenderCommand& b);
+
+    static void begin_pass(RenderPass pass);
+    static void end_pass(RenderPass pass);
+
+    static u64 compute_sort_key(const RenderCommand& command);
+    static void upload_lights();
+
     static VertexArray* create_quad();
     static VertexArray* create_sphere();
 };
@@ -2,12 +2,56 @@
 
 #include <glad/glad.h>
 
+#include <array>
+#include <cstring>
+#include <limits>
+#include <vector>
+
 namespace Hydrogen {
 
+#define MAX_TRACKED_TEXTURE_UNITS 32
+#define MAX_TRACKED_UNIFORM_BUFFER_SLOTS 16
+
+// Value for state that is not known, forces the next call to reach the driver
+static constexpr u32 UNKNOWN_STATE = std::numeric_limits<u32>::max();
+
+struct UniformBufferBinding {
+    u32 buffer;
+    // Size 0 means the whole buffer is bound
+    u32 offset;
+    u32 size;
+
+    bool operator==(const UniformBufferBinding& other) const = default;
+};
+
+struct GLState {
+    u32 program;
+    u32 vertex_array;
+    u32 framebuffer;
+    u32 depth_function;
+
+    u32 active_texture_unit;
+    std::array<u32, MAX_TRACKED_TEXTURE_UNITS> textures_2d;
+    std::array<u32, MAX_TRACKED_TEXTURE_UNITS> texture_arrays;
+    std::array<u32, MAX_TRACKED_TEXTURE_UNITS> cubemaps;
+    std::array<u32, MAX_TRACKED_TEXTURE_UNITS> samplers;
+
+    std::array<UniformBufferBinding, MAX_TRACKED_UNIFORM_BUFFER_SLOTS> uniform_buffers;
+};
+
+static GLState s_state;
+
+static void forget(u32& cached, u32 name) {
+    if (cached == name)
+        cached = UNKNOWN_STATE;
+}
+
 bool RendererAPI::init(void* loader) {
     if (!gladLoadGLLoader((GLADloadproc)loader))
         return false;
     glEnable(GL_DEPTH_TEST);
+
+    invalidate_state();
     return true;
 }
 
@@ -20,11 +64,262 @@ void RendererAPI::clear(const glm::vec3& color) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void RendererAPI::send(const VertexArray* vao, const Shader* shader) {
+static u32 get_primitive_mode(RendererAPI::Primitive primitive) {
+    return primitive == RendererAPI::Primitive::TriangleStrip ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+}
+
+static u32 get_opengl_index_type(const VertexArray* vao) {
+    return vao->get_index_type() == IndexType::UnsignedShort ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+static const void* get_index_offset(const VertexArray* vao, const DrawRange& range) {
+    return reinterpret_cast<const void*>((usize)range.first_index * vao->get_index_size());
+}
+
+void RendererAPI::send(const VertexArray* vao, const Shader* shader, Primitive primitive) {
+    shader->bind();
+    vao->bind();
+
+    glDrawElements(get_primitive_mode(primitive), vao->get_count(), get_opengl_index_type(vao), nullptr);
+}
+
+void RendererAPI::send(const VertexArray* vao, const Shader* shader, const DrawRange& range, Primitive primitive) {
+    if (range.index_count == 0)
+        return;
+
+    shader->bind();
+    vao->bind();
+
+    glDrawElementsBaseVertex(get_primitive_mode(primitive), (i32)range.index_count, get_opengl_index_type(vao),
+                             get_index_offset(vao, range), range.base_vertex);
+}
+
+void RendererAPI::send_instanced(const VertexArray* vao,
+                                 const Shader* shader,
+                                 u32 instance_count,
+                                 Primitive primitive) {
+    shader->bind();
+    vao->bind();
+
+    glDrawElementsInstanced(get_primitive_mode(primitive), vao->get_count(), get_opengl_index_type(vao), nullptr,
+                            (i32)instance_count);
+}
+
+void RendererAPI::send_instanced(const VertexArray* vao,
+                                 const Shader* shader,
+                                 const DrawRange& range,
+                                 u32 instance_count,
+                                 Primitive primitive) {
+    if (range.index_count == 0)
+        return;
+
+    shader->bind();
+    vao->bind();
+
+    glDrawElementsInstancedBaseVertex(get_primitive_mode(primitive), (i32)range.index_count, get_opengl_index_type(vao),
+                                      get_index_offset(vao, range), (i32)instance_count, range.base_vertex);
+}
+
+void RendererAPI::send_multi(const VertexArray* vao,
+                             const Shader* shader,
+                             std::span<const DrawRange> ranges,
+                             Primitive primitive) {
+    // Reused between calls to avoid allocating every draw
+    static std::vector<i32> counts;
+    static std::vector<const void*> offsets;
+    static std::vector<i32> base_vertices;
+
+    counts.clear();
+    offsets.clear();
+    base_vertices.clear();
+
+    for (const auto& range : ranges) {
+        counts.push_back((i32)range.index_count);
+        offsets.push_back(get_index_offset(vao, range));
+        base_vertices.push_back(range.base_vertex);
+    }
+
     shader->bind();
     vao->bind();
 
-    glDrawElements(GL_TRIANGLES, vao->get_count(), GL_UNSIGNED_INT, nullptr);
+    glMultiDrawElementsBaseVertex(get_primitive_mode(primitive), counts.data(), get_opengl_index_type(vao),
+                                  const_cast<void* const*>(offsets.data()), (i32)ranges.size(),
+                                  base_vertices.data());
+}
+
+//
+// State cache
+//
+void RendererAPI::use_program(u32 program) {
+    if (s_state.program == program)
+        return;
+
+    s_state.program = program;
+    glUseProgram(program);
+}
+
+void RendererAPI::bind_vertex_array(u32 vertex_array) {
+    if (s_state.vertex_array == vertex_array)
+        return;
+
+    s_state.vertex_array = vertex_array;
+    glBindVertexArray(vertex_array);
+}
+
+void RendererAPI::bind_texture(TextureTarget target, u32 slot, u32 texture, u32 sampler) {
+    if (s_state.active_texture_unit != slot) {
+        s_state.active_texture_unit = slot;
+        glActiveTexture(GL_TEXTURE0 + slot);
+    }
+
+    bind_texture(target, texture);
+
+    // Samplers apply to every target of the unit, so binding without one also clears the previous one
+    if (slot >= MAX_TRACKED_TEXTURE_UNITS) {
+        glBindSampler(slot, sampler);
+        return;
+    }
+
+    if (s_state.samplers[slot] == sampler)
+        return;
+
+    s_state.samplers[slot] = sampler;
+    glBindSampler(slot, sampler);
+}
+
+static u32 get_texture_target(RendererAPI::TextureTarget target) {
+    switch (target) {
+        case RendererAPI::TextureTarget::Texture2D:
+            return GL_TEXTURE_2D;
+        case RendererAPI::TextureTarget::Texture2DArray:
+            return GL_TEXTURE_2D_ARRAY;
+        case RendererAPI::TextureTarget::Cubemap:
+            return GL_TEXTURE_CUBE_MAP;
+    }
+    return GL_TEXTURE_2D;
+}
+
+void RendererAPI::bind_texture(TextureTarget target, u32 texture) {
+    const u32 gl_target = get_texture_target(target);
+
+    const u32 unit = s_state.active_texture_unit;
+    if (unit >= MAX_TRACKED_TEXTURE_UNITS) {
+        glBindTexture(gl_target, texture);
+        return;
+    }
+
+    auto& cached = target == TextureTarget::Cubemap          ? s_state.cubemaps[unit]
+                   : target == TextureTarget::Texture2DArray ? s_state.texture_arrays[unit]
+                                                             : s_state.textures_2d[unit];
+    if (cached == texture)
+        return;
+
+    cached = texture;
+    glBindTexture(gl_target, texture);
+}
+
+void RendererAPI::bind_uniform_buffer(u32 slot, u32 buffer) {
+    if (slot >= MAX_TRACKED_UNIFORM_BUFFER_SLOTS) {
+        glBindBufferBase(GL_UNIFORM_BUFFER, slot, buffer);
+        return;
+    }
+
+    const UniformBufferBinding binding{.buffer = buffer, .offset = 0, .size = 0};
+    if (s_state.uniform_buffers[slot] == binding)
+        return;
+
+    s_state.uniform_buffers[slot] = binding;
+    glBindBufferBase(GL_UNIFORM_BUFFER, slot, buffer);
+}
+
+void RendererAPI::bind_uniform_buffer_range(u32 slot, u32 buffer, u32 offset, u32 size) {
+    if (slot >= MAX_TRACKED_UNIFORM_BUFFER_SLOTS) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, slot, buffer, offset, size);
+        return;
+    }
+
+    const UniformBufferBinding binding{.buffer = buffer, .offset = offset, .size = size};
+    if (s_state.uniform_buffers[slot] == binding)
+        return;
+
+    s_state.uniform_buffers[slot] = binding;
+    glBindBufferRange(GL_UNIFORM_BUFFER, slot, buffer, offset, size);
+}
+
+void RendererAPI::bind_framebuffer(u32 framebuffer) {
+    if (s_state.framebuffer == framebuffer)
+        return;
+
+    s_state.framebuffer = framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void RendererAPI::set_depth_function(DepthFunction function) {
+    const u32 gl_function = function == DepthFunction::LessEqual ? GL_LEQUAL : GL_LESS;
+    if (s_state.depth_function == gl_function)
+        return;
+
+    s_state.depth_function = gl_function;
+    glDepthFunc(gl_function);
+}
+
+void RendererAPI::forget_program(u32 program) {
+    forget(s_state.program, program);
+}
+
+void RendererAPI::forget_vertex_array(u32 vertex_array) {
+    forget(s_state.vertex_array, vertex_array);
+}
+
+void RendererAPI::forget_texture(u32 texture) {
+    for (u32 unit = 0; unit < MAX_TRACKED_TEXTURE_UNITS; ++unit) {
+        forget(s_state.textures_2d[unit], texture);
+        forget(s_state.texture_arrays[unit], texture);
+        forget(s_state.cubemaps[unit], texture);
+    }
+}
+
+void RendererAPI::forget_sampler(u32 sampler) {
+    for (auto& cached : s_state.samplers) {
+        forget(cached, sampler);
+    }
+}
+
+void RendererAPI::forget_buffer(u32 buffer) {
+    for (auto& binding : s_state.uniform_buffers) {
+        forget(binding.buffer, buffer);
+    }
+}
+
+void RendererAPI::forget_framebuffer(u32 framebuffer) {
+    forget(s_state.framebuffer, framebuffer);
+}
+
+void RendererAPI::invalidate_state() {
+    s_state.program = UNKNOWN_STATE;
+    s_state.vertex_array = UNKNOWN_STATE;
+    s_state.framebuffer = UNKNOWN_STATE;
+    s_state.depth_function = UNKNOWN_STATE;
+
+    s_state.active_texture_unit = UNKNOWN_STATE;
+    s_state.textures_2d.fill(UNKNOWN_STATE);
+    s_state.texture_arrays.fill(UNKNOWN_STATE);
+    s_state.cubemaps.fill(UNKNOWN_STATE);
+    s_state.samplers.fill(UNKNOWN_STATE);
+
+    s_state.uniform_buffers.fill(UniformBufferBinding{.buffer = UNKNOWN_STATE, .offset = 0, .size = 0});
+}
+
+bool RendererAPI::has_extension(const char* name) {
+    i32 count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (i32 i = 0; i < count; ++i) {
+        const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, (u32)i));
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
 }
 
 } // namespace Hydrogen
@@ -3,6 +3,7 @@
 #include "core.h"
 
 #include <glm/glm.hpp>
+#include <span>
 
 #include "vertex_array.h"
 #include "shader.h"
@@ -11,10 +12,72 @@ namespace Hydrogen {
 
 class RendererAPI {
   public:
+    enum class Primitive {
+        Triangles,
+        TriangleStrip
+    };
+
+    enum class DepthFunction {
+        Less,
+        LessEqual
+    };
+
+    enum class TextureTarget {
+        Texture2D,
+        Texture2DArray,
+        Cubemap
+    };
+
     static bool init(void* loader);
     static void resize(i32 width, i32 height);
     static void clear(const glm::vec3& color);
-    static void send(const VertexArray* vao, const Shader* shader);
+    // Draws the whole index buffer of vao
+    static void send(const VertexArray* vao, const Shader* shader, Primitive primitive = Primitive::Triangles);
+    // Draws a part of the index buffer, empty ranges draw nothing
+    static void send(const VertexArray* vao,
+                     const Shader* shader,
+                     const DrawRange& range,
+                     Primitive primitive = Primitive::Triangles);
+    static void send_instanced(const VertexArray* vao,
+                               const Shader* shader,
+                               u32 instance_count,
+                               Primitive primitive = Primitive::Triangles);
+    static void send_instanced(const VertexArray* vao,
+                               const Shader* shader,
+                               const DrawRange& range,
+                               u32 instance_count,
+                               Primitive primitive = Primitive::Triangles);
+    // Draws several ranges of the same vertex array with a single call
+    static void send_multi(const VertexArray* vao,
+                           const Shader* shader,
+                           std::span<const DrawRange> ranges,
+                           Primitive primitive = Primitive::Triangles);
+
+    // State changes go through a shadow copy of the GL state and are skipped when redundant
+    static void use_program(u32 program);
+    static void bind_vertex_array(u32 vertex_array);
+    // Sampler 0 samples with the parameters of the texture itself
+    static void bind_texture(TextureTarget target, u32 slot, u32 texture, u32 sampler = 0);
+    // Binds to the currently active texture unit, used when uploading texture data
+    static void bind_texture(TextureTarget target, u32 texture);
+    static void bind_uniform_buffer(u32 slot, u32 buffer);
+    static void bind_uniform_buffer_range(u32 slot, u32 buffer, u32 offset, u32 size);
+    static void bind_framebuffer(u32 framebuffer);
+    static void set_depth_function(DepthFunction function);
+
+    // Drop cached bindings of deleted objects, as the driver can reuse their names
+    static void forget_program(u32 program);
+    static void forget_vertex_array(u32 vertex_array);
+    static void forget_texture(u32 texture);
+    static void forget_sampler(u32 sampler);
+    static void forget_buffer(u32 buffer);
+    static void forget_framebuffer(u32 framebuffer);
+
+    // Call after modifying GL state without going through RendererAPI
+    static void invalidate_state();
+
+    // Whether the driver exposes the extension, e.g. "GL_EXT_texture_compression_s3tc"
+    static bool has_extension(const char* name);
 };
 
 } // namespace Hydrogen
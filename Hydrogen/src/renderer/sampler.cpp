@@ -0,0 +1,82 @@
+#include "sampler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "renderer/renderer_api.h"
+
+// Core in GL 4.6, the loader only knows GL 3.3 so they are defined here. ARB and EXT versions of the
+// extension use the same values
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+namespace Hydrogen {
+
+static i32 get_min_filter(TextureFilter filter) {
+    switch (filter) {
+        case TextureFilter::Nearest:
+            return GL_NEAREST_MIPMAP_NEAREST;
+        case TextureFilter::Bilinear:
+            return GL_LINEAR_MIPMAP_NEAREST;
+        case TextureFilter::Trilinear:
+        case TextureFilter::Anisotropic:
+            return GL_LINEAR_MIPMAP_LINEAR;
+    }
+    return GL_LINEAR_MIPMAP_LINEAR;
+}
+
+static i32 get_wrap(TextureWrap wrap) {
+    switch (wrap) {
+        case TextureWrap::Repeat:
+            return GL_REPEAT;
+        case TextureWrap::ClampToEdge:
+            return GL_CLAMP_TO_EDGE;
+        case TextureWrap::MirroredRepeat:
+            return GL_MIRRORED_REPEAT;
+    }
+    return GL_CLAMP_TO_EDGE;
+}
+
+Sampler::Sampler(const SamplerDescription& description) : m_description(description) {
+    glGenSamplers(1, &ID);
+
+    // Textures without mips set GL_TEXTURE_MAX_LEVEL to 0, so mipmapped filters still work on them
+    glSamplerParameteri(ID, GL_TEXTURE_MIN_FILTER, get_min_filter(description.filter));
+    glSamplerParameteri(
+        ID, GL_TEXTURE_MAG_FILTER, description.filter == TextureFilter::Nearest ? GL_NEAREST : GL_LINEAR);
+
+    glSamplerParameteri(ID, GL_TEXTURE_WRAP_S, get_wrap(description.wrap));
+    glSamplerParameteri(ID, GL_TEXTURE_WRAP_T, get_wrap(description.wrap));
+    glSamplerParameteri(ID, GL_TEXTURE_WRAP_R, get_wrap(description.wrap));
+
+    const f32 max_supported = get_max_supported_anisotropy();
+    if (description.filter == TextureFilter::Anisotropic && max_supported > 1.0f) {
+        const f32 anisotropy = std::clamp(description.max_anisotropy, 1.0f, max_supported);
+        glSamplerParameterf(ID, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+    }
+}
+
+Sampler::~Sampler() {
+    RendererAPI::forget_sampler(ID);
+    glDeleteSamplers(1, &ID);
+}
+
+f32 Sampler::get_max_supported_anisotropy() {
+    static f32 max_anisotropy = 0.0f;
+    if (max_anisotropy == 0.0f) {
+        max_anisotropy = 1.0f;
+        if (RendererAPI::has_extension("GL_ARB_texture_filter_anisotropic") ||
+            RendererAPI::has_extension("GL_EXT_texture_filter_anisotropic")) {
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+            max_anisotropy = std::max(max_anisotropy, 1.0f);
+        }
+    }
+    return max_anisotropy;
+}
+
+} // namespace Hydrogen
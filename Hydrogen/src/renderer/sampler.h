@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core.h"
+
+namespace Hydrogen {
+
+enum class HG_API TextureFilter {
+    Nearest,
+    Bilinear,
+    // Bilinear blended between the two closest mip levels
+    Trilinear,
+    // Trilinear with several samples along the direction the texture is stretched in
+    Anisotropic
+};
+
+enum class HG_API TextureWrap {
+    Repeat,
+    ClampToEdge,
+    MirroredRepeat
+};
+
+struct HG_API SamplerDescription {
+    TextureFilter filter = TextureFilter::Anisotropic;
+    TextureWrap wrap = TextureWrap::ClampToEdge;
+    // Used by TextureFilter::Anisotropic, clamped to what the driver supports
+    f32 max_anisotropy = 8.0f;
+
+    bool operator==(const SamplerDescription& other) const = default;
+};
+
+// Sampling state shared by many textures, bound to a texture unit next to the texture. Create them through
+// TextureSystem::get_sampler so textures with the same description share one object
+class HG_API Sampler {
+  public:
+    explicit Sampler(const SamplerDescription& description);
+    ~Sampler();
+
+    Sampler(const Sampler&) = delete;
+    Sampler& operator=(const Sampler&) = delete;
+
+    u32 get_id() const { return ID; }
+    const SamplerDescription& get_description() const { return m_description; }
+
+    // 1 when the driver has no anisotropic filtering
+    static f32 get_max_supported_anisotropy();
+
+  private:
+    u32 ID;
+    SamplerDescription m_description;
+};
+
+} // namespace Hydrogen
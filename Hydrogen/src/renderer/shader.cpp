@@ -2,9 +2,13 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
+#include "renderer_api.h"
+
 namespace Hydrogen {
 
 Shader* Shader::from_string(const std::string& vertex_src, const std::string& fragment_src) {
@@ -86,68 +90,139 @@ void main()
 }
 
 void Shader::bind() const {
-    glUseProgram(ID);
+    RendererAPI::use_program(ID);
 }
 
 void Shader::unbind() const {
-    glUseProgram(0);
+    RendererAPI::use_program(0);
 }
 
-void Shader::assign_uniform_buffer(const std::string& name, UniformBuffer* uniform_buffer, u32 slot) const {
+void Shader::assign_uniform_buffer(UniformName name, UniformBuffer* uniform_buffer, u32 slot) const {
     uniform_buffer->assign_slot(slot);
+    set_uniform_block_slot(name, slot);
+}
+
+void Shader::set_uniform_block_slot(UniformName name, u32 slot) const {
+    // The block binding is program state, only needs to be set once per slot
+    const auto it = m_uniform_block_slots.find(name.hash);
+    if (it != m_uniform_block_slots.end() && it->second == slot)
+        return;
 
-    u32 uniform_block = glGetUniformBlockIndex(ID, name.c_str());
+    m_uniform_block_slots[name.hash] = slot;
+
+    const u32 uniform_block = glGetUniformBlockIndex(ID, std::string(name.name).c_str());
+    if (uniform_block == GL_INVALID_INDEX) {
+        HG_LOG_WARN("Uniform block '{}' not found in shader with ID {}", name.name, ID);
+        return;
+    }
     glUniformBlockBinding(ID, uniform_block, slot);
 }
 
-void Shader::set_uniform_int(const std::string& name, i32 value) {
-    bind();
-    if (!m_uniform_location.contains(name)) {
-        i32 uniform_location = get_uniform_location(name);
-        m_uniform_location.insert({name, uniform_location});
+UniformBufferLayout Shader::reflect_uniform_block(const std::string& name) const {
+    UniformBufferLayout layout;
+
+    const u32 block_index = glGetUniformBlockIndex(ID, name.c_str());
+    if (block_index == GL_INVALID_INDEX) {
+        HG_LOG_WARN("Uniform block '{}' not found in shader with ID {}", name, ID);
+        return layout;
     }
 
-    i32 uniform_location = m_uniform_location[name];
-    glUniform1i(uniform_location, value);
+    i32 size = 0, number_members = 0;
+    glGetActiveUniformBlockiv(ID, block_index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    glGetActiveUniformBlockiv(ID, block_index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &number_members);
+    layout.set_size((u32)size);
+
+    if (number_members == 0)
+        return layout;
+
+    std::vector<i32> indices((usize)number_members);
+    glGetActiveUniformBlockiv(ID, block_index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+
+    const std::vector<u32> member_indices(indices.begin(), indices.end());
+    std::vector<i32> offsets((usize)number_members), array_strides((usize)number_members);
+    glGetActiveUniformsiv(ID, number_members, member_indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+    glGetActiveUniformsiv(ID, number_members, member_indices.data(), GL_UNIFORM_ARRAY_STRIDE, array_strides.data());
+
+    i32 max_name_length = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+    std::vector<GLchar> name_buffer((usize)std::max(max_name_length, 1));
+
+    for (usize i = 0; i < member_indices.size(); ++i) {
+        i32 length = 0;
+        glGetActiveUniformName(ID, member_indices[i], max_name_length, &length, name_buffer.data());
+
+        // Arrays of basic types are reported as "name[0]"
+        std::string member_name(name_buffer.data(), (usize)length);
+        if (member_name.ends_with("[0]"))
+            member_name.resize(member_name.size() - 3);
+
+        layout.add_element(UniformName(std::string_view(member_name)), (u32)offsets[i], (u32)array_strides[i]);
+    }
+
+    return layout;
 }
 
-void Shader::set_uniform_float(const std::string& name, f32 value) {
-    bind();
-    if (!m_uniform_location.contains(name)) {
-        i32 uniform_location = get_uniform_location(name);
-        m_uniform_location.insert({name, uniform_location});
+UniformHandle Shader::get_uniform_handle(UniformName name) {
+    const auto it = std::lower_bound(
+        m_uniform_entries.begin(), m_uniform_entries.end(), name.hash, [](const UniformEntry& entry, u32 hash) {
+            return entry.hash < hash;
+        });
+
+    for (auto entry = it; entry != m_uniform_entries.end() && entry->hash == name.hash; ++entry) {
+        if (entry->name == name.name)
+            return entry->handle;
+    }
+
+    if (!m_missing_uniforms.contains(name.hash)) {
+        m_missing_uniforms.insert(name.hash);
+        HG_LOG_WARN("Uniform '{}' not found in shader with ID {}", name.name, ID);
     }
 
-    i32 uniform_location = m_uniform_location[name];
-    glUniform1f(uniform_location, value);
+    return -1;
 }
 
-void Shader::set_uniform_vec3(const std::string& name, const glm::vec3& value) {
+void Shader::set_uniform_int(UniformHandle handle, i32 value) {
+    const auto* uniform = update_shadow(handle, &value, sizeof(value));
+    if (uniform == nullptr)
+        return;
+
     bind();
-    if (!m_uniform_location.contains(name)) {
-        i32 uniform_location = get_uniform_location(name);
-        m_uniform_location.insert({name, uniform_location});
-    }
+    glUniform1i(uniform->location, value);
+}
+
+void Shader::set_uniform_float(UniformHandle handle, f32 value) {
+    const auto* uniform = update_shadow(handle, &value, sizeof(value));
+    if (uniform == nullptr)
+        return;
 
-    i32 uniform_location = m_uniform_location[name];
-    glUniform3f(uniform_location, value.x, value.y, value.z);
+    bind();
+    glUniform1f(uniform->location, value);
 }
 
-void Shader::set_uniform_mat4(const std::string& name, const glm::mat4& value) {
+void Shader::set_uniform_vec3(UniformHandle handle, const glm::vec3& value) {
+    const auto* uniform = update_shadow(handle, &value[0], sizeof(value));
+    if (uniform == nullptr)
+        return;
+
     bind();
-    if (!m_uniform_location.contains(name)) {
-        i32 uniform_location = get_uniform_location(name);
-        m_uniform_location.insert({name, uniform_location});
-    }
+    glUniform3f(uniform->location, value.x, value.y, value.z);
+}
 
-    i32 uniform_location = m_uniform_location[name];
-    glUniformMatrix4fv(uniform_location, 1, GL_FALSE, &value[0][0]);
+void Shader::set_uniform_mat4(UniformHandle handle, const glm::mat4& value) {
+    const auto* uniform = update_shadow(handle, &value[0][0], sizeof(value));
+    if (uniform == nullptr)
+        return;
+
+    bind();
+    glUniformMatrix4fv(uniform->location, 1, GL_FALSE, &value[0][0]);
 }
 
 Shader::Shader(u32 id) : ID(id) {
+    reflect_uniforms();
 }
 
 Shader::~Shader() {
+    RendererAPI::forget_program(ID);
     glDeleteProgram(ID);
 }
 
@@ -178,13 +253,63 @@ u32 Shader::compile(const std::string& source, u32 type) {
     return shader;
 }
 
-i32 Shader::get_uniform_location(const std::string& name) {
-    i32 uniform_location = glGetUniformLocation(ID, name.c_str());
-    if (uniform_location == -1) {
-        HG_LOG_WARN("Uniform '{}' not found in shader with ID {}", name, ID);
+void Shader::reflect_uniforms() {
+    i32 number_uniforms = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &number_uniforms);
+
+    i32 max_name_length = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+    std::vector<GLchar> name_buffer((usize)std::max(max_name_length, 1));
+
+    const auto add_uniform = [&](const std::string& name) -> UniformHandle {
+        const i32 location = glGetUniformLocation(ID, name.c_str());
+        // Uniforms inside of uniform blocks have no location
+        if (location == -1)
+            return -1;
+
+        const auto handle = (UniformHandle)m_uniforms.size();
+        m_uniform_entries.push_back({UniformName(name).hash, name, handle});
+        m_uniforms.push_back({.location = location, .value = {}, .has_value = false});
+        return handle;
+    };
+
+    for (u32 i = 0; i < (u32)number_uniforms; ++i) {
+        i32 length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, i, max_name_length, &length, &size, &type, name_buffer.data());
+
+        std::string name(name_buffer.data(), (usize)length);
+        const UniformHandle handle = add_uniform(name);
+
+        // Arrays are reported once as "name[0]", register every element
+        const auto array_suffix = name.rfind("[0]");
+        if (array_suffix != std::string::npos && array_suffix + 3 == name.size()) {
+            const std::string base_name = name.substr(0, array_suffix);
+            // The base name is the first element, both share its shadow copy
+            if (handle >= 0)
+                m_uniform_entries.push_back({UniformName(base_name).hash, base_name, handle});
+            for (i32 element = 1; element < size; ++element) {
+                add_uniform(base_name + "[" + std::to_string(element) + "]");
+            }
+        }
     }
 
-    return uniform_location;
+    std::sort(m_uniform_entries.begin(), m_uniform_entries.end(), [](const UniformEntry& a, const UniformEntry& b) {
+        return a.hash < b.hash;
+    });
+}
+
+Shader::Uniform* Shader::update_shadow(UniformHandle handle, const void* value, usize size) {
+    if (handle < 0)
+        return nullptr;
+
+    auto& uniform = m_uniforms[(usize)handle];
+    if (uniform.has_value && std::memcmp(uniform.value.data(), value, size) == 0)
+        return nullptr;
+
+    std::memcpy(uniform.value.data(), value, size);
+    uniform.has_value = true;
+    return &uniform;
 }
 
 } // namespace renderer
\ No newline at end of file
@@ -4,13 +4,21 @@
 
 #include <glm/glm.hpp>
 
+#include <array>
 #include <iostream>
-#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "buffers.h"
+#include "uniform_name.h"
 
 namespace Hydrogen {
 
+// Index of a reflected uniform inside a shader, negative if the uniform does not exist
+typedef i32 UniformHandle;
+
 class HG_API Shader {
   public:
     static Shader* from_string(const std::string& vertex_src, const std::string& fragment_src);
@@ -22,21 +30,61 @@ class HG_API Shader {
     void bind() const;
     void unbind() const;
 
-    void assign_uniform_buffer(const std::string& name, UniformBuffer* uniform_buffer, u32 slot) const;
+    u32 get_id() const { return ID; }
+
+    void assign_uniform_buffer(UniformName name, UniformBuffer* uniform_buffer, u32 slot) const;
+    // Points a uniform block at a binding point, buffers are bound to the slot separately
+    void set_uniform_block_slot(UniformName name, u32 slot) const;
+    // Member offsets of a uniform block as laid out by the linker
+    UniformBufferLayout reflect_uniform_block(const std::string& name) const;
+
+    UniformHandle get_uniform_handle(UniformName name);
 
-    void set_uniform_int(const std::string& name, i32 value);
-    void set_uniform_float(const std::string& name, f32 value);
-    void set_uniform_vec3(const std::string& name, const glm::vec3& value);
-    void set_uniform_mat4(const std::string& name, const glm::mat4& value);
+    // Uploads are skipped when the value matches the last one set for the uniform
+    void set_uniform_int(UniformHandle handle, i32 value);
+    void set_uniform_float(UniformHandle handle, f32 value);
+    void set_uniform_vec3(UniformHandle handle, const glm::vec3& value);
+    void set_uniform_mat4(UniformHandle handle, const glm::mat4& value);
+
+    void set_uniform_int(UniformName name, i32 value) { set_uniform_int(get_uniform_handle(name), value); }
+    void set_uniform_float(UniformName name, f32 value) { set_uniform_float(get_uniform_handle(name), value); }
+    void set_uniform_vec3(UniformName name, const glm::vec3& value) {
+        set_uniform_vec3(get_uniform_handle(name), value);
+    }
+    void set_uniform_mat4(UniformName name, const glm::mat4& value) {
+        set_uniform_mat4(get_uniform_handle(name), value);
+    }
 
   private:
+    struct Uniform {
+        i32 location;
+        // Last uploaded value, large enough for a mat4
+        std::array<f32, 16> value;
+        bool has_value;
+    };
+
+    struct UniformEntry {
+        u32 hash;
+        // Compared on lookup, so names with the same hash still get their own uniform
+        std::string name;
+        UniformHandle handle;
+    };
+
     u32 ID;
-    std::map<std::string, i32> m_uniform_location;
+    std::vector<Uniform> m_uniforms;
+    // Sorted by hash
+    std::vector<UniformEntry> m_uniform_entries;
+    // Names already reported as missing
+    std::unordered_set<u32> m_missing_uniforms;
+    // Binding point assigned to each uniform block
+    mutable std::unordered_map<u32, u32> m_uniform_block_slots;
 
     Shader(u32 id);
     static u32 compile(const std::string& source, u32 type);
 
-    i32 get_uniform_location(const std::string& value);
+    void reflect_uniforms();
+    // Returns the uniform if value differs from its shadow copy, storing the new value
+    Uniform* update_shadow(UniformHandle handle, const void* value, usize size);
 };
 
 } // namespace renderer
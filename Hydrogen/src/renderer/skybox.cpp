@@ -99,7 +99,7 @@ void Skybox::bind_to_shader(Shader* shader, u32 slot) const {
 }
 
 void Skybox::unbind() const {
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Cubemap, 0);
 }
 
 void Skybox::create_diffuse_irradiance_map() {
@@ -261,20 +261,21 @@ void Skybox::render_quad(Shader* shader) {
 
         m_quad_vao = new VertexArray();
 
-        auto vbo = VertexBuffer(quad_vertices, sizeof(quad_vertices));
-        vbo.set_layout({
+        auto* vbo = new VertexBuffer(quad_vertices, sizeof(quad_vertices));
+        vbo->set_layout({
             {.type = ShaderType::Float32, .count = 3, .normalized = false},
             {.type = ShaderType::Float32, .count = 2, .normalized = false}
         });
 
-        const auto ebo = IndexBuffer(indices, 6);
+        auto* ebo = new IndexBuffer(indices, 6);
 
-        m_quad_vao->add_vertex_buffer(&vbo);
-        m_quad_vao->set_index_buffer(&ebo);
+        // The vertex array owns the buffers
+        m_quad_vao->add_vertex_buffer(vbo);
+        m_quad_vao->set_index_buffer(ebo);
 
         m_quad_vao->unbind();
-        vbo.unbind();
-        ebo.unbind();
+        vbo->unbind();
+        ebo->unbind();
     }
 
     RendererAPI::send(m_quad_vao, shader);
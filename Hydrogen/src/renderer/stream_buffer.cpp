@@ -0,0 +1,125 @@
+#include "stream_buffer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "renderer_api.h"
+
+namespace Hydrogen {
+
+StreamBuffer::StreamBuffer(u32 segment_size) : ID(0), m_segment_size(0), m_segment(0), m_head(0), m_fences{} {
+    allocate_storage(segment_size);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (auto* sync : m_fences) {
+        if (sync != nullptr)
+            glDeleteSync((GLsync)sync);
+    }
+
+    RendererAPI::forget_buffer(ID);
+    glDeleteBuffers(1, &ID);
+}
+
+void* StreamBuffer::map(u32 size, u32& offset) {
+    const u32 alignment = get_uniform_alignment();
+    const u32 aligned_head = (m_head + alignment - 1) / alignment * alignment;
+
+    if (aligned_head + size > m_segment_size) {
+        // Ranges written earlier in the frame keep living in the old buffer until the GPU is done with it
+        const u32 segment_size = std::max(m_segment_size * 2, aligned_head + size);
+        HG_LOG_INFO("Growing stream buffer segments to {} bytes", segment_size);
+        allocate_storage(segment_size);
+
+        return map(size, offset);
+    }
+
+    offset = m_segment * m_segment_size + aligned_head;
+    m_head = aligned_head + size;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+void StreamBuffer::unmap() {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+u32 StreamBuffer::write(const void* data, u32 size) {
+    u32 offset;
+    void* destination = map(size, offset);
+    std::memcpy(destination, data, size);
+    unmap();
+
+    return offset;
+}
+
+void StreamBuffer::fence() {
+    if (m_fences[m_segment] != nullptr)
+        glDeleteSync((GLsync)m_fences[m_segment]);
+    m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_segment = (m_segment + 1) % STREAM_BUFFER_SEGMENTS;
+    m_head = 0;
+
+    wait_segment(m_segment);
+}
+
+u32 StreamBuffer::get_uniform_alignment() {
+    static u32 alignment = 0;
+    if (alignment == 0) {
+        i32 value = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+        alignment = (u32)std::max(value, 1);
+    }
+    return alignment;
+}
+
+void StreamBuffer::allocate_storage(u32 segment_size) {
+    if (ID != 0) {
+        RendererAPI::forget_buffer(ID);
+        glDeleteBuffers(1, &ID);
+    }
+
+    // Fences of the old buffer do not protect the new one
+    for (auto*& sync : m_fences) {
+        if (sync != nullptr)
+            glDeleteSync((GLsync)sync);
+        sync = nullptr;
+    }
+
+    const u32 alignment = get_uniform_alignment();
+    m_segment_size = (segment_size + alignment - 1) / alignment * alignment;
+    m_segment = 0;
+    m_head = 0;
+
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+    glBufferData(GL_COPY_WRITE_BUFFER, m_segment_size * STREAM_BUFFER_SEGMENTS, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::wait_segment(u32 segment) {
+    auto* sync = (GLsync)m_fences[segment];
+    if (sync == nullptr)
+        return;
+
+    // Only blocks when the GPU is still reading a segment written STREAM_BUFFER_SEGMENTS frames ago
+    constexpr u64 TIMEOUT_NS = 1000000000;
+    GLenum result = glClientWaitSync(sync, 0, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, TIMEOUT_NS);
+    }
+
+    if (result == GL_WAIT_FAILED) {
+        HG_LOG_ERROR("Failed waiting for stream buffer fence");
+    }
+
+    glDeleteSync(sync);
+    m_fences[segment] = nullptr;
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core.h"
+
+#include <array>
+
+namespace Hydrogen {
+
+#define STREAM_BUFFER_SEGMENTS 3
+
+// Ring of buffer segments for data rewritten every frame. Each segment is written during one frame
+// and fenced when the frame ends, so writes only wait for the GPU if it is STREAM_BUFFER_SEGMENTS
+// frames behind. GL 3.3 has no persistent mapping, every write maps its range unsynchronized instead.
+class HG_API StreamBuffer {
+  public:
+    explicit StreamBuffer(u32 segment_size);
+    ~StreamBuffer();
+
+    // Maps size bytes of the current segment, offset is set to their position in the buffer.
+    // The segment grows if the data does not fit.
+    void* map(u32 size, u32& offset);
+    void unmap();
+
+    // Returns the offset of the copied data
+    u32 write(const void* data, u32 size);
+
+    // Closes the current segment once every draw reading from it has been issued
+    void fence();
+
+    u32 get_id() const { return ID; }
+
+    // Offsets bound as uniform buffer ranges must be multiples of this value
+    static u32 get_uniform_alignment();
+
+  private:
+    u32 ID;
+    u32 m_segment_size;
+
+    u32 m_segment;
+    u32 m_head;
+    std::array<void*, STREAM_BUFFER_SEGMENTS> m_fences;
+
+    void allocate_storage(u32 segment_size);
+    void wait_segment(u32 segment);
+};
+
+} // namespace Hydrogen
@@ -1,31 +1,51 @@
 #include "texture.h"
 
 #include <glad/glad.h>
-#include <filesystem>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <algorithm>
+#include <cstring>
 
 #include "renderer/shader.h"
+#include "renderer/renderer_api.h"
+
+// Formats from extensions the GL 3.3 loader does not know
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
 
 namespace Hydrogen {
 
+u64 Texture::s_current_frame = 0;
+
+u32 Texture::get_internal_format(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::RGBA8:
+            return GL_RGBA8;
+        case TextureFormat::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case TextureFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case TextureFormat::BC7:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return GL_RGBA8;
+}
+
 Texture::Texture(const unsigned char* data, i32 width, i32 height)
     : m_file_path(), m_width(width), m_height(height), m_BPP(0)
 {
-    glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_2D, ID);
-
-    // How the texture will be resampled down if it needs to be smaller than it is
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    // How the texture will be resampled up if it needs to be larger than it is
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
+    create(TextureFormat::RGBA8, 1);
+    upload_level(0, data, 0);
     unbind();
 }
 
@@ -33,7 +53,7 @@ Texture::Texture(const f32* data, i32 width, i32 height)
     : m_file_path(), m_width(width), m_height(height), m_BPP(0)
 {
     glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2D, ID);
 
     // How the texture will be resampled down if it needs to be smaller than it is
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -48,31 +68,120 @@ Texture::Texture(const f32* data, i32 width, i32 height)
     unbind();
 }
 
-Texture::Texture(const std::string& path) : m_file_path(path), m_width(0), m_height(0), m_BPP(0) {
-    HG_ASSERT(std::filesystem::exists(path), "Could not open " + path);
+Texture::Texture(const std::string& path, TextureUsage usage, bool flip_vertically)
+    : Texture(Image(path, usage, flip_vertically), path) {}
 
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* local_buffer = stbi_load(path.c_str(), &m_width, &m_height, &m_BPP, 4);
+Texture::Texture(const Image& image, const std::string& path)
+    : m_file_path(path), m_width(image.get_width()), m_height(image.get_height()), m_BPP(image.get_channels()) {
+    create(image.get_format(), std::max(image.get_level_count(), 1u));
+    for (u32 level = 0; level < image.get_level_count(); ++level) {
+        upload_level(level, image.get_pixels(level), image.get_size(level));
+    }
+    unbind();
+}
+
+Texture::Texture(const std::string& path, const Texture* placeholder)
+    : ID(0), m_file_path(path), m_width(0), m_height(0), m_BPP(0), m_placeholder(placeholder) {}
+
+void Texture::upload(const Image& image, StreamBuffer& pixel_buffer) {
+    if (ID != 0) {
+        RendererAPI::forget_texture(ID);
+        glDeleteTextures(1, &ID);
+    }
+
+    m_width = image.get_width();
+    m_height = image.get_height();
+    m_BPP = image.get_channels();
+
+    // Levels are copied with a single mapping, the buffer could otherwise grow for a later level and leave
+    // the offsets of the earlier ones pointing into new storage
+    u32 offset = 0;
+    auto* destination = static_cast<u8*>(pixel_buffer.map(image.get_total_size(), offset));
+    std::memcpy(destination, image.get_pixels(0), image.get_total_size());
+    pixel_buffer.unmap();
+
+    create(image.get_format(), std::max(image.get_level_count(), 1u));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.get_id());
+    for (u32 level = 0; level < image.get_level_count(); ++level) {
+        // Levels are stored one after another in the image
+        const uintptr_t level_offset = offset + (uintptr_t)(image.get_pixels(level) - image.get_pixels(0));
+        upload_level(level, reinterpret_cast<const void*>(level_offset), image.get_size(level));
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    unbind();
+
+    m_placeholder = nullptr;
+}
+
+void Texture::create(TextureFormat format, u32 levels) {
+    m_format = format;
+    m_levels = levels;
+
+    m_memory_size = 0;
+    for (u32 level = 0; level < levels; ++level) {
+        m_memory_size += get_level_size(format, std::max(m_width >> level, 1), std::max(m_height >> level, 1));
+    }
 
     glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2D, ID);
 
+    // State used when no sampler is bound
     // How the texture will be resampled down if it needs to be smaller than it is
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     // How the texture will be resampled up if it needs to be larger than it is
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 local_buffer);
+    // Keeps the texture complete under mipmapped sampler filters when it has fewer levels
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (i32)levels - 1);
 
-    unbind();
-    stbi_image_free(local_buffer);
+    // BC4 only stores red, shaders reading single values from other channels of packed maps still find it
+    if (format == TextureFormat::BC4) {
+        const i32 swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+}
+
+void Texture::upload_level(u32 level, const void* pixels, u32 size) {
+    const i32 width = std::max(m_width >> level, 1);
+    const i32 height = std::max(m_height >> level, 1);
+
+    if (is_block_compressed(m_format)) {
+        const u32 format = get_internal_format(m_format);
+        glCompressedTexImage2D(GL_TEXTURE_2D, (i32)level, format, width, height, 0, (i32)size, pixels);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, (i32)level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+}
+
+bool Texture::is_format_supported(TextureFormat format) {
+    static const bool s3tc = RendererAPI::has_extension("GL_EXT_texture_compression_s3tc");
+    static const bool bptc = RendererAPI::has_extension("GL_ARB_texture_compression_bptc");
+
+    switch (format) {
+        case TextureFormat::RGBA8:
+        case TextureFormat::BC4:
+        case TextureFormat::BC5:
+            // RGTC is core since GL 3.0
+            return true;
+        case TextureFormat::BC1:
+        case TextureFormat::BC3:
+            return s3tc;
+        case TextureFormat::BC7:
+            return bptc;
+    }
+    return false;
 }
 
 Texture::~Texture() {
+    // Pending textures never created theirs
+    if (ID == 0)
+        return;
+
+    RendererAPI::forget_texture(ID);
     glDeleteTextures(1, &ID);
 }
 
@@ -86,14 +195,17 @@ void Texture::attach_to_framebuffer(Framebuffer::AttachmentType attachment_type,
     glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, ID, (i32)level);
 }
 
-void Texture::bind(const std::string& name, Shader* shader, u32 slot) const {
+void Texture::bind(UniformName name, Shader* shader, u32 slot) const {
+    m_last_bound_frame = s_current_frame;
     shader->set_uniform_int(name, (i32)slot);
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2D,
+                              slot,
+                              get_bound_id(),
+                              m_sampler != nullptr ? m_sampler->get_id() : 0);
 }
 
 void Texture::unbind() const {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2D, 0);
 }
 
 } // namespace Hydrogen
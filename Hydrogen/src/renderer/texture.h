@@ -5,30 +5,59 @@
 #include <string>
 
 #include "renderer/framebuffer.h"
+#include "renderer/shader.h"
+#include "renderer/image.h"
+#include "renderer/sampler.h"
+#include "renderer/stream_buffer.h"
 
 namespace Hydrogen {
 
-// Forward declaration
-class Shader;
-
 class HG_API Texture : public IFramebufferAttachable {
   public:
     Texture(const unsigned char* data, i32 width, i32 height);
     Texture(const f32* data, i32 width, i32 height);
-    Texture(const std::string& path);
+    Texture(const std::string& path, TextureUsage usage = TextureUsage::Color, bool flip_vertically = true);
+    // Uploads an image decoded beforehand with all its levels, path identifies the texture in TextureSystem
+    Texture(const Image& image, const std::string& path);
+    // Pending texture, binding it binds placeholder until upload gives it its own image
+    Texture(const std::string& path, const Texture* placeholder);
     ~Texture();
 
     static Texture* white();
 
     i32 get_width() const { return m_width; }
     i32 get_height() const { return m_height; }
+    u32 get_level_count() const { return m_levels; }
+    TextureFormat get_format() const { return m_format; }
+
+    // Whether the driver can sample the format, call from the main thread
+    static bool is_format_supported(TextureFormat format);
+    // Format passed to GL when allocating storage for format
+    static u32 get_internal_format(TextureFormat format);
 
     const std::string& get_path() const { return m_file_path; }
 
+    // False while a pending texture still samples its placeholder
+    bool is_ready() const { return m_placeholder == nullptr; }
+    // Gives the texture a new image, replacing the previous one if it had one. Every level is copied to
+    // pixel_buffer first and read from there, so the copy into the texture does not stall on the CPU side
+    void upload(const Image& image, StreamBuffer& pixel_buffer);
+
+    // Bytes of every level on the GPU
+    u64 get_memory_size() const { return m_memory_size; }
+    // Frame of the last bind, as counted by set_current_frame
+    u64 get_last_bound_frame() const { return m_last_bound_frame; }
+    static void set_current_frame(u64 frame) { s_current_frame = frame; }
+
+    // Sampler bound next to the texture, without one the texture samples with its own bilinear or
+    // trilinear clamped state
+    void set_sampler(const Sampler* sampler) { m_sampler = sampler; }
+    const Sampler* get_sampler() const { return m_sampler; }
+
     void attach_to_framebuffer(
         Framebuffer::AttachmentType attachment_type, u32 level) const override;
 
-    void bind(const std::string& name, Shader* shader, u32 slot) const;
+    void bind(UniformName name, Shader* shader, u32 slot) const;
     void unbind() const;
 
   private:
@@ -36,6 +65,22 @@ class HG_API Texture : public IFramebufferAttachable {
 
     std::string m_file_path;
     i32 m_width, m_height, m_BPP;
+    u32 m_levels = 1;
+    TextureFormat m_format = TextureFormat::RGBA8;
+
+    u64 m_memory_size = 0;
+
+    const Texture* m_placeholder = nullptr;
+    const Sampler* m_sampler = nullptr;
+
+    static u64 s_current_frame;
+    mutable u64 m_last_bound_frame = s_current_frame;
+
+    // Creates the GL texture for levels levels of format, left bound
+    void create(TextureFormat format, u32 levels);
+    // pixels can be an offset into a bound unpack buffer, size is only read for compressed formats
+    void upload_level(u32 level, const void* pixels, u32 size);
+    u32 get_bound_id() const { return m_placeholder != nullptr ? m_placeholder->get_bound_id() : ID; }
 };
 
 } // namespace Hydrogen
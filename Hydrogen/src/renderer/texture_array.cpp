@@ -0,0 +1,192 @@
+#include "texture_array.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "renderer/texture.h"
+#include "renderer/renderer_api.h"
+
+namespace Hydrogen {
+
+TextureArray::TextureArray(i32 width, i32 height, TextureFormat format, u32 levels)
+    : m_width(width), m_height(height), m_format(format), m_levels(levels) {
+    for (u32 level = 0; level < levels; ++level) {
+        m_layer_size += get_level_size(format, std::max(width >> level, 1), std::max(height >> level, 1));
+    }
+
+    create(TEXTURE_ARRAY_INITIAL_LAYERS);
+    unbind();
+}
+
+TextureArray::~TextureArray() {
+    RendererAPI::forget_texture(ID);
+    glDeleteTextures(1, &ID);
+}
+
+void TextureArray::create(u32 capacity) {
+    m_capacity = capacity;
+    m_used_layers.resize(capacity, false);
+
+    glGenTextures(1, &ID);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2DArray, ID);
+
+    // State used when no sampler is bound, same as Texture
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, m_levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (i32)m_levels - 1);
+
+    if (m_format == TextureFormat::BC4) {
+        const i32 swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    // Storage of every layer, left undefined until images are added
+    const u32 internal_format = Texture::get_internal_format(m_format);
+    for (u32 level = 0; level < m_levels; ++level) {
+        const i32 width = std::max(m_width >> level, 1);
+        const i32 height = std::max(m_height >> level, 1);
+
+        if (is_block_compressed(m_format)) {
+            const u64 size = get_level_size(m_format, width, height) * capacity;
+            glCompressedTexImage3D(
+                GL_TEXTURE_2D_ARRAY, (i32)level, internal_format, width, height, (i32)capacity, 0, (i32)size, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY,
+                         (i32)level,
+                         (i32)internal_format,
+                         width,
+                         height,
+                         (i32)capacity,
+                         0,
+                         GL_RGBA,
+                         GL_UNSIGNED_BYTE,
+                         nullptr);
+        }
+    }
+}
+
+void TextureArray::upload_layers(u32 level, u32 first, u32 count, const void* pixels) {
+    const i32 width = std::max(m_width >> level, 1);
+    const i32 height = std::max(m_height >> level, 1);
+
+    if (is_block_compressed(m_format)) {
+        const u64 size = get_level_size(m_format, width, height) * count;
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                                  (i32)level,
+                                  0,
+                                  0,
+                                  (i32)first,
+                                  width,
+                                  height,
+                                  (i32)count,
+                                  Texture::get_internal_format(m_format),
+                                  (i32)size,
+                                  pixels);
+    } else {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                        (i32)level,
+                        0,
+                        0,
+                        (i32)first,
+                        width,
+                        height,
+                        (i32)count,
+                        GL_RGBA,
+                        GL_UNSIGNED_BYTE,
+                        pixels);
+    }
+}
+
+void TextureArray::grow(u32 capacity) {
+    const u32 previous = ID;
+    const u32 previous_capacity = m_capacity;
+
+    // GL 3.3 has no copy between textures, levels are read into a buffer and written back from it without
+    // leaving the GPU
+    u32 buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (i64)(m_layer_size * previous_capacity), nullptr, GL_STREAM_COPY);
+
+    // Every layer of a level is read at once, one level after another
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2DArray, previous);
+    std::vector<u64> offsets;
+    u64 offset = 0;
+    for (u32 level = 0; level < m_levels; ++level) {
+        offsets.push_back(offset);
+
+        auto* destination = reinterpret_cast<void*>((uintptr_t)offset);
+        if (is_block_compressed(m_format))
+            glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, (i32)level, destination);
+        else
+            glGetTexImage(GL_TEXTURE_2D_ARRAY, (i32)level, GL_RGBA, GL_UNSIGNED_BYTE, destination);
+
+        const i32 width = std::max(m_width >> level, 1);
+        const i32 height = std::max(m_height >> level, 1);
+        offset += get_level_size(m_format, width, height) * previous_capacity;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    create(capacity);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    for (u32 level = 0; level < m_levels; ++level) {
+        upload_layers(level, 0, previous_capacity, reinterpret_cast<const void*>((uintptr_t)offsets[level]));
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+
+    RendererAPI::forget_texture(previous);
+    glDeleteTextures(1, &previous);
+}
+
+bool TextureArray::accepts(const Image& image) const {
+    return image.get_width() == m_width && image.get_height() == m_height && image.get_format() == m_format
+           && image.get_level_count() == m_levels;
+}
+
+u32 TextureArray::add(const Image& image) {
+    HG_ASSERT(accepts(image), "Image does not match the layers of the texture array");
+    HG_ASSERT(has_free_layer(), "Texture array has no free layer left");
+
+    if (m_layer_count == m_capacity)
+        grow(std::min(m_capacity * 2, (u32)TEXTURE_ARRAY_MAX_LAYERS));
+    else
+        RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2DArray, ID);
+
+    const u32 layer = (u32)(std::find(m_used_layers.begin(), m_used_layers.end(), false) - m_used_layers.begin());
+    m_used_layers[layer] = true;
+    m_layer_count++;
+
+    for (u32 level = 0; level < m_levels; ++level) {
+        upload_layers(level, layer, 1, image.get_pixels(level));
+    }
+    unbind();
+
+    return layer;
+}
+
+void TextureArray::remove(u32 layer) {
+    HG_ASSERT(m_used_layers[layer], "Layer {} of the texture array is not used", layer);
+
+    m_used_layers[layer] = false;
+    m_layer_count--;
+}
+
+void TextureArray::bind(UniformName name, Shader* shader, u32 slot) const {
+    shader->set_uniform_int(name, (i32)slot);
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2DArray,
+                              slot,
+                              ID,
+                              m_sampler != nullptr ? m_sampler->get_id() : 0);
+}
+
+void TextureArray::unbind() const {
+    RendererAPI::bind_texture(RendererAPI::TextureTarget::Texture2DArray, 0);
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "core.h"
+
+#include <vector>
+
+#include "renderer/shader.h"
+#include "renderer/image.h"
+#include "renderer/sampler.h"
+
+namespace Hydrogen {
+
+// Layers allocated by a new array, doubled every time they are all used
+#define TEXTURE_ARRAY_INITIAL_LAYERS 4
+// Minimum GL_MAX_ARRAY_TEXTURE_LAYERS of GL 3.3, full arrays stop growing and a new one is created
+#define TEXTURE_ARRAY_MAX_LAYERS 256
+
+// Images of the same size, format and level count stored as the layers of one GL_TEXTURE_2D_ARRAY. Materials
+// sampling layers of the same arrays bind them once, and only change the layer they sample between draws
+class HG_API TextureArray {
+  public:
+    TextureArray(i32 width, i32 height, TextureFormat format, u32 levels);
+    ~TextureArray();
+
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+
+    i32 get_width() const { return m_width; }
+    i32 get_height() const { return m_height; }
+    TextureFormat get_format() const { return m_format; }
+    u32 get_level_count() const { return m_levels; }
+
+    // Whether image has the size, format and level count of the layers
+    bool accepts(const Image& image) const;
+    // False once every layer up to TEXTURE_ARRAY_MAX_LAYERS holds an image
+    bool has_free_layer() const { return m_layer_count < TEXTURE_ARRAY_MAX_LAYERS; }
+    bool is_empty() const { return m_layer_count == 0; }
+
+    // Copies every level of image into a free layer and returns it, growing the array if none is left
+    u32 add(const Image& image);
+    // The layer is given to the next image added
+    void remove(u32 layer);
+
+    // Bytes of every allocated layer on the GPU, used or not
+    u64 get_memory_size() const { return m_layer_size * m_capacity; }
+
+    // Sampler bound next to the array, without one layers sample with bilinear or trilinear clamped state
+    void set_sampler(const Sampler* sampler) { m_sampler = sampler; }
+    const Sampler* get_sampler() const { return m_sampler; }
+
+    void bind(UniformName name, Shader* shader, u32 slot) const;
+    void unbind() const;
+
+  private:
+    u32 ID;
+
+    i32 m_width, m_height;
+    TextureFormat m_format;
+    u32 m_levels;
+    // Bytes of every level of one layer
+    u64 m_layer_size = 0;
+
+    u32 m_capacity = 0;
+    u32 m_layer_count = 0;
+    std::vector<bool> m_used_layers;
+
+    const Sampler* m_sampler = nullptr;
+
+    // Creates the GL texture with capacity layers, left bound
+    void create(u32 capacity);
+    // Moves the layers to a larger texture, copied on the GPU through a pixel buffer
+    void grow(u32 capacity);
+    // Writes count layers of level starting at first, pixels can be an offset into a bound unpack buffer
+    void upload_layers(u32 level, u32 first, u32 count, const void* pixels);
+};
+
+// Image stored in a layer of a TextureArray
+struct HG_API TextureLayer {
+    TextureArray* page;
+    u32 layer;
+
+    bool operator==(const TextureLayer& other) const = default;
+};
+
+} // namespace Hydrogen
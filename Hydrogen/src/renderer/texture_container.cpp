@@ -0,0 +1,361 @@
+#include "texture_container.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+namespace Hydrogen {
+
+#define KTX2_EXTENSION ".ktx2"
+#define DDS_EXTENSION ".dds"
+
+template <typename T>
+static bool read(std::span<const u8> bytes, u64 offset, T& value) {
+    if (offset > bytes.size() || bytes.size() - offset < sizeof(T))
+        return false;
+
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return true;
+}
+
+// Levels down to 1x1, files listing more are cut there
+static u32 get_max_level_count(i32 width, i32 height) {
+    u32 count = 1;
+    while ((width >> count) > 0 || (height >> count) > 0) {
+        ++count;
+    }
+    return count;
+}
+
+// Splits levels stored one after another, largest first, checking each has the size of its dimensions
+static bool split_levels(std::span<const u8> bytes, u64 offset, u32 level_count, TextureContainer& container) {
+    for (u32 level = 0; level < level_count; ++level) {
+        const u64 size = get_level_size(
+            container.format, std::max(container.width >> level, 1), std::max(container.height >> level, 1));
+        if (offset > bytes.size() || bytes.size() - offset < size)
+            return false;
+
+        container.levels.push_back(bytes.subspan(offset, size));
+        offset += size;
+    }
+    return true;
+}
+
+//
+// KTX2
+//
+
+struct KTX2Header {
+    std::array<u8, 12> identifier;
+    u32 vk_format;
+    u32 type_size;
+    u32 pixel_width;
+    u32 pixel_height;
+    u32 pixel_depth;
+    u32 layer_count;
+    u32 face_count;
+    u32 level_count;
+    u32 supercompression_scheme;
+
+    u32 dfd_offset;
+    u32 dfd_length;
+    u32 kvd_offset;
+    u32 kvd_length;
+    u64 sgd_offset;
+    u64 sgd_length;
+};
+
+struct KTX2Level {
+    u64 offset;
+    u64 length;
+    u64 uncompressed_length;
+};
+
+static constexpr std::array<u8, 12> KTX2_IDENTIFIER = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+static std::optional<TextureFormat> get_ktx2_format(u32 vk_format) {
+    // sRGB variants hold the same bytes, the shaders decode gamma themselves
+    switch (vk_format) {
+        case 37: // VK_FORMAT_R8G8B8A8_UNORM
+        case 43: // VK_FORMAT_R8G8B8A8_SRGB
+            return TextureFormat::RGBA8;
+        case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+            return TextureFormat::BC1;
+        case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+        case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+            return TextureFormat::BC3;
+        case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+            return TextureFormat::BC4;
+        case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+            return TextureFormat::BC5;
+        case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+        case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+            return TextureFormat::BC7;
+        default:
+            return std::nullopt;
+    }
+}
+
+// Value of the KTXorientation key, "rd" when missing as the specification defines
+static std::string read_ktx2_orientation(std::span<const u8> bytes, const KTX2Header& header) {
+    static constexpr char KEY[] = "KTXorientation";
+
+    u64 offset = header.kvd_offset;
+    const u64 end = std::min((u64)header.kvd_offset + header.kvd_length, (u64)bytes.size());
+    while (offset < end && end - offset >= sizeof(u32)) {
+        u32 length = 0;
+        if (!read(bytes, offset, length) || end - offset - sizeof(u32) < length)
+            break;
+
+        const auto* entry = reinterpret_cast<const char*>(bytes.data() + offset + sizeof(u32));
+        if (length > sizeof(KEY) && std::memcmp(entry, KEY, sizeof(KEY)) == 0)
+            return std::string(entry + sizeof(KEY), strnlen(entry + sizeof(KEY), length - sizeof(KEY)));
+
+        // Entries are padded to 4 bytes
+        offset += sizeof(u32) + (length + 3) / 4 * 4;
+    }
+    return "rd";
+}
+
+static std::optional<TextureContainer> read_ktx2(std::span<const u8> bytes, const std::string& path) {
+    KTX2Header header{};
+    if (!read(bytes, 0, header) || header.identifier != KTX2_IDENTIFIER) {
+        HG_LOG_ERROR("{} is not a KTX2 file", path);
+        return std::nullopt;
+    }
+
+    if (header.supercompression_scheme != 0 || header.vk_format == 0) {
+        HG_LOG_ERROR("{} is supercompressed or Basis Universal encoded, which is not supported. Bake it to a "
+                     "BC format without supercompression",
+                     path);
+        return std::nullopt;
+    }
+
+    if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1
+        || header.face_count != 1) {
+        HG_LOG_ERROR("{} is not a 2D texture", path);
+        return std::nullopt;
+    }
+
+    if (header.pixel_width > TEXTURE_CONTAINER_MAX_SIZE || header.pixel_height > TEXTURE_CONTAINER_MAX_SIZE) {
+        HG_LOG_ERROR("{} is larger than {} pixels", path, TEXTURE_CONTAINER_MAX_SIZE);
+        return std::nullopt;
+    }
+
+    const auto format = get_ktx2_format(header.vk_format);
+    if (!format.has_value()) {
+        HG_LOG_ERROR("{} has unsupported VkFormat {}", path, header.vk_format);
+        return std::nullopt;
+    }
+
+    TextureContainer container;
+    container.format = *format;
+    container.width = (i32)header.pixel_width;
+    container.height = (i32)header.pixel_height;
+
+    const std::string orientation = read_ktx2_orientation(bytes, header);
+    container.bottom_row_first = orientation.size() > 1 && orientation[1] == 'u';
+
+    // Level 0 count asks for mips generated at load
+    const u32 level_count =
+        std::min(std::max(header.level_count, 1u), get_max_level_count(container.width, container.height));
+    for (u32 level = 0; level < level_count; ++level) {
+        KTX2Level index{};
+        const u64 size = get_level_size(container.format,
+                                        std::max(container.width >> level, 1),
+                                        std::max(container.height >> level, 1));
+        if (!read(bytes, sizeof(KTX2Header) + level * sizeof(KTX2Level), index) || index.length != size
+            || index.offset > bytes.size() || bytes.size() - index.offset < index.length) {
+            HG_LOG_ERROR("{} is malformed", path);
+            return std::nullopt;
+        }
+
+        container.levels.push_back(bytes.subspan(index.offset, index.length));
+    }
+
+    return container;
+}
+
+//
+// DDS
+//
+
+struct DDSPixelFormat {
+    u32 size;
+    u32 flags;
+    u32 four_cc;
+    u32 rgb_bit_count;
+    u32 r_mask;
+    u32 g_mask;
+    u32 b_mask;
+    u32 a_mask;
+};
+
+struct DDSHeader {
+    u32 magic;
+    u32 size;
+    u32 flags;
+    u32 height;
+    u32 width;
+    u32 pitch_or_linear_size;
+    u32 depth;
+    u32 mip_map_count;
+    std::array<u32, 11> reserved;
+    DDSPixelFormat pixel_format;
+    u32 caps;
+    u32 caps2;
+    u32 caps3;
+    u32 caps4;
+    u32 reserved2;
+};
+
+struct DDSHeaderDX10 {
+    u32 dxgi_format;
+    u32 resource_dimension;
+    u32 misc_flag;
+    u32 array_size;
+    u32 misc_flags2;
+};
+
+static constexpr u32 four_cc(const char (&code)[5]) {
+    return (u32)code[0] | ((u32)code[1] << 8) | ((u32)code[2] << 16) | ((u32)code[3] << 24);
+}
+
+#define DDS_MAGIC four_cc("DDS ")
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDPF_FOURCC 0x4
+#define DDPF_RGB 0x40
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_VOLUME 0x200000
+
+static std::optional<TextureFormat> get_dxgi_format(u32 dxgi_format, bool& swap_red_blue) {
+    switch (dxgi_format) {
+        case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+        case 29: // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+            return TextureFormat::RGBA8;
+        case 87: // DXGI_FORMAT_B8G8R8A8_UNORM
+        case 91: // DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+            swap_red_blue = true;
+            return TextureFormat::RGBA8;
+        case 71: // DXGI_FORMAT_BC1_UNORM
+        case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+            return TextureFormat::BC1;
+        case 77: // DXGI_FORMAT_BC3_UNORM
+        case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+            return TextureFormat::BC3;
+        case 80: // DXGI_FORMAT_BC4_UNORM
+            return TextureFormat::BC4;
+        case 83: // DXGI_FORMAT_BC5_UNORM
+            return TextureFormat::BC5;
+        case 98: // DXGI_FORMAT_BC7_UNORM
+        case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+            return TextureFormat::BC7;
+        default:
+            return std::nullopt;
+    }
+}
+
+static std::optional<TextureFormat> get_dds_format(const DDSPixelFormat& pixel_format, bool& swap_red_blue) {
+    if (pixel_format.flags & DDPF_FOURCC) {
+        switch (pixel_format.four_cc) {
+            case four_cc("DXT1"):
+                return TextureFormat::BC1;
+            case four_cc("DXT5"):
+                return TextureFormat::BC3;
+            case four_cc("ATI1"):
+            case four_cc("BC4U"):
+                return TextureFormat::BC4;
+            case four_cc("ATI2"):
+            case four_cc("BC5U"):
+                return TextureFormat::BC5;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    if ((pixel_format.flags & DDPF_RGB) && pixel_format.rgb_bit_count == 32 && pixel_format.g_mask == 0x0000ff00) {
+        if (pixel_format.r_mask == 0x000000ff && pixel_format.b_mask == 0x00ff0000)
+            return TextureFormat::RGBA8;
+        if (pixel_format.r_mask == 0x00ff0000 && pixel_format.b_mask == 0x000000ff) {
+            swap_red_blue = true;
+            return TextureFormat::RGBA8;
+        }
+    }
+    return std::nullopt;
+}
+
+static std::optional<TextureContainer> read_dds(std::span<const u8> bytes, const std::string& path) {
+    DDSHeader header{};
+    if (!read(bytes, 0, header) || header.magic != DDS_MAGIC || header.size != sizeof(DDSHeader) - sizeof(u32)) {
+        HG_LOG_ERROR("{} is not a DDS file", path);
+        return std::nullopt;
+    }
+
+    if (header.width > TEXTURE_CONTAINER_MAX_SIZE || header.height > TEXTURE_CONTAINER_MAX_SIZE) {
+        HG_LOG_ERROR("{} is larger than {} pixels", path, TEXTURE_CONTAINER_MAX_SIZE);
+        return std::nullopt;
+    }
+
+    TextureContainer container;
+    container.width = (i32)header.width;
+    container.height = (i32)header.height;
+
+    u64 offset = sizeof(DDSHeader);
+    std::optional<TextureFormat> format;
+    bool is_2d = (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) == 0;
+
+    if ((header.pixel_format.flags & DDPF_FOURCC) && header.pixel_format.four_cc == four_cc("DX10")) {
+        DDSHeaderDX10 header_dx10{};
+        if (!read(bytes, offset, header_dx10)) {
+            HG_LOG_ERROR("{} is malformed", path);
+            return std::nullopt;
+        }
+
+        offset += sizeof(DDSHeaderDX10);
+        format = get_dxgi_format(header_dx10.dxgi_format, container.swap_red_blue);
+        // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        is_2d = is_2d && header_dx10.resource_dimension == 3 && header_dx10.array_size <= 1;
+    } else {
+        format = get_dds_format(header.pixel_format, container.swap_red_blue);
+    }
+
+    if (!is_2d || container.width <= 0 || container.height <= 0) {
+        HG_LOG_ERROR("{} is not a 2D texture", path);
+        return std::nullopt;
+    }
+
+    if (!format.has_value()) {
+        HG_LOG_ERROR("{} has an unsupported pixel format", path);
+        return std::nullopt;
+    }
+    container.format = *format;
+
+    const u32 stored_levels = (header.flags & DDSD_MIPMAPCOUNT) ? std::max(header.mip_map_count, 1u) : 1;
+    const u32 level_count = std::min(stored_levels, get_max_level_count(container.width, container.height));
+    if (!split_levels(bytes, offset, level_count, container)) {
+        HG_LOG_ERROR("{} is malformed", path);
+        return std::nullopt;
+    }
+
+    return container;
+}
+
+//
+// Containers
+//
+
+bool is_texture_container(const std::string& path) {
+    const auto extension = std::filesystem::path(path).extension();
+    return extension == KTX2_EXTENSION || extension == DDS_EXTENSION;
+}
+
+std::optional<TextureContainer> read_texture_container(std::span<const u8> bytes, const std::string& path) {
+    if (std::filesystem::path(path).extension() == KTX2_EXTENSION)
+        return read_ktx2(bytes, path);
+    return read_dds(bytes, path);
+}
+
+} // namespace Hydrogen
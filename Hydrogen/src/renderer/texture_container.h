@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core.h"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "renderer/block_compression.h"
+
+namespace Hydrogen {
+
+// Largest width or height read from a container. Files are decoded off the main thread, so this stands in for
+// GL_MAX_TEXTURE_SIZE, and keeps the size of every level within 32 bits
+#define TEXTURE_CONTAINER_MAX_SIZE 16384
+
+// Texture baked offline into a KTX2 or DDS file, levels point into the bytes of the file.
+// Only 2D textures without supercompression in formats TextureFormat can hold are read
+struct HG_API TextureContainer {
+    TextureFormat format = TextureFormat::RGBA8;
+    i32 width = 0;
+    i32 height = 0;
+
+    // Largest level first, fewer than the full chain if the file was baked that way
+    std::vector<std::span<const u8>> levels;
+
+    // KTX2 files record their row order, DDS files do not
+    std::optional<bool> bottom_row_first;
+    // B8G8R8A8 DDS files store red and blue swapped
+    bool swap_red_blue = false;
+};
+
+// Whether the path names a file read_texture_container understands, by extension
+HG_API bool is_texture_container(const std::string& path);
+// Returns nothing if the file is malformed or not supported, path is only used for logging
+HG_API std::optional<TextureContainer> read_texture_container(std::span<const u8> bytes, const std::string& path);
+
+} // namespace Hydrogen
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "core.h"
+
+#include <string_view>
+
+namespace Hydrogen {
+
+// Uniform name hashed with FNV-1a, at compile time when created from a string literal
+struct HG_API UniformName {
+    u32 hash;
+    std::string_view name;
+
+    consteval UniformName(const char* str) : hash(fnv1a(str)), name(str) {}
+    explicit constexpr UniformName(std::string_view str) : hash(fnv1a(str)), name(str) {}
+
+    static constexpr u32 fnv1a(std::string_view str) {
+        u32 value = 2166136261u;
+        for (const char c : str) {
+            value ^= (u8)c;
+            value *= 16777619u;
+        }
+        return value;
+    }
+};
+
+} // namespace Hydrogen
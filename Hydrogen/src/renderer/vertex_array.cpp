@@ -2,27 +2,50 @@
 
 #include <glad/glad.h>
 
+#include "renderer_api.h"
+
 namespace Hydrogen {
 
-VertexArray::VertexArray() {
+VertexArray::VertexArray(bool owns_buffers) : m_owns_buffers(owns_buffers) {
     glGenVertexArrays(1, &ID);
     bind();
 }
 
 VertexArray::~VertexArray() {
+    RendererAPI::forget_vertex_array(ID);
     glDeleteVertexArrays(1, &ID);
 
-    for (const auto* vbo : m_vertex_buffers)
+    if (!m_owns_buffers)
+        return;
+
+    for (auto* vbo : m_vertex_buffers)
         delete vbo;
     delete m_index_buffer;
 }
 
 void VertexArray::bind() const {
-    glBindVertexArray(ID);
+    RendererAPI::bind_vertex_array(ID);
 }
 
 void VertexArray::unbind() const {
-    glBindVertexArray(0);
+    RendererAPI::bind_vertex_array(0);
+}
+
+void VertexArray::update_vertex_buffer(u32 index, const void* data, u32 size, u32 offset) {
+    HG_ASSERT(index < m_vertex_buffers.size(), "Vertex array has no vertex buffer {}", index);
+    m_vertex_buffers[index]->update(data, size, offset);
+}
+
+void VertexArray::update_index_buffer(const u32* indices, u32 number_indices, u32 offset) {
+    HG_ASSERT(m_index_buffer != nullptr, "Vertex array has no index buffer");
+    m_index_buffer->update(indices, number_indices, offset);
+}
+
+void VertexArray::disable_attributes(u32 first_location, u32 count) const {
+    bind();
+    for (u32 location = first_location; location < first_location + count; ++location) {
+        glDisableVertexAttribArray(location);
+    }
 }
 
 } // namespace renderer
\ No newline at end of file
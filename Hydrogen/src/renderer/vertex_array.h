@@ -8,24 +8,46 @@
 
 namespace Hydrogen {
 
+// Part of the index buffer of a vertex array, indices are offset by base_vertex before fetching vertices
+struct HG_API DrawRange {
+    u32 first_index = 0;
+    // 0 draws nothing
+    u32 index_count = 0;
+    i32 base_vertex = 0;
+};
+
 class HG_API VertexArray {
   public:
-    VertexArray();
+    // Vertex arrays reading buffers that belong to another one do not own them
+    explicit VertexArray(bool owns_buffers = true);
     ~VertexArray();
 
     void bind() const;
     void unbind() const;
 
-    void add_vertex_buffer(const VertexBuffer* vbo) { m_vertex_buffers.push_back(vbo); }
-    void set_index_buffer(const IndexBuffer* ebo) { m_index_buffer = ebo; }
+    void disable_attributes(u32 first_location, u32 count) const;
+
+    void add_vertex_buffer(VertexBuffer* vbo) { m_vertex_buffers.push_back(vbo); }
+    void set_index_buffer(IndexBuffer* ebo) { m_index_buffer = ebo; }
+
+    // Rewrite the geometry of a vertex array built with dynamic or stream buffers, one upload per buffer
+    // and frame. Buffers keep their names when growing, so the vertex array does not need to be set up again
+    void update_vertex_buffer(u32 index, const void* data, u32 size, u32 offset = 0);
+    void update_index_buffer(const u32* indices, u32 number_indices, u32 offset = 0);
 
-    i32 get_count() const { return m_index_buffer->get_count(); }
+    u32 get_id() const { return ID; }
+    i32 get_count() const { return (i32)m_index_buffer->get_count(); }
+    // Range of the whole index buffer
+    DrawRange get_draw_range() const { return DrawRange{.first_index = 0, .index_count = (u32)get_count()}; }
+    IndexType get_index_type() const { return m_index_buffer->get_type(); }
+    u32 get_index_size() const { return m_index_buffer->get_index_size(); }
 
   private:
     u32 ID;
+    bool m_owns_buffers;
 
-    std::vector<const VertexBuffer*> m_vertex_buffers;
-    const IndexBuffer* m_index_buffer;
+    std::vector<VertexBuffer*> m_vertex_buffers;
+    IndexBuffer* m_index_buffer = nullptr;
 };
 
 } // namespace renderer
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace Hydrogen {
+
+static_assert(sizeof(PackedAttributes) == 12, "PackedAttributes must match its vertex layout");
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must match its vertex layout");
+
+static const std::vector<VertexLayout> POSITION_LAYOUT = {
+    // Vertex positions
+    {.type = ShaderType::Float32, .count = 3, .normalized = false},
+};
+
+static const std::vector<VertexLayout> PACKED_ATTRIBUTES_LAYOUT = {
+    // Vertex normals
+    {.type = ShaderType::Int16, .count = 2, .normalized = true},
+    // Vertex texture coords
+    {.type = ShaderType::Float16, .count = 2, .normalized = false},
+    // Vertex tangents
+    {.type = ShaderType::Int2_10_10_10_Rev, .count = 4, .normalized = true},
+};
+
+static const std::vector<VertexLayout> PACKED_VERTEX_LAYOUT = {
+    POSITION_LAYOUT[0],
+    PACKED_ATTRIBUTES_LAYOUT[0],
+    PACKED_ATTRIBUTES_LAYOUT[1],
+    PACKED_ATTRIBUTES_LAYOUT[2],
+};
+
+//
+// Packing
+//
+static i32 pack_snorm(f32 value, u32 bits) {
+    const auto max = (f32)((1 << (bits - 1)) - 1);
+    return (i32)std::round(std::clamp(value, -1.0f, 1.0f) * max);
+}
+
+static u16 pack_half(f32 value) {
+    const u32 bits = std::bit_cast<u32>(value);
+    const u32 sign = (bits >> 16) & 0x8000u;
+    const i32 exponent = (i32)((bits >> 23) & 0xFFu) - 127 + 15;
+    u32 mantissa = bits & 0x7FFFFFu;
+
+    // Too large for a half, infinity or NaN
+    if (exponent >= 31) {
+        const bool nan = ((bits >> 23) & 0xFFu) == 0xFFu && mantissa != 0;
+        return (u16)(sign | 0x7C00u | (nan ? 0x200u : 0u));
+    }
+
+    // Subnormal half or too small
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return (u16)sign;
+
+        mantissa |= 0x800000u;
+        const auto shift = (u32)(14 - exponent);
+        u32 half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1u)
+            half += 1;
+        return (u16)(sign | half);
+    }
+
+    // Rounding may carry into the exponent, which is still the correctly rounded value
+    u32 half = sign | ((u32)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u)
+        half += 1;
+    return (u16)half;
+}
+
+// Layout of GL_INT_2_10_10_10_REV, x in the lowest bits
+static u32 pack_snorm_2_10_10_10_rev(const glm::vec4& value) {
+    return ((u32)pack_snorm(value.x, 10) & 0x3FFu) | (((u32)pack_snorm(value.y, 10) & 0x3FFu) << 10) |
+           (((u32)pack_snorm(value.z, 10) & 0x3FFu) << 20) | (((u32)pack_snorm(value.w, 2) & 0x3u) << 30);
+}
+
+PackedVertex PackedVertex::pack(const glm::vec3& position,
+                                const glm::vec3& normal,
+                                const glm::vec2& texture_coordinates,
+                                const glm::vec3& tangent,
+                                f32 handedness) {
+    const glm::vec2 octahedral = encode_octahedral(normal);
+
+    return PackedVertex{
+        .position = position,
+        .attributes =
+            PackedAttributes{
+                .normal = glm::i16vec2((i16)pack_snorm(octahedral.x, 16), (i16)pack_snorm(octahedral.y, 16)),
+                .texture_coordinates =
+                    glm::u16vec2(pack_half(texture_coordinates.x), pack_half(texture_coordinates.y)),
+                .tangent = pack_snorm_2_10_10_10_rev(glm::vec4(tangent, handedness < 0.0f ? -1.0f : 1.0f)),
+            },
+    };
+}
+
+const std::vector<VertexLayout>& PackedAttributes::get_layout() {
+    return PACKED_ATTRIBUTES_LAYOUT;
+}
+
+const std::vector<VertexLayout>& PackedVertex::get_layout() {
+    return PACKED_VERTEX_LAYOUT;
+}
+
+const std::vector<VertexLayout>& PackedVertex::get_position_layout() {
+    return POSITION_LAYOUT;
+}
+
+//
+// Octahedral encoding
+//
+static glm::vec2 sign_not_zero(const glm::vec2& v) {
+    return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+glm::vec2 encode_octahedral(const glm::vec3& direction) {
+    const f32 l1_norm = glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z);
+    if (l1_norm == 0.0f)
+        return glm::vec2(0.0f);
+
+    glm::vec2 encoded = glm::vec2(direction) / l1_norm;
+    // Fold the lower hemisphere over the diagonals
+    if (direction.z < 0.0f)
+        encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign_not_zero(encoded);
+
+    return encoded;
+}
+
+glm::vec3 decode_octahedral(const glm::vec2& encoded) {
+    glm::vec3 direction = glm::vec3(encoded, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+    if (direction.z < 0.0f) {
+        const glm::vec2 folded = (1.0f - glm::abs(glm::vec2(direction.y, direction.x))) * sign_not_zero(encoded);
+        direction.x = folded.x;
+        direction.y = folded.y;
+    }
+    return glm::normalize(direction);
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <vector>
+
+#include "buffers.h"
+
+namespace Hydrogen {
+
+// Quantized attributes decoded by the vertex shader:
+//  - normal: octahedral encoding in two normalized i16
+//  - texture coordinates: half floats
+//  - tangent: normalized 2_10_10_10, w holds the handedness of the bitangent
+struct HG_API PackedAttributes {
+    glm::i16vec2 normal;
+    glm::u16vec2 texture_coordinates;
+    u32 tangent;
+
+    // Starts at attribute location 1, after the position
+    static const std::vector<VertexLayout>& get_layout();
+};
+
+// Quantized vertex uploaded for meshes, 24 bytes instead of 44 with full floats.
+// Positions keep full precision. Meshes split in two streams store positions and attributes
+// in separate vertex buffers, so depth only passes read half of the vertex bytes
+struct HG_API PackedVertex {
+    glm::vec3 position;
+    PackedAttributes attributes;
+
+    static PackedVertex pack(const glm::vec3& position,
+                             const glm::vec3& normal,
+                             const glm::vec2& texture_coordinates,
+                             const glm::vec3& tangent,
+                             f32 handedness = 1.0f);
+
+    // Interleaved position and attributes
+    static const std::vector<VertexLayout>& get_layout();
+    // Position stream of split meshes
+    static const std::vector<VertexLayout>& get_position_layout();
+};
+
+// Maps a unit vector to the [-1, 1] square by projecting it on an octahedron
+HG_API glm::vec2 encode_octahedral(const glm::vec3& direction);
+HG_API glm::vec3 decode_octahedral(const glm::vec2& encoded);
+
+} // namespace Hydrogen
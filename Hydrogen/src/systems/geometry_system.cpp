@@ -0,0 +1,35 @@
+#include "geometry_system.h"
+
+namespace Hydrogen {
+
+GeometrySystem* GeometrySystem::instance = nullptr;
+
+void GeometrySystem::init() {
+    HG_ASSERT(instance == nullptr, "You can only initialize GeometrySystem once");
+    instance = new GeometrySystem();
+}
+
+void GeometrySystem::free() {
+    HG_ASSERT(instance != nullptr, "You must initialize GeometrySystem before it's destroyed");
+    delete instance;
+    instance = nullptr;
+}
+
+GeometrySystem::~GeometrySystem() {
+    for (auto* pool : m_pools) {
+        delete pool;
+    }
+}
+
+GeometryPool* GeometrySystem::get_pool(const std::vector<VertexStream>& streams, IndexType index_type) {
+    for (auto* pool : m_pools) {
+        if (pool->get_streams() == streams && pool->get_index_type() == index_type)
+            return pool;
+    }
+
+    auto* pool = new GeometryPool(streams, index_type);
+    m_pools.push_back(pool);
+    return pool;
+}
+
+} // namespace Hydrogen
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "core.h"
+
+#include <vector>
+
+#include "renderer/geometry_pool.h"
+
+namespace Hydrogen {
+
+class GeometrySystem {
+  public:
+    static GeometrySystem* instance;
+
+    static void init();
+    static void free();
+
+    // Pool shared by every mesh with the given vertex streams and index type, created on first use
+    GeometryPool* get_pool(const std::vector<VertexStream>& streams, IndexType index_type);
+
+  private:
+    std::vector<GeometryPool*> m_pools;
+
+    GeometrySystem() = default;
+    ~GeometrySystem();
+};
+
+} // namespace Hydrogen
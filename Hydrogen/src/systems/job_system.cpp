@@ -0,0 +1,118 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Hydrogen {
+
+JobSystem* JobSystem::instance = nullptr;
+
+void JobSystem::init() {
+    HG_ASSERT(instance == nullptr, "You can only initialize JobSystem once");
+    instance = new JobSystem();
+}
+
+void JobSystem::free() {
+    HG_ASSERT(instance != nullptr, "You must initialize JobSystem before it's destroyed");
+    delete instance;
+    instance = nullptr;
+}
+
+JobSystem::JobSystem() {
+    // The main thread takes part in parallel_for, leave it a core
+    const u32 worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    m_workers.reserve(worker_count);
+    for (u32 i = 0; i < worker_count; ++i) {
+        m_workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+            if (m_queue.empty())
+                return;
+
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        task();
+    }
+}
+
+void JobSystem::submit(std::function<void()> job) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_queue.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::parallel_for(u32 count, const std::function<void(u32)>& job) {
+    if (count == 0)
+        return;
+
+    // Helpers may start after every job is done, so the batch outlives this call while they hold it
+    struct Batch {
+        std::function<void(u32)> job;
+        u32 count;
+        std::atomic<u32> next = 0;
+        std::atomic<u32> remaining;
+
+        std::mutex mutex;
+        std::condition_variable done;
+
+        void run() {
+            for (u32 i = next++; i < count; i = next++) {
+                job(i);
+
+                if (--remaining == 0) {
+                    std::lock_guard lock(mutex);
+                    done.notify_all();
+                }
+            }
+        }
+    };
+
+    auto batch = std::make_shared<Batch>();
+    batch->job = job;
+    batch->count = count;
+    batch->remaining = count;
+
+    const u32 helpers = std::min((u32)m_workers.size(), count - 1);
+    if (helpers > 0) {
+        {
+            std::lock_guard lock(m_mutex);
+            for (u32 i = 0; i < helpers; ++i) {
+                m_queue.emplace_back([batch]() { batch->run(); });
+            }
+        }
+        m_wake.notify_all();
+    }
+
+    batch->run();
+
+    std::unique_lock lock(batch->mutex);
+    batch->done.wait(lock, [&]() { return batch->remaining == 0; });
+}
+
+} // namespace Hydrogen
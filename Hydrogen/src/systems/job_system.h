@@ -0,0 +1,46 @@
+#pragma once
+
+#include "core.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Hydrogen {
+
+// Pool of worker threads for CPU work such as importing meshes and decoding images. Jobs must not touch
+// GL state, which belongs to the main thread
+class JobSystem {
+  public:
+    static JobSystem* instance;
+
+    static void init();
+    static void free();
+
+    // Runs job(i) for every i in [0, count) on the workers and on the calling thread, returns once all of
+    // them finished. Jobs are picked one at a time, so uneven ones balance across threads
+    void parallel_for(u32 count, const std::function<void(u32)>& job);
+    // Runs job on a worker without waiting for it, jobs start in submission order
+    void submit(std::function<void()> job);
+
+    // Threads parallel_for runs on, including the calling one
+    u32 get_thread_count() const { return (u32)m_workers.size() + 1; }
+
+  private:
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_queue;
+    bool m_stopping = false;
+
+    JobSystem();
+    ~JobSystem();
+
+    void worker_loop();
+};
+
+} // namespace Hydrogen
@@ -1,5 +1,11 @@
 #include "texture_system.h"
 
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+
+#include "systems/job_system.h"
+
 namespace Hydrogen {
 
 TextureSystem* TextureSystem::instance = nullptr;
@@ -14,51 +20,434 @@ void TextureSystem::free() {
     delete instance;
 }
 
-TextureSystem::TextureSystem() {
-    m_textures.insert({DEFAULT_TEXTURE_NAME, Texture::white()});
+TextureSystem::TextureSystem() : m_decode_queue(std::make_shared<DecodeQueue>()) {
+    m_default_texture = Texture::white();
+    m_default_sampler = get_sampler(SamplerDescription{});
+    m_supported_formats.s3tc = Texture::is_format_supported(TextureFormat::BC1);
+    m_supported_formats.rgtc = Texture::is_format_supported(TextureFormat::BC4);
+    m_supported_formats.bptc = Texture::is_format_supported(TextureFormat::BC7);
 }
 
 TextureSystem::~TextureSystem() {
-    for (auto value : m_textures) {
-        delete value.second;
+    // Jobs that did not start yet skip decoding, images already decoded are freed with the queue
+    m_decode_queue->cancelled = true;
+    delete m_pixel_buffer;
+
+    for (auto& [path, entry] : m_textures) {
+        delete entry.texture;
+    }
+    delete m_default_texture;
+
+    for (auto* page : m_pages) {
+        delete page;
+    }
+
+    for (auto* sampler : m_samplers) {
+        delete sampler;
+    }
+}
+
+// Baked container next to the source image, preferred over decoding it
+static std::optional<std::string> find_container(const std::string& path) {
+    for (const char* extension : {".ktx2", ".dds"}) {
+        const auto container = std::filesystem::path(path).replace_extension(extension);
+        if (container != path && std::filesystem::exists(container))
+            return container.string();
+    }
+    return std::nullopt;
+}
+
+// Reads the image with its mips and compresses it, runs on any thread
+static Image* decode_image(const std::string& path,
+                           TextureUsage usage,
+                           bool flip_vertically,
+                           const BlockFormatSupport& supported_formats,
+                           bool compress) {
+    if (const auto container_path = find_container(path); container_path.has_value()) {
+        auto* image = new Image(*container_path, usage, flip_vertically);
+        if (image->is_valid() && supported_formats.supports(image->get_format()))
+            return image;
+
+        HG_LOG_WARN("Could not use {}, decoding {} instead", *container_path, path);
+        delete image;
+    }
+
+    auto* image = new Image(path, usage, flip_vertically);
+    // Containers acquired directly come compressed already
+    if (compress && image->is_valid() && image->get_format() == TextureFormat::RGBA8)
+        image->compress(image->choose_format(usage, supported_formats));
+    return image;
+}
+
+TextureSystem::DecodeQueue::~DecodeQueue() {
+    for (auto& decoded : images) {
+        delete decoded.image;
     }
 }
 
-Texture* TextureSystem::acquire(const std::string& texture_path) {
+Texture* TextureSystem::load(const std::string& texture_path,
+                             const Image& image,
+                             TextureUsage usage,
+                             bool flip_vertically) {
+    auto* texture = new Texture(image, texture_path);
+    texture->set_sampler(m_default_sampler);
+
+    m_textures.insert({texture_path,
+                       TextureEntry{
+                           .texture = texture,
+                           .references = 0,
+                           .usage = usage,
+                           .flip_vertically = flip_vertically,
+                       }});
+    return texture;
+}
+
+TextureLayer TextureSystem::load_layer(const std::string& texture_path, const Image& image) {
+    const auto fits = [&](const TextureArray* page) { return page->accepts(image) && page->has_free_layer(); };
+
+    TextureArray* page;
+    if (const auto it = std::find_if(m_pages.begin(), m_pages.end(), fits); it != m_pages.end()) {
+        page = *it;
+    } else {
+        page = new TextureArray(image.get_width(), image.get_height(), image.get_format(), image.get_level_count());
+        page->set_sampler(m_default_sampler);
+        m_pages.push_back(page);
+    }
+
+    const TextureLayer layer{.page = page, .layer = page->add(image)};
+    m_layers.insert({texture_path, LayerEntry{.layer = layer, .references = 0}});
+    return layer;
+}
+
+Texture* TextureSystem::acquire(const std::string& texture_path, TextureUsage usage, bool flip_vertically) {
     if (texture_path == DEFAULT_TEXTURE_NAME) {
         HG_LOG_INFO("Trying to acquire default texture through TextureSystem::acquire, should use "
                     "TextureSystem::default_texture");
-        return m_textures[DEFAULT_TEXTURE_NAME];
+        return m_default_texture;
     }
 
-    if (m_textures.contains(texture_path)) {
-        m_reference_count[texture_path]++;
-        return m_textures[texture_path];
+    if (const auto it = m_textures.find(texture_path); it != m_textures.end()) {
+        it->second.references++;
+        return it->second.texture;
     }
 
     HG_LOG_INFO("Loading new texture: {}", texture_path);
 
-    auto* texture = new Texture(texture_path);
-    m_textures.insert({texture_path, texture});
-    m_reference_count.insert({texture_path, 1});
+    const Image* image = decode_image(texture_path, usage, flip_vertically, m_supported_formats, m_compression);
+    auto* texture = load(texture_path, *image, usage, flip_vertically);
+    delete image;
+
+    m_textures.at(texture_path).references = 1;
     return texture;
 }
 
-void TextureSystem::release(const Texture* texture) {
-    if (m_textures.at(DEFAULT_TEXTURE_NAME) == texture) {
+Texture* TextureSystem::acquire_async(const std::string& texture_path, TextureUsage usage, bool flip_vertically) {
+    if (texture_path == DEFAULT_TEXTURE_NAME || m_textures.contains(texture_path))
+        return acquire(texture_path, usage, flip_vertically);
+
+    HG_LOG_INFO("Streaming new texture: {}", texture_path);
+
+    auto* texture = new Texture(texture_path, default_texture());
+    texture->set_sampler(m_default_sampler);
+
+    auto& entry = m_textures
+                      .insert({texture_path,
+                               TextureEntry{
+                                   .texture = texture,
+                                   .references = 1,
+                                   .usage = usage,
+                                   .flip_vertically = flip_vertically,
+                               }})
+                      .first->second;
+    reload_async(texture_path, entry, 0);
+
+    return texture;
+}
+
+std::optional<TextureLayer> TextureSystem::acquire_layer(const std::string& texture_path,
+                                                         TextureUsage usage,
+                                                         bool flip_vertically) {
+    if (const auto it = m_layers.find(texture_path); it != m_layers.end()) {
+        it->second.references++;
+        return it->second.layer;
+    }
+
+    HG_LOG_INFO("Loading new texture layer: {}", texture_path);
+
+    const Image* image = decode_image(texture_path, usage, flip_vertically, m_supported_formats, m_compression);
+
+    std::optional<TextureLayer> layer;
+    if (image->is_valid()) {
+        layer = load_layer(texture_path, *image);
+        m_layers.at(texture_path).references = 1;
+    }
+    delete image;
+
+    return layer;
+}
+
+void TextureSystem::reload_async(const std::string& texture_path, TextureEntry& entry, u32 dropped_levels) {
+    entry.dropped_levels = dropped_levels;
+    entry.loading = true;
+
+    JobSystem::instance->submit([queue = m_decode_queue,
+                                 texture_path,
+                                 usage = entry.usage,
+                                 flip_vertically = entry.flip_vertically,
+                                 dropped_levels,
+                                 supported_formats = m_supported_formats,
+                                 compress = m_compression]() {
+        if (queue->cancelled)
+            return;
+
+        auto* image = decode_image(texture_path, usage, flip_vertically, supported_formats, compress);
+        image->drop_levels(dropped_levels);
+
+        std::lock_guard lock(queue->mutex);
+        queue->images.push_back(DecodedImage{texture_path, image, dropped_levels});
+    });
+}
+
+void TextureSystem::update() {
+    // Textures bound from here on are bound in the new frame
+    Texture::set_current_frame(++m_frame);
+
+    upload_decoded();
+    restore_bound();
+    enforce_memory_budget();
+}
+
+void TextureSystem::upload_decoded() {
+    // Oldest decoded images that fit the budget, and always the first one so large images are not stuck
+    std::vector<DecodedImage> decoded;
+    {
+        std::lock_guard lock(m_decode_queue->mutex);
+        auto& images = m_decode_queue->images;
+
+        u64 size = 0;
+        usize count = 0;
+        for (; count < images.size(); ++count) {
+            size += images[count].image->get_total_size();
+            if (count > 0 && size > m_upload_budget)
+                break;
+        }
+
+        decoded.assign(images.begin(), images.begin() + (i64)count);
+        images.erase(images.begin(), images.begin() + (i64)count);
+    }
+
+    if (decoded.empty())
         return;
+
+    if (m_pixel_buffer == nullptr)
+        m_pixel_buffer = new StreamBuffer(m_upload_budget);
+
+    for (auto& [path, image, dropped_levels] : decoded) {
+        // The texture may have been evicted, or asked for other levels, while its image was decoding
+        const auto it = m_textures.find(path);
+        if (it != m_textures.end() && it->second.loading && it->second.dropped_levels == dropped_levels) {
+            it->second.loading = false;
+            if (image->is_valid())
+                it->second.texture->upload(*image, *m_pixel_buffer);
+        }
+
+        delete image;
     }
 
-    const auto& path = texture->get_path();
-    if (--m_reference_count[path] == 0) {
-        delete m_textures[path];
+    // Staging memory written this frame is reused once the GPU has copied it
+    m_pixel_buffer->fence();
+}
+
+void TextureSystem::restore_bound() {
+    // Bound during the previous frame, sampling the lower levels until the full image is uploaded
+    for (auto& [path, entry] : m_textures) {
+        if (entry.dropped_levels > 0 && entry.texture->get_last_bound_frame() + 1 >= m_frame)
+            reload_async(path, entry, 0);
+    }
+}
+
+void TextureSystem::enforce_memory_budget() {
+    // Textures losing levels count with their reduced size, so later frames do not drop more for them
+    u64 usage = m_default_texture->get_memory_size();
+    for (const auto& [path, entry] : m_textures) {
+        const u64 size = entry.texture->get_memory_size();
+        usage += entry.loading && entry.dropped_levels > 0 ? size >> (2 * entry.dropped_levels) : size;
+    }
+    for (const auto* page : m_pages) {
+        usage += page->get_memory_size();
+    }
+
+    if (usage <= m_memory_budget)
+        return;
+
+    const auto least_recently_bound = [&](bool referenced) {
+        std::vector<std::pair<u64, std::string>> candidates;
+        for (const auto& [path, entry] : m_textures) {
+            if ((entry.references > 0) == referenced && !entry.loading)
+                candidates.emplace_back(entry.texture->get_last_bound_frame(), path);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        return candidates;
+    };
+
+    for (const auto& [frame, path] : least_recently_bound(false)) {
+        if (usage <= m_memory_budget)
+            return;
+
+        HG_LOG_INFO("Evicting texture: {}", path);
+
+        auto& entry = m_textures.at(path);
+        usage -= entry.texture->get_memory_size();
+        delete entry.texture;
         m_textures.erase(path);
-        m_reference_count.erase(path);
     }
+
+    // Arrays only give their memory back once every layer is gone, so layers go all at once
+    if (usage > m_memory_budget)
+        usage -= remove_unreferenced_layers();
+
+    for (const auto& [frame, path] : least_recently_bound(true)) {
+        if (usage <= m_memory_budget || frame + TEXTURE_COLD_FRAMES >= m_frame)
+            return;
+
+        auto& entry = m_textures.at(path);
+        const u32 levels = entry.texture->get_level_count();
+        if (entry.dropped_levels > 0 || !entry.texture->is_ready() || levels <= 1)
+            continue;
+
+        HG_LOG_INFO("Dropping top levels of cold texture: {}", path);
+
+        const u32 dropped_levels = std::min((u32)TEXTURE_DROPPED_LEVELS, levels - 1);
+        const u64 size = entry.texture->get_memory_size();
+        usage -= size - (size >> (2 * dropped_levels));
+        reload_async(path, entry, dropped_levels);
+    }
+}
+
+u64 TextureSystem::get_memory_usage() const {
+    u64 usage = m_default_texture->get_memory_size();
+    for (const auto& [path, entry] : m_textures) {
+        usage += entry.texture->get_memory_size();
+    }
+    for (const auto* page : m_pages) {
+        usage += page->get_memory_size();
+    }
+    return usage;
 }
 
-Texture* TextureSystem::default_texture() const {
-    return m_textures.at(DEFAULT_TEXTURE_NAME);
+void TextureSystem::evict_unreferenced() {
+    std::erase_if(m_textures, [](const auto& value) {
+        if (value.second.references > 0)
+            return false;
+
+        delete value.second.texture;
+        return true;
+    });
+
+    remove_unreferenced_layers();
+}
+
+u64 TextureSystem::remove_unreferenced_layers() {
+    std::erase_if(m_layers, [](const auto& value) {
+        if (value.second.references > 0)
+            return false;
+
+        HG_LOG_INFO("Evicting texture layer: {}", value.first);
+        value.second.layer.page->remove(value.second.layer.layer);
+        return true;
+    });
+
+    u64 freed = 0;
+    std::erase_if(m_pages, [&](TextureArray* page) {
+        if (!page->is_empty())
+            return false;
+
+        freed += page->get_memory_size();
+        delete page;
+        return true;
+    });
+    return freed;
+}
+
+void TextureSystem::preload(const std::vector<std::pair<std::string, TextureUsage>>& textures, bool as_layers) {
+    std::vector<std::pair<std::string, TextureUsage>> missing;
+    for (const auto& [path, usage] : textures) {
+        if (path == DEFAULT_TEXTURE_NAME || (as_layers ? m_layers.contains(path) : m_textures.contains(path)))
+            continue;
+
+        const auto is_path = [&](const auto& request) { return request.first == path; };
+        if (std::find_if(missing.begin(), missing.end(), is_path) == missing.end())
+            missing.emplace_back(path, usage);
+    }
+
+    // Mip levels are generated and compressed with the decoding, on the workers
+    std::vector<Image*> images(missing.size());
+    JobSystem::instance->parallel_for((u32)missing.size(), [&](u32 i) {
+        images[i] = decode_image(missing[i].first, missing[i].second, true, m_supported_formats, m_compression);
+    });
+
+    // Uploads stay on this thread
+    for (u32 i = 0; i < missing.size(); ++i) {
+        HG_LOG_INFO("Loading new texture: {}", missing[i].first);
+
+        if (!as_layers)
+            load(missing[i].first, *images[i], missing[i].second, true);
+        else if (images[i]->is_valid())
+            load_layer(missing[i].first, *images[i]);
+        delete images[i];
+    }
+}
+
+void TextureSystem::release(const Texture* texture) {
+    if (texture == m_default_texture)
+        return;
+
+    // Materials also hold textures set by hand (e.g. Texture::white()), which the system never handed out
+    const auto it = m_textures.find(texture->get_path());
+    if (it == m_textures.end() || it->second.texture != texture) {
+        HG_LOG_WARN("Texture {} was not acquired from TextureSystem, not releasing it", texture->get_path());
+        return;
+    }
+
+    HG_ASSERT(it->second.references > 0, "Texture {} released more times than acquired", it->first);
+    it->second.references--;
+}
+
+void TextureSystem::release(const TextureLayer& layer) {
+    const auto it = std::find_if(
+        m_layers.begin(), m_layers.end(), [&](const auto& value) { return value.second.layer == layer; });
+    if (it == m_layers.end()) {
+        HG_LOG_WARN("Texture layer {} was not acquired from TextureSystem, not releasing it", layer.layer);
+        return;
+    }
+
+    HG_ASSERT(it->second.references > 0, "Texture layer {} released more times than acquired", it->first);
+    it->second.references--;
+}
+
+const Sampler* TextureSystem::get_sampler(const SamplerDescription& description) {
+    for (auto* sampler : m_samplers) {
+        if (sampler->get_description() == description)
+            return sampler;
+    }
+
+    auto* sampler = new Sampler(description);
+    m_samplers.push_back(sampler);
+    return sampler;
+}
+
+void TextureSystem::set_default_sampler(const SamplerDescription& description) {
+    const Sampler* previous = m_default_sampler;
+    m_default_sampler = get_sampler(description);
+
+    for (auto& [path, entry] : m_textures) {
+        if (entry.texture->get_sampler() == previous)
+            entry.texture->set_sampler(m_default_sampler);
+    }
+    for (auto* page : m_pages) {
+        if (page->get_sampler() == previous)
+            page->set_sampler(m_default_sampler);
+    }
 }
 
 } // namespace Hydrogen
@@ -2,14 +2,32 @@
 
 #include "core.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "renderer/texture.h"
+#include "renderer/texture_array.h"
+#include "renderer/image.h"
+#include "renderer/sampler.h"
+#include "renderer/stream_buffer.h"
 
 namespace Hydrogen {
 
 #define DEFAULT_TEXTURE_NAME "default"
+// Bytes of streamed textures uploaded per frame by default, at least one texture is uploaded every frame
+#define TEXTURE_UPLOAD_BUDGET (8 * 1024 * 1024)
+// Bytes of texture memory kept by default before textures are evicted
+#define TEXTURE_MEMORY_BUDGET (1024ull * 1024 * 1024)
+// Frames without being bound after which a referenced texture may lose its top levels
+#define TEXTURE_COLD_FRAMES 300
+// Top levels dropped from cold textures, each one divides their memory by about 4
+#define TEXTURE_DROPPED_LEVELS 2
 
 class TextureSystem {
   public:
@@ -18,17 +36,130 @@ class TextureSystem {
     static void init();
     static void free();
 
-    Texture* acquire(const std::string& texture_path);
+    // usage picks how the mip levels are filtered, a path already loaded keeps the usage it was loaded with
+    // A KTX2 or DDS file next to the image, same path with the other extension, is loaded in its place
+    Texture* acquire(const std::string& texture_path,
+                     TextureUsage usage = TextureUsage::Color,
+                     bool flip_vertically = true);
+    // Returns at once with a texture that binds default_texture() until its image is decoded on the job
+    // system and uploaded by update(). Paths already loaded or loading return the existing texture
+    Texture* acquire_async(const std::string& texture_path,
+                           TextureUsage usage = TextureUsage::Color,
+                           bool flip_vertically = true);
+    // Decodes the textures that are not loaded yet on the job system and uploads them, so acquiring them
+    // afterwards is immediate. They are kept without references until acquired, as layers with as_layers
+    void preload(const std::vector<std::pair<std::string, TextureUsage>>& textures, bool as_layers = false);
+    // Textures without references stay loaded, so acquiring them again is immediate, until the memory
+    // budget needs their space. Textures the system did not hand out are ignored with a warning
     void release(const Texture* texture);
 
-    Texture* default_texture() const;
+    // Copies the image into a layer of a texture array shared with the images of the same size, format and
+    // level count, so materials sampling them bind the array once. Layers are neither streamed nor reduced
+    // when cold. nullopt if the image could not be decoded
+    std::optional<TextureLayer> acquire_layer(const std::string& texture_path,
+                                              TextureUsage usage = TextureUsage::Color,
+                                              bool flip_vertically = true);
+    void release(const TextureLayer& layer);
+
+    // Whether models place the textures of PBR materials in texture arrays. On by default
+    void set_texture_arrays(bool enabled) { m_texture_arrays = enabled; }
+    bool uses_texture_arrays() const { return m_texture_arrays; }
+
+    Texture* default_texture() const { return m_default_texture; }
+
+    // Uploads textures decoded by acquire_async through a pixel buffer, within the upload budget, then
+    // keeps texture memory within its budget. Called once per frame by the application
+    void update();
+    void set_upload_budget(u32 bytes) { m_upload_budget = bytes; }
+
+    // Over budget, textures without references are deleted least recently bound first, then layers without
+    // references. Referenced textures not bound for TEXTURE_COLD_FRAMES frames are then reloaded without
+    // their top levels, and get them back once bound again
+    void set_memory_budget(u64 bytes) { m_memory_budget = bytes; }
+    // Bytes of every loaded texture
+    u64 get_memory_usage() const;
+    // Deletes every texture and layer without references at once, e.g. between scenes
+    void evict_unreferenced();
+
+    // Sampler shared by every texture with the given description, created on first use
+    const Sampler* get_sampler(const SamplerDescription& description);
+    // Sampler of the textures loaded from files, loaded ones included
+    void set_default_sampler(const SamplerDescription& description);
+
+    // Block compress textures loaded afterwards, in a format picked by usage among the ones the driver
+    // supports. On by default. KTX2 and DDS files keep the format they were baked with either way
+    void set_compression(bool enabled) { m_compression = enabled; }
 
   private:
-    std::unordered_map<std::string, Texture*> m_textures;
-    std::unordered_map<std::string, i32> m_reference_count;
+    struct TextureEntry {
+        Texture* texture;
+        i32 references;
+
+        // Kept to load the texture again
+        TextureUsage usage;
+        bool flip_vertically;
+
+        // Top levels left out of the uploaded image
+        u32 dropped_levels = 0;
+        // A decode job for dropped_levels is running, results for other values are stale
+        bool loading = false;
+    };
+
+    std::unordered_map<std::string, TextureEntry> m_textures;
+    Texture* m_default_texture;
+
+    struct LayerEntry {
+        TextureLayer layer;
+        i32 references;
+    };
+
+    std::unordered_map<std::string, LayerEntry> m_layers;
+    // Deleted once their last layer is removed
+    std::vector<TextureArray*> m_pages;
+    bool m_texture_arrays = true;
+
+    std::vector<Sampler*> m_samplers;
+    const Sampler* m_default_sampler = nullptr;
+
+    // Queried on the main thread for the decode jobs
+    BlockFormatSupport m_supported_formats;
+    bool m_compression = true;
+
+    struct DecodedImage {
+        std::string path;
+        Image* image;
+        u32 dropped_levels;
+    };
+
+    // Images decoded by jobs waiting for upload. Jobs keep it alive, so they can finish after the system is gone
+    struct DecodeQueue {
+        std::mutex mutex;
+        std::vector<DecodedImage> images;
+        std::atomic<bool> cancelled = false;
+
+        ~DecodeQueue();
+    };
+    std::shared_ptr<DecodeQueue> m_decode_queue;
+
+    // Created on the first streamed upload
+    StreamBuffer* m_pixel_buffer = nullptr;
+    u32 m_upload_budget = TEXTURE_UPLOAD_BUDGET;
+
+    u64 m_memory_budget = TEXTURE_MEMORY_BUDGET;
+    u64 m_frame = 0;
 
     TextureSystem();
     ~TextureSystem();
+
+    Texture* load(const std::string& texture_path, const Image& image, TextureUsage usage, bool flip_vertically);
+    TextureLayer load_layer(const std::string& texture_path, const Image& image);
+    // Returns the bytes of the texture arrays deleted because they were left empty
+    u64 remove_unreferenced_layers();
+    // Decodes the texture on the job system with dropped_levels top levels left out, update() uploads it
+    void reload_async(const std::string& texture_path, TextureEntry& entry, u32 dropped_levels);
+    void upload_decoded();
+    void restore_bound();
+    void enforce_memory_budget();
 };
 
 } // namespace Hydrogen